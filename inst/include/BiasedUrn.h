@@ -0,0 +1,144 @@
+/*************************** BiasedUrn.h **********************************
+* Project:       BiasedUrn
+*
+* Description:
+* C interface to the BiasedUrn package for compiled code in other packages.
+*
+* Usage:
+* Add BiasedUrn to the LinkingTo and Imports fields in the DESCRIPTION file
+* of your package, and importFrom(BiasedUrn, dWNCHypergeo) or similar in 
+* the NAMESPACE file, so that BiasedUrn is loaded before your code runs.
+* Then #include <BiasedUrn.h> in your C or C++ code.
+*
+* The functions have the same meaning as the R functions of the same name,
+* but take scalar parameters:
+*
+* double BiasedUrn_dFNCHypergeo(int x, int m1, int m2, int n, double odds, double precision);
+* double BiasedUrn_dWNCHypergeo(int x, int m1, int m2, int n, double odds, double precision);
+* Probability mass function.
+*
+* double BiasedUrn_pFNCHypergeo(int x, int m1, int m2, int n, double odds, double precision, int lower_tail);
+* double BiasedUrn_pWNCHypergeo(int x, int m1, int m2, int n, double odds, double precision, int lower_tail);
+* Cumulative distribution function. P(X <= x) if lower_tail, otherwise P(X > x).
+*
+* int BiasedUrn_qFNCHypergeo(double p, int m1, int m2, int n, double odds, double precision, int lower_tail);
+* int BiasedUrn_qWNCHypergeo(double p, int m1, int m2, int n, double odds, double precision, int lower_tail);
+* Quantile function. Returns NA_INTEGER if p is not in the interval [0,1].
+*
+* int BiasedUrn_rFNCHypergeo(int m1, int m2, int n, double odds, double precision);
+* int BiasedUrn_rWNCHypergeo(int m1, int m2, int n, double odds, double precision);
+* Random variate generation.
+*
+* double BiasedUrn_dMFNCHypergeo(const int * x, const int * m, const double * odds, int n, int colors, double precision);
+* double BiasedUrn_dMWNCHypergeo(const int * x, const int * m, const double * odds, int n, int colors, double precision);
+* Multivariate probability mass function. x, m and odds have one element for each color.
+*
+* void BiasedUrn_rMFNCHypergeo(int * x, const int * m, const double * odds, int n, int colors, double precision);
+* void BiasedUrn_rMWNCHypergeo(int * x, const int * m, const double * odds, int n, int colors, double precision);
+* Multivariate random variate generation. The result is stored in x.
+*
+* Invalid parameters give an R error. The random variate generating 
+* functions use the random number generator of R. Call GetRNGstate() before
+* and PutRNGstate() after generating random variates, as with unif_rand().
+* The random variate generating functions are fastest when called 
+* repeatedly with the same parameters. None of the functions are thread safe.
+*
+* GNU General Public License v. 3. http://www.gnu.org/licenses/gpl.html
+*****************************************************************************/
+
+#ifndef BIASEDURN_H
+#define BIASEDURN_H
+
+#include <R_ext/Rdynload.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Function pointer types
+typedef double (*BiasedUrn_d_t)(int, int, int, int, double, double);
+typedef double (*BiasedUrn_p_t)(int, int, int, int, double, double, int);
+typedef int    (*BiasedUrn_q_t)(double, int, int, int, double, double, int);
+typedef int    (*BiasedUrn_r_t)(int, int, int, double, double);
+typedef double (*BiasedUrn_dM_t)(const int *, const int *, const double *, int, int, double);
+typedef void   (*BiasedUrn_rM_t)(int *, const int *, const double *, int, int, double);
+
+// Each function gets the function pointer from BiasedUrn the first time it is called
+
+static inline double BiasedUrn_dFNCHypergeo(int x, int m1, int m2, int n, double odds, double precision) {
+    static BiasedUrn_d_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_d_t) R_GetCCallable("BiasedUrn", "BiasedUrn_dFNCHypergeo");
+    return fun(x, m1, m2, n, odds, precision);
+}
+
+static inline double BiasedUrn_dWNCHypergeo(int x, int m1, int m2, int n, double odds, double precision) {
+    static BiasedUrn_d_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_d_t) R_GetCCallable("BiasedUrn", "BiasedUrn_dWNCHypergeo");
+    return fun(x, m1, m2, n, odds, precision);
+}
+
+static inline double BiasedUrn_pFNCHypergeo(int x, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    static BiasedUrn_p_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_p_t) R_GetCCallable("BiasedUrn", "BiasedUrn_pFNCHypergeo");
+    return fun(x, m1, m2, n, odds, precision, lower_tail);
+}
+
+static inline double BiasedUrn_pWNCHypergeo(int x, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    static BiasedUrn_p_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_p_t) R_GetCCallable("BiasedUrn", "BiasedUrn_pWNCHypergeo");
+    return fun(x, m1, m2, n, odds, precision, lower_tail);
+}
+
+static inline int BiasedUrn_qFNCHypergeo(double p, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    static BiasedUrn_q_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_q_t) R_GetCCallable("BiasedUrn", "BiasedUrn_qFNCHypergeo");
+    return fun(p, m1, m2, n, odds, precision, lower_tail);
+}
+
+static inline int BiasedUrn_qWNCHypergeo(double p, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    static BiasedUrn_q_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_q_t) R_GetCCallable("BiasedUrn", "BiasedUrn_qWNCHypergeo");
+    return fun(p, m1, m2, n, odds, precision, lower_tail);
+}
+
+static inline int BiasedUrn_rFNCHypergeo(int m1, int m2, int n, double odds, double precision) {
+    static BiasedUrn_r_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_r_t) R_GetCCallable("BiasedUrn", "BiasedUrn_rFNCHypergeo");
+    return fun(m1, m2, n, odds, precision);
+}
+
+static inline int BiasedUrn_rWNCHypergeo(int m1, int m2, int n, double odds, double precision) {
+    static BiasedUrn_r_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_r_t) R_GetCCallable("BiasedUrn", "BiasedUrn_rWNCHypergeo");
+    return fun(m1, m2, n, odds, precision);
+}
+
+static inline double BiasedUrn_dMFNCHypergeo(const int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    static BiasedUrn_dM_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_dM_t) R_GetCCallable("BiasedUrn", "BiasedUrn_dMFNCHypergeo");
+    return fun(x, m, odds, n, colors, precision);
+}
+
+static inline double BiasedUrn_dMWNCHypergeo(const int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    static BiasedUrn_dM_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_dM_t) R_GetCCallable("BiasedUrn", "BiasedUrn_dMWNCHypergeo");
+    return fun(x, m, odds, n, colors, precision);
+}
+
+static inline void BiasedUrn_rMFNCHypergeo(int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    static BiasedUrn_rM_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_rM_t) R_GetCCallable("BiasedUrn", "BiasedUrn_rMFNCHypergeo");
+    fun(x, m, odds, n, colors, precision);
+}
+
+static inline void BiasedUrn_rMWNCHypergeo(int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    static BiasedUrn_rM_t fun = NULL;
+    if (fun == NULL) fun = (BiasedUrn_rM_t) R_GetCCallable("BiasedUrn", "BiasedUrn_rMWNCHypergeo");
+    fun(x, m, odds, n, colors, precision);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BIASEDURN_H
@@ -29,7 +29,7 @@
 Methods for class CFishersNCHypergeometric
 ***********************************************************************/
 
-CFishersNCHypergeometric::CFishersNCHypergeometric(int32 n, int32 m, int32 N, double odds, double accuracy) {
+CFishersNCHypergeometric::CFishersNCHypergeometric(int64 n, int64 m, int64 N, double odds, double accuracy) {
     // constructor
     // set parameters
     this->n = n;  this->m = m;  this->N = N;
@@ -50,7 +50,7 @@ CFishersNCHypergeometric::CFishersNCHypergeometric(int32 n, int32 m, int32 N, do
 }
 
 
-int32 CFishersNCHypergeometric::mode(void) {
+int64 CFishersNCHypergeometric::mode(void) {
     // Find mode (exact)
     // Uses the method of Liao and Rosen, The American Statistician, vol 55,
     // no 4, 2001, p. 366-369.
@@ -59,13 +59,28 @@ int32 CFishersNCHypergeometric::mode(void) {
 
     double A, B, C, D;                  // coefficients for quadratic equation
     double x;                           // mode
-    int32 L = m + n - N;
-    int32 m1 = m + 1, n1 = n + 1;
+    int64 L = m + n - N;
+    int64 m1 = m + 1, n1 = n + 1;
 
     if (odds == 1.) {
         // simple hypergeometric
         x = (m + 1.) * (n + 1.) / (N + 2.);
     }
+    else if (odds > 1E100 || odds < 1E-100) {
+        // Extreme odds. The quadratic equation would overflow.
+        // Find mode by bisection, using that f(x+1)/f(x) is decreasing
+        int64 x1 = xmin, x2 = xmax, xm;
+        while (x1 < x2) {
+            xm = x1 + ((x2 - x1) >> 1);
+            if (log(double(m - xm) * (n - xm) / ((xm + 1.) * (xm + 1. - L))) + logodds > 0.) {
+                x1 = xm + 1;
+            }
+            else {
+                x2 = xm;
+            }
+        }
+        return x1;
+    }
     else {
         // calculate analogously to Cornfield mean
         A = 1. - odds;
@@ -75,7 +90,7 @@ int32 CFishersNCHypergeometric::mode(void) {
         D = D > 0. ? sqrt(D) : 0.;
         x = (D - B) / (A + A);
     }
-    return int32(x);
+    return int64(x);
 }
 
 
@@ -88,6 +103,11 @@ double CFishersNCHypergeometric::mean(void) {
     if (odds == 1.) {                   // simple hypergeometric
         return double(m) * n / N;
     }
+    if (odds > 1E100 || odds < 1E-100) {
+        // Cornfield's formula would overflow. The distribution is 
+        // concentrated at the mode
+        return mode();
+    }
     // calculate Cornfield mean
     a = (m + n) * odds + (N - m - n);
     b = a * a - 4. * odds * (odds - 1.) * m * n;
@@ -112,9 +132,14 @@ double CFishersNCHypergeometric::moments(double * mean_, double * var_) {
     // calculate exact mean and variance
     // return value = sum of f(x), expected = 1.
     double y, sy = 0, sxy = 0, sxxy = 0, me1;
-    int32 x, xm, x1;
-    const double accur = 0.1 * accuracy;     // accuracy of calculation
-    xm = (int32)mean();                      // approximation to mean
+    int64 x, xm, x1;
+    double accur = 0.1 * accuracy;           // accuracy of calculation
+    xm = (int64)mean();                      // approximation to mean
+    if (N > LARGE_URN) {
+        // The distribution is so wide that all f(x) may be below accur.
+        // Make the cutoff relative to the height of the peak instead
+        accur /= sqrt(variance() + 1.);
+    }
     for (x = xm; x <= xmax; x++) {
         y = probability(x);
         x1 = x - xm;  // subtract approximate mean to avoid loss of precision in sums
@@ -136,15 +161,16 @@ double CFishersNCHypergeometric::moments(double * mean_, double * var_) {
 }
 
 
-double CFishersNCHypergeometric::probability(int32 x) {
+double CFishersNCHypergeometric::probability(int64 x) {
     // calculate probability function
     const double accur = accuracy * 0.1;// accuracy of calculation
 
     if (x < xmin || x > xmax) return 0;
     if (n == 0) return 1.;
 
-    if (odds == 1.) {
-        // central hypergeometric
+    if (odds == 1. && N <= LARGE_URN) {
+        // central hypergeometric. For very large N the general method below
+        // is more precise because it avoids differences between huge log factorials
         return exp(
             LnFac(m) - LnFac(x) - LnFac(m - x) +
             LnFac(N - m) - LnFac(n - x) - LnFac((N - m) - (n - x)) -
@@ -159,9 +185,9 @@ double CFishersNCHypergeometric::probability(int32 x) {
     if (!rsum) {
         // first time. calculate rsum = reciprocal of sum of proportional 
         // function over all probable x values
-        int32 x1, x2;                    // x loop
+        int64 x1, x2;                    // x loop
         double y;                        // value of proportional function
-        x1 = (int32)mean();              // start at mean
+        x1 = (int64)mean();              // start at mean
         if (x1 < xmin) x1 = xmin;
         x2 = x1 + 1;
         scale = 0.; scale = lng(x1);     // calculate scale to avoid overflow
@@ -180,12 +206,12 @@ double CFishersNCHypergeometric::probability(int32 x) {
 }
 
 
-double CFishersNCHypergeometric::probabilityRatio(int32 x, int32 x0) {
+double CFishersNCHypergeometric::probabilityRatio(int64 x, int64 x0) {
     // Calculate probability ratio f(x)/f(x0)
     // This is much faster than calculating a single probability because
     // rsum is not needed
     double a1, a2, a3, a4, f1, f2, f3, f4;
-    int32 y, dx = x - x0;
+    int64 y, dx = x - x0;
     int invert = 0;
 
     if (x < xmin || x > xmax) return 0.;
@@ -232,7 +258,7 @@ double CFishersNCHypergeometric::probabilityRatio(int32 x, int32 x0) {
 }
 
 
-double CFishersNCHypergeometric::MakeTable(double * table, int32 MaxLength, int32 * xfirst, int32 * xlast, bool * useTable, double cutoff) {
+double CFishersNCHypergeometric::MakeTable(double * table, int32 MaxLength, int64 * xfirst, int64 * xlast, bool * useTable, double cutoff) {
     // Makes a table of Fisher's noncentral hypergeometric probabilities.
     // Results are returned in the array table of size MaxLength.
     // The values are scaled so that the highest value is 1. The return value
@@ -253,12 +279,12 @@ double CFishersNCHypergeometric::MakeTable(double * table, int32 MaxLength, int3
     double f;                           // probability function value
     double sum;                         // sum of table values
     double a1, a2, b1, b2;              // factors in recursive calculation of f(x)
-    int32 x;                            // x value
-    int32 x1, x2;                       // lowest and highest x
-    int32 i, i0, i1, i2;                // table index
-    int32 mode = this->mode();          // mode
-    int32 L = n + m - N;                // parameter
-    int32 DesiredLength;                // desired length of table
+    int64 x;                            // x value
+    int64 x1, x2;                       // lowest and highest x
+    int64 i, i0, i1, i2;                // table index
+    int64 mode = this->mode();          // mode
+    int64 L = n + m - N;                // parameter
+    int64 DesiredLength;                // desired length of table
 
     // limits for x
     x1 = (L > 0) ? L : 0;               // xmin
@@ -279,13 +305,26 @@ double CFishersNCHypergeometric::MakeTable(double * table, int32 MaxLength, int3
 
     if (useTable) *useTable = true;
 
+    if (odds > 1E100 || odds < 1E-100) {
+        // Extreme odds. The recursive formula would overflow. Use logarithms
+        if (MaxLength <= 0) {
+            // Return DesiredLength
+            return MakeLogTable(table, 0, xfirst, xlast, cutoff > 0. ? cutoff : 0.01 * accuracy);
+        }
+        MakeLogTable(table, MaxLength, xfirst, xlast, cutoff);
+        for (sum = 0., i = 0; i <= *xlast - *xfirst; i++) {
+            sum += table[i] = exp(table[i]);
+        }
+        return sum;
+    }
+
     if (MaxLength <= 0) {
         // Return useTabl and DesiredLength
         DesiredLength = x2 - x1 + 1;     // max length of table
         if (DesiredLength > 200) {
             double sd = sqrt(variance()); // calculate approximate standard deviation
             // estimate number of standard deviations to include from normal distribution
-            i = (int32)(NumSD(accuracy) * sd + 0.5);
+            i = (int64)(NumSD(accuracy) * sd + 0.5);
             if (DesiredLength > i) DesiredLength = i;
         }
         return DesiredLength;
@@ -353,12 +392,158 @@ double CFishersNCHypergeometric::MakeTable(double * table, int32 MaxLength, int3
 }
 
 
-double CFishersNCHypergeometric::lng(int32 x) {
+double CFishersNCHypergeometric::MakeLogTable(double * table, int32 MaxLength, int64 * xfirst, int64 * xlast, double cutoff) {
+    // Makes a table of the natural logarithms of Fisher's noncentral 
+    // hypergeometric probabilities. This method works for any odds and any 
+    // length of table without overflow or underflow.
+    // Results are returned in the array table of size MaxLength.
+    // The values are log(f(x)/f(mode)), so that the highest value is 0. 
+    // The return value is log(s), where s is the sum of exp(table[i]).
+    // The log probabilities are obtained by subtracting log(s) from all 
+    // values in the table. s is accumulated from the mode and out, so that 
+    // it is always >= 1 and cannot overflow.
+    // The tails are cut off where f(x)/f(mode) < cutoff, so that 
+    // *xfirst may be > xmin and *xlast may be < xmax. There is no cut off
+    // if cutoff = 0.
+    // The first and last x value represented in the table are returned in 
+    // *xfirst and *xlast. If the table would require more than MaxLength
+    // values then the table is filled with as many correct values as 
+    // possible, as in MakeTable.
+    //
+    // The function will return the desired length of table when MaxLength = 0.
+
+    double f;                           // log(f(x)/f(mode))
+    double lcut;                        // log(cutoff)
+    double sum;                         // sum of exp(table values)
+    double a1, a2, b1, b2;              // factors in recursive calculation of f(x)
+    int64 x;                            // x value
+    int64 x1, x2;                       // lowest and highest x
+    int64 i, i0, i1, i2;                // table index
+    int64 mode;                         // mode
+    int64 L = n + m - N;                // parameter
+
+    // limits for x
+    x1 = (L > 0) ? L : 0;               // xmin
+    x2 = (n < m) ? n : m;               // xmax
+    *xfirst = x1;  *xlast = x2;
+
+    // special cases
+    if (x1 == x2) goto DETERMINISTIC;
+    if (odds <= 0.) {
+        if (n > N - m) FatalError("Not enough items with nonzero weight in CFishersNCHypergeometric::MakeLogTable");
+        x1 = 0;
+    DETERMINISTIC:
+        *xfirst = *xlast = x1;
+        if (MaxLength && table) *table = 0.;
+        return MaxLength ? 0. : 1.;
+    }
+
+    lcut = cutoff > 0. ? log(cutoff) : -1E300;
+    mode = this->mode();
+
+    if (MaxLength <= 0) {
+        // Find desired length of table by following the tails until cutoff
+        x = mode;  f = 0.;
+        a1 = m + 1 - x;  a2 = n + 1 - x;
+        b1 = x;  b2 = x - L;
+        while (x > x1) {
+            f += log(b1 * b2 / (a1 * a2)) - logodds;
+            a1++;  a2++;  b1--;  b2--;  x--;
+            if (f < lcut) break;
+        }
+        i1 = x;
+        x = mode;  f = 0.;
+        a1 = m - x;  a2 = n - x;
+        b1 = x + 1;  b2 = x + 1 - L;
+        while (x < x2) {
+            f += log(a1 * a2 / (b1 * b2)) + logodds;
+            a1--;  a2--;  b1++;  b2++;  x++;
+            if (f < lcut) break;
+        }
+        return x - i1 + 1;
+    }
+
+    // place mode in the table
+    if (mode - x1 <= MaxLength / 2) {
+        // There is enough space for left tail
+        i0 = mode - x1;
+    }
+    else if (x2 - mode <= MaxLength / 2) {
+        // There is enough space for right tail
+        i0 = MaxLength - x2 + mode - 1;
+        if (i0 < 0) i0 = 0;
+    }
+    else {
+        // There is not enough space for any of the tails. Place mode in middle of table
+        i0 = MaxLength / 2;
+    }
+    // Table start index
+    i1 = i0 - mode + x1;  if (i1 < 0) i1 = 0;
+
+    // Table end index
+    i2 = i0 + x2 - mode;  if (i2 > MaxLength - 1) i2 = MaxLength - 1;
+
+    // make center
+    table[i0] = f = 0.;  sum = 1.;
+
+    // make left tail
+    x = mode;
+    a1 = m + 1 - x;  a2 = n + 1 - x;
+    b1 = x;  b2 = x - L;
+    for (i = i0 - 1; i >= i1; i--) {
+        f += log(b1 * b2 / (a1 * a2)) - logodds; // recursive formula
+        a1++;  a2++;  b1--;  b2--;
+        table[i] = f;
+        sum += exp(f);
+        if (f < lcut) {
+            i1 = i;  break;               // cut off tail if < accuracy
+        }
+    }
+    if (i1 > 0) {
+        // move table down for cut-off left tail
+        memmove(table, table + i1, (i0 - i1 + 1) * sizeof(*table));
+        // adjust indices
+        i0 -= i1;  i2 -= i1;  i1 = 0;
+    }
+    // make right tail
+    x = mode;
+    a1 = m - x;  a2 = n - x;
+    b1 = x + 1;  b2 = x + 1 - L;
+    f = 0.;
+    for (i = i0 + 1; i <= i2; i++) {
+        f += log(a1 * a2 / (b1 * b2)) + logodds; // recursive formula
+        a1--;  a2--;  b1++;  b2++;
+        table[i] = f;
+        sum += exp(f);
+        if (f < lcut) {
+            i2 = i;  break;               // cut off tail if < accuracy
+        }
+    }
+    // x limits
+    *xfirst = mode - (i0 - i1);
+    *xlast = mode + (i2 - i0);
+
+    return log(sum);
+}
+
+
+double CFishersNCHypergeometric::lng(int64 x) {
     // natural log of proportional function
     // returns lambda = log(m!*x!/(m-x)!*m2!*x2!/(m2-x2)!*odds^x)
-    int32 x2 = n - x, m2 = N - m;
+    int64 x2 = n - x, m2 = N - m;
     if (ParametersChanged) {
-        mFac = LnFac(m) + LnFac(m2);
+        if (N > LARGE_URN) {
+            // The log factorials are too big to subtract without loss of
+            // precision. Calculate differences relative to xRef instead.
+            xRef = (int64)mean();
+            if (xRef < xmin) xRef = xmin;
+            if (xRef > xmax) xRef = xmax;
+            mFac = 0.;
+        }
+        else {
+            xRef = 0;
+            mFac = LnFac(m) + LnFac(m2);
+        }
         xLast = -99; ParametersChanged = 0;
     }
     if (m < FAK_LEN && m2 < FAK_LEN)  goto DEFLT;
@@ -372,10 +557,16 @@ double CFishersNCHypergeometric::lng(int32 x) {
         xFac += log(double(x2) * (m - x) / (double(x + 1) * (m2 - x2 + 1)));
         break;
     default: DEFLT: // calculate all
-        xFac = LnFac(x) + LnFac(x2) + LnFac(m - x) + LnFac(m2 - x2);
+        if (N > LARGE_URN) {
+            xFac = LnFacDiff(x, xRef) + LnFacDiff(x2, n - xRef)
+                + LnFacDiff(m - x, m - xRef) + LnFacDiff(m2 - x2, m2 - n + xRef);
+        }
+        else {
+            xFac = LnFac(x) + LnFac(x2) + LnFac(m - x) + LnFac(m2 - x2);
+        }
     }
     xLast = x;
-    return mFac - xFac + x * logodds - scale;
+    return mFac - xFac + (x - xRef) * logodds - scale;
 }
 
 
@@ -383,7 +574,7 @@ double CFishersNCHypergeometric::lng(int32 x) {
 calculation methods in class CMultiFishersNCHypergeometric
 ***********************************************************************/
 
-CMultiFishersNCHypergeometric::CMultiFishersNCHypergeometric(int32 n_, int32 * m_, double * odds_, int colors_, double accuracy_) {
+CMultiFishersNCHypergeometric::CMultiFishersNCHypergeometric(int64 n_, int64 * m_, double * odds_, int colors_, double accuracy_) {
     // constructor
     int i;                              // loop counter
 
@@ -542,7 +733,7 @@ void CMultiFishersNCHypergeometric::variance(double * var, double * mean_) {
 }
 
 
-double CMultiFishersNCHypergeometric::probability(int32 * x) {
+double CMultiFishersNCHypergeometric::probability(int64 * x) {
     // Calculate probability function.
     // Note: The first-time call takes very long time because it requires
     // a calculation of all possible x combinations with probability >
@@ -550,8 +741,8 @@ double CMultiFishersNCHypergeometric::probability(int32 * x) {
     // The calculation uses logarithms to avoid overflow. 
     // (Recursive calculation may be faster, but this has not been implemented)
     int i, j;                           // color index
-    int32 xsum = 0;                     // sum of x
-    int32 Xu[MAXCOLORS];                // x for used colors
+    int64 xsum = 0;                     // sum of x
+    int64 Xu[MAXCOLORS];                // x for used colors
 
     // resolve unused colors
     for (i = j = 0; i < Colors; i++) {
@@ -582,7 +773,7 @@ double CMultiFishersNCHypergeometric::probability(int32 * x) {
 
     if (reduced & 2) {
         // All odds are equal. This is multivariate central hypergeometric distribution
-        int32 sx = n, sm = N;
+        int64 sx = n, sm = N;
         double p = 1.;
         for (i = 0; i < usedcolors - 1; i++) {
             // Use univariate hypergeometric (usedcolors-1) times
@@ -636,14 +827,14 @@ void CMultiFishersNCHypergeometric::SumOfAll() {
     // The mean and variance are generated as by-products.
 
     int i;                              // color index
-    int32 msum;                         // sum of m[i]
+    int64 msum;                         // sum of m[i]
 
     // get approximate mean
     mean1(sx);
 
     // round mean to integers
     for (i = 0, msum = 0; i < usedcolors; i++) {
-        msum += xm[i] = (int32)(sx[i] + 0.4999999);
+        msum += xm[i] = (int64)(sx[i] + 0.4999999);
     }
     // adjust truncated x values to make the sum = n
     msum -= n;
@@ -681,11 +872,11 @@ void CMultiFishersNCHypergeometric::SumOfAll() {
 }
 
 
-double CMultiFishersNCHypergeometric::loop(int32 n, int c) {
+double CMultiFishersNCHypergeometric::loop(int64 n, int c) {
     // recursive function to loop through all combinations of x-values.
     // used by SumOfAll
-    int32 x, x0;                        // x of color c
-    int32 xmin, xmax;                   // min and max of x[c]
+    int64 x, x0;                        // x of color c
+    int64 xmin, xmax;                   // min and max of x[c]
     double s1, s2, sum = 0.;            // sum of g(x) values
     int i;                              // loop counter
 
@@ -700,6 +891,7 @@ double CMultiFishersNCHypergeometric::loop(int32 n, int c) {
             xi[c] = x;
             sum += s1 = loop(n - x, c + 1); // recursive loop for remaining colors
             if (s1 < accuracy && s1 < s2) break; // stop when values become negligible
+            if (DeadlinePassed()) break;    // stop at time limit or user interrupt
             s2 = s1;
         }
         // loop for all x[c] from mean and down
@@ -707,6 +899,7 @@ double CMultiFishersNCHypergeometric::loop(int32 n, int c) {
             xi[c] = x;
             sum += s1 = loop(n - x, c + 1);   // recursive loop for remaining colors
             if (s1 < accuracy && s1 < s2) break; // stop when values become negligible
+            if (DeadlinePassed()) break;    // stop at time limit or user interrupt
             s2 = s1;
         }
     }
@@ -726,7 +919,7 @@ double CMultiFishersNCHypergeometric::loop(int32 n, int c) {
 }
 
 
-double CMultiFishersNCHypergeometric::lng(int32 * x) {
+double CMultiFishersNCHypergeometric::lng(int64 * x) {
     // natural log of proportional function g(x)
     double y = 0.;
     int i;
@@ -0,0 +1,279 @@
+/*************************** init.cpp **********************************
+* Project:       BiasedUrn
+*
+* Description:
+* Registration of native routines for the R interface, and C-callable
+* functions for use by compiled code in other packages.
+*
+* The .Call entry points in urn1.cpp and urn2.cpp are registered with
+* R_registerRoutines so that R does not have to search for the symbols
+* by name. The R functions call the registered symbols C_dFNCHypergeo etc.
+*
+* The functions named BiasedUrn_... take plain C parameters and are
+* registered with R_RegisterCCallable. Other packages can call these
+* functions through the header file inst/include/BiasedUrn.h.
+* These functions give R errors for invalid parameters. The random variate
+* generating functions use the random number generator of R. The caller
+* must call GetRNGstate() before and PutRNGstate() after generating random
+* variates, as with unif_rand(). None of these functions are thread safe.
+*
+* GNU General Public License v. 3. http://www.gnu.org/licenses/gpl.html
+*****************************************************************************/
+
+#include <R.h>
+#include <Rinternals.h>
+#include <R_ext/Rdynload.h>
+#include "stocc.h"
+
+
+/***********************************************************************
+         .Call entry points in urn1.cpp and urn2.cpp
+***********************************************************************/
+
+extern "C" {
+// urn1.cpp
+SEXP dFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP dWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP dWNCHypergeoTimed(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP pFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP pWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP qFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP qWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP rFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP rWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP momentsFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP momentsWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP modeFNCHypergeo(SEXP, SEXP, SEXP, SEXP);
+SEXP modeWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP summaryFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP summaryWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP oddsFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP oddsWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP ciFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP ciWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP testFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP loglikFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP loglikWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP cacheNCHypergeo(SEXP, SEXP);
+SEXP numFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP numWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+// urn2.cpp
+SEXP dMFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP dMWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP rMFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP rMWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP momentsMFNCHypergeo(SEXP, SEXP, SEXP, SEXP);
+SEXP momentsMWNCHypergeo(SEXP, SEXP, SEXP, SEXP);
+SEXP momentsMWNCHypergeoTimed(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP oddsMFNCHypergeo(SEXP, SEXP, SEXP, SEXP);
+SEXP oddsMWNCHypergeo(SEXP, SEXP, SEXP, SEXP);
+SEXP numMFNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+SEXP numMWNCHypergeo(SEXP, SEXP, SEXP, SEXP, SEXP);
+}
+
+// Registration of ALTREP class for lazy result vectors (urn1.cpp)
+void InitLazyResults(DllInfo * dll);
+
+// The cast goes through void (*)(void), which matches any function type, 
+// so that C++ compilers do not warn about casting between function types
+#define CALLDEF(name, n)  {#name, (DL_FUNC)(void (*)(void)) &name, n}
+
+static const R_CallMethodDef CallEntries[] = {
+    CALLDEF(dFNCHypergeo, 7),
+    CALLDEF(dWNCHypergeo, 7),
+    CALLDEF(dWNCHypergeoTimed, 7),
+    CALLDEF(pFNCHypergeo, 8),
+    CALLDEF(pWNCHypergeo, 8),
+    CALLDEF(qFNCHypergeo, 8),
+    CALLDEF(qWNCHypergeo, 8),
+    CALLDEF(rFNCHypergeo, 8),
+    CALLDEF(rWNCHypergeo, 8),
+    CALLDEF(momentsFNCHypergeo, 6),
+    CALLDEF(momentsWNCHypergeo, 6),
+    CALLDEF(modeFNCHypergeo, 4),
+    CALLDEF(modeWNCHypergeo, 5),
+    CALLDEF(summaryFNCHypergeo, 5),
+    CALLDEF(summaryWNCHypergeo, 5),
+    CALLDEF(oddsFNCHypergeo, 5),
+    CALLDEF(oddsWNCHypergeo, 5),
+    CALLDEF(ciFNCHypergeo, 6),
+    CALLDEF(ciWNCHypergeo, 6),
+    CALLDEF(testFNCHypergeo, 5),
+    CALLDEF(loglikFNCHypergeo, 7),
+    CALLDEF(loglikWNCHypergeo, 7),
+    CALLDEF(cacheNCHypergeo, 2),
+    CALLDEF(numFNCHypergeo, 5),
+    CALLDEF(numWNCHypergeo, 5),
+    CALLDEF(dMFNCHypergeo, 5),
+    CALLDEF(dMWNCHypergeo, 5),
+    CALLDEF(rMFNCHypergeo, 8),
+    CALLDEF(rMWNCHypergeo, 8),
+    CALLDEF(momentsMFNCHypergeo, 4),
+    CALLDEF(momentsMWNCHypergeo, 4),
+    CALLDEF(momentsMWNCHypergeoTimed, 5),
+    CALLDEF(oddsMFNCHypergeo, 4),
+    CALLDEF(oddsMWNCHypergeo, 4),
+    CALLDEF(numMFNCHypergeo, 5),
+    CALLDEF(numMWNCHypergeo, 5),
+    {NULL, NULL, 0}
+};
+
+
+/***********************************************************************
+         C-callable functions
+***********************************************************************/
+
+static double CheckUnivariate(int m1, int m2, int n, double odds, double prec) {
+    // Check validity of parameters for univariate distributions.
+    // Returns the precision, replaced by the default value if invalid
+    if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
+    if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
+    if (n > (int64)m1 + m2) FatalError("n > m1 + m2: Taking more items than there are");
+    if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+    return prec;
+}
+
+static double CheckMultivariate(const int * m, int64 * m64, const double * odds, int n, int colors, double prec) {
+    // Check validity of parameters for multivariate distributions.
+    // m is copied to m64, which must have space for MAXCOLORS values.
+    // Returns the precision, replaced by the default value if invalid
+    int64 N = 0, Nu = 0;                // Total number of balls, balls with nonzero odds
+    if (colors < 1) FatalError("Number of colors too small");
+    if (colors > MAXCOLORS) FatalError("Number of colors exceeds MAXCOLORS");
+    for (int i = 0; i < colors; i++) {
+        if (m[i] < 0) FatalError("Negative parameter m");
+        if (!R_FINITE(odds[i]) || odds[i] < 0) FatalError("Invalid value for odds");
+        N += m64[i] = m[i];
+        if (odds[i]) Nu += m[i];
+    }
+    if (n < 0)  FatalError("Negative parameter n");
+    if (n > N)  FatalError("n > sum(m): Taking more items than there are");
+    if (n > Nu) FatalError("Not enough items with nonzero odds");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+    return prec;
+}
+
+static double TableCumulative(int fisher, int x, int m1, int m2, int n, double odds, double prec, int lower_tail) {
+    // Cumulative distribution function for one x, using CNCHypergeometricTable
+    const void * vmax = vmaxget();      // Release memory allocated here when done
+    CNCHypergeometricTable tab(fisher, n, m1, (int64)m1 + m2, odds, CheckUnivariate(m1, m2, n, odds, prec));
+    int32 len = tab.TableLength();
+    tab.MakeTable((double*)R_alloc(len, sizeof(double)), len);
+    double p = tab.cumulative(x, lower_tail);
+    vmaxset(vmax);
+    return p;
+}
+
+static int TableQuantile(int fisher, double p, int m1, int m2, int n, double odds, double prec, int lower_tail) {
+    // Quantile function for one p, using CNCHypergeometricTable
+    if (!R_FINITE(p) || p < 0. || p > 1.) return NA_INTEGER;
+    const void * vmax = vmaxget();      // Release memory allocated here when done
+    CNCHypergeometricTable tab(fisher, n, m1, (int64)m1 + m2, odds, CheckUnivariate(m1, m2, n, odds, prec));
+    int32 len = tab.TableLength();
+    tab.MakeTable((double*)R_alloc(len, sizeof(double)), len);
+    int x = (int)tab.quantile(p, lower_tail);
+    vmaxset(vmax);
+    return x;
+}
+
+// Random variate generator. Kept between calls so that set-up values are
+// reused when called repeatedly with the same parameters
+static StochasticLib3 CallableSto(0);
+
+extern "C" {
+
+double BiasedUrn_dFNCHypergeo(int x, int m1, int m2, int n, double odds, double precision) {
+    precision = CheckUnivariate(m1, m2, n, odds, precision);
+    return CFishersNCHypergeometric(n, m1, (int64)m1 + m2, odds, precision).probability(x);
+}
+
+double BiasedUrn_dWNCHypergeo(int x, int m1, int m2, int n, double odds, double precision) {
+    precision = CheckUnivariate(m1, m2, n, odds, precision);
+    return CWalleniusNCHypergeometric(n, m1, (int64)m1 + m2, odds, precision).probability(x);
+}
+
+double BiasedUrn_pFNCHypergeo(int x, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    return TableCumulative(1, x, m1, m2, n, odds, precision, lower_tail);
+}
+
+double BiasedUrn_pWNCHypergeo(int x, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    return TableCumulative(0, x, m1, m2, n, odds, precision, lower_tail);
+}
+
+int BiasedUrn_qFNCHypergeo(double p, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    return TableQuantile(1, p, m1, m2, n, odds, precision, lower_tail);
+}
+
+int BiasedUrn_qWNCHypergeo(double p, int m1, int m2, int n, double odds, double precision, int lower_tail) {
+    return TableQuantile(0, p, m1, m2, n, odds, precision, lower_tail);
+}
+
+int BiasedUrn_rFNCHypergeo(int m1, int m2, int n, double odds, double precision) {
+    CallableSto.SetAccuracy(CheckUnivariate(m1, m2, n, odds, precision));
+    return (int)CallableSto.FishersNCHyp(n, m1, (int64)m1 + m2, odds);
+}
+
+int BiasedUrn_rWNCHypergeo(int m1, int m2, int n, double odds, double precision) {
+    CallableSto.SetAccuracy(CheckUnivariate(m1, m2, n, odds, precision));
+    return (int)CallableSto.WalleniusNCHyp(n, m1, (int64)m1 + m2, odds);
+}
+
+double BiasedUrn_dMFNCHypergeo(const int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    int64 m64[MAXCOLORS], x64[MAXCOLORS];
+    precision = CheckMultivariate(m, m64, odds, n, colors, precision);
+    for (int i = 0; i < colors; i++) x64[i] = x[i];
+    CMultiFishersNCHypergeometric mfnc(n, m64, (double*)odds, colors, precision);
+    return mfnc.probability(x64);
+}
+
+double BiasedUrn_dMWNCHypergeo(const int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    int64 m64[MAXCOLORS], x64[MAXCOLORS];
+    precision = CheckMultivariate(m, m64, odds, n, colors, precision);
+    for (int i = 0; i < colors; i++) x64[i] = x[i];
+    CMultiWalleniusNCHypergeometric mwnc(n, m64, (double*)odds, colors, precision);
+    return mwnc.probability(x64);
+}
+
+void BiasedUrn_rMFNCHypergeo(int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    int64 m64[MAXCOLORS], x64[MAXCOLORS];
+    CallableSto.SetAccuracy(CheckMultivariate(m, m64, odds, n, colors, precision));
+    CallableSto.MultiFishersNCHyp(x64, m64, (double*)odds, n, colors);
+    for (int i = 0; i < colors; i++) x[i] = (int)x64[i];
+}
+
+void BiasedUrn_rMWNCHypergeo(int * x, const int * m, const double * odds, int n, int colors, double precision) {
+    int64 m64[MAXCOLORS], x64[MAXCOLORS];
+    CallableSto.SetAccuracy(CheckMultivariate(m, m64, odds, n, colors, precision));
+    CallableSto.MultiWalleniusNCHyp(x64, m64, (double*)odds, n, colors);
+    for (int i = 0; i < colors; i++) x[i] = (int)x64[i];
+}
+
+
+/***********************************************************************
+         R_init_BiasedUrn
+***********************************************************************/
+// Called by R when the package is loaded
+
+#define CCALLABLE(name)  R_RegisterCCallable("BiasedUrn", #name, (DL_FUNC)(void (*)(void)) &name)
+
+void R_init_BiasedUrn(DllInfo * dll) {
+    R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
+    R_useDynamicSymbols(dll, FALSE);
+    InitLazyResults(dll);
+
+    CCALLABLE(BiasedUrn_dFNCHypergeo);
+    CCALLABLE(BiasedUrn_dWNCHypergeo);
+    CCALLABLE(BiasedUrn_pFNCHypergeo);
+    CCALLABLE(BiasedUrn_pWNCHypergeo);
+    CCALLABLE(BiasedUrn_qFNCHypergeo);
+    CCALLABLE(BiasedUrn_qWNCHypergeo);
+    CCALLABLE(BiasedUrn_rFNCHypergeo);
+    CCALLABLE(BiasedUrn_rWNCHypergeo);
+    CCALLABLE(BiasedUrn_dMFNCHypergeo);
+    CCALLABLE(BiasedUrn_dMWNCHypergeo);
+    CCALLABLE(BiasedUrn_rMFNCHypergeo);
+    CCALLABLE(BiasedUrn_rMWNCHypergeo);
+}
+
+}
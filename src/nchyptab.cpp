@@ -0,0 +1,446 @@
+/*************************** nchyptab.cpp **********************************
+* Project:       BiasedUrn
+*
+* Description:
+* Table of probabilities and cumulative probabilities for the univariate
+* Fisher's and Wallenius' noncentral hypergeometric distributions.
+*
+* This file contains source code for the class CNCHypergeometricTable
+* defined in stocc.h.
+*
+* The table is made with MakeTable of CFishersNCHypergeometric or
+* CWalleniusNCHypergeometric. The cumulative probabilities are summed
+* both from the left and from the right, so that the tail with the
+* smallest probabilities can be calculated without loss of precision.
+* The table does not allocate any memory. The caller must supply a buffer
+* of the size returned by TableLength. This makes it possible to use
+* the class in multiple threads with one buffer for each thread.
+*
+* The class CAliasTable makes an alias table for generating random variates
+* from a table of probabilities in constant time. It is used by
+* CNCHypergeometricTable, by the random variate generating functions in
+* urn1.cpp, and by StochasticLib3::WalleniusNCHypTable.
+*
+* The class CMultiFishersNCHypergeometricTable makes alias tables for exact
+* sampling from the multivariate Fisher's noncentral hypergeometric 
+* distribution. The probability of x[i] balls of color i, given that s 
+* balls remain to be taken of colors >= i, is proportional to
+* f[i](x[i]) * G[i+1](s-x[i]), where f[i](x) = binomial(m[i],x) * odds[i]^x
+* and G[i](s) is the sum of the products of f over all combinations of
+* colors >= i with a total of s balls. G is calculated backwards from the
+* last color by convolution. An alias table is made for each color i and
+* each possible s. The variate is generated color by color, with no 
+* approximation other than floating point rounding.
+*
+* GNU General Public License http://www.gnu.org/licenses/gpl.html
+*****************************************************************************/
+
+#include "stocc.h"                     // class definition
+
+
+/***********************************************************************
+Methods for class CNCHypergeometricTable
+***********************************************************************/
+
+CNCHypergeometricTable::CNCHypergeometricTable(int fisher, int64 n, int64 m, int64 N, double odds, double accuracy)
+: fnc(n, m, N, odds, accuracy), wnc(n, m, N, odds, accuracy) {
+    // constructor
+    this->fisher = fisher;
+    cutoff = accuracy * 0.001;          // cut off tails below this value
+    xmin = m + n - N;  if (xmin < 0) xmin = 0;
+    xmax = n;  if (xmax > m) xmax = m;
+    x1 = xmin;  x2 = xmax;  xmean = xmin;
+    Length = 0;  useTable = false;  useAlias = false;
+    table = cleft = cright = 0;
+    sum = factor = 1.;
+}
+
+
+int32 CNCHypergeometricTable::TableLength(void) {
+    // Get necessary buffer length.
+    // The buffer contains three parts of equal size: the table of probabilities,
+    // the cumulative sum from the left and the cumulative sum from the right.
+    if (Length == 0) {
+        if (fisher) {
+            double len = fnc.MakeTable(0, 0, &x1, &x2, &useTable, cutoff);
+            Length = len < LARGE_URN / 3 ? (int32)len : (int32)(LARGE_URN / 3);
+        }
+        else {
+            Length = wnc.MakeTable(0, 0, &x1, &x2, &useTable, cutoff);
+            if (Length > LARGE_URN / 3) Length = (int32)(LARGE_URN / 3);
+        }
+        if (Length <= 0) Length = 1;
+    }
+    return 3 * Length;
+}
+
+
+bool CNCHypergeometricTable::UseTable(int32 nx) {
+    // Check if it is advantageous to make a table for calculating nx values
+    // of the probability function. The cumulative distribution function and
+    // the quantile function always need a table.
+    if (nx <= 1) return false;
+    TableLength();
+    if (fisher) return (uint32)nx > (uint32)Length / 32;
+    return useTable;
+}
+
+
+void CNCHypergeometricTable::MakeTable(double * buffer, int32 BufferLength) {
+    // Make table of probabilities and cumulative probabilities.
+    // The buffer must have the length returned by TableLength
+    int64 x;                            // x value
+    double s;                           // sum
+
+    if (BufferLength < TableLength()) FatalError("Buffer too small in CNCHypergeometricTable");
+    table = buffer;  cleft = buffer + Length;  cright = cleft + Length;
+
+    if (fisher) {
+        // Table is scaled by an arbitrary factor
+        sum = fnc.MakeTable(table, Length, &x1, &x2, &useTable, cutoff);
+        factor = 1. / sum;
+        xmean = (int64)(fnc.mean() + 0.5);
+    }
+    else {
+        // Table contains probabilities
+        wnc.MakeTable(table, Length, &x1, &x2, &useTable, cutoff);
+        sum = factor = 1.;
+        xmean = (int64)(wnc.mean() + 0.5);
+    }
+    if (x2 >= x1 + Length) x2 = x1 + Length - 1;
+    // The rounded mean may be outside the table if the distribution is very skewed
+    if (xmean < x1) xmean = x1;
+    if (xmean > x2) xmean = x2;
+
+    // Make cumulative tables from the left and from the right
+    for (x = x1, s = 0; x <= x2; x++) cleft[x - x1] = s += table[x - x1];
+    for (x = x2, s = 0; x >= x1; x--) cright[x - x1] = s += table[x - x1];
+}
+
+
+double CNCHypergeometricTable::probability(int64 x) {
+    // Probability function. Uses the table if made, and if x is within the table.
+    if (x < xmin || x > xmax) return 0.;
+    if (table && x >= x1 && x <= x2) return table[x - x1] * factor;
+    // Outside table. Result is very small but not 0
+    if (fisher) return fnc.probability(x);
+    return wnc.probability(x);
+}
+
+
+double CNCHypergeometricTable::cumulative(int64 x, int lower_tail) {
+    // Cumulative distribution function. Returns P(X <= x) if lower_tail,
+    // otherwise P(X > x). MakeTable must be called first.
+    // Probabilities for x > xmean are calculated by summation from the
+    // right in order to avoid loss of precision.
+    double p;
+    if (x <= xmean) {
+        // Left tail
+        p = x < x1 ? 0. : cleft[x - x1] * factor;
+        if (!lower_tail) p = 1. - p;    // Invert if right tail
+    }
+    else {
+        // Right tail
+        p = x >= x2 ? 0. : cright[x - x1 + 1] * factor;
+        if (lower_tail) p = 1. - p;     // Invert if left tail
+    }
+    return p;
+}
+
+
+int64 CNCHypergeometricTable::quantile(double p, int lower_tail) {
+    // Quantile function. Returns the lowest x for which P(X<=x) >= p
+    // when lower_tail, or the lowest x for which P(X >x) <= p when not
+    // lower_tail. p must be in the interval [0,1]. MakeTable must be
+    // called first.
+    uint32 a, b, c;                     // Used in binary search
+    int64 x;
+    if (!lower_tail) p = 1. - p;        // Invert if right tail
+    p *= sum;                           // Table is scaled by sum
+
+    // Binary search in table
+    a = 0;  b = (uint32)(x2 - x1 + 1);
+    while (a < b) {
+        c = (a + b) / 2;
+        if (p <= cleft[c]) {
+            b = c;
+        }
+        else {
+            a = c + 1;
+        }
+    }
+    x = x1 + a;
+    if (x > x2) x = x2;                 // Prevent values > xmax that occur because of small imprecisions
+    return x;
+}
+
+
+int32 CNCHypergeometricTable::AliasTableLength(void) {
+    // Get necessary buffer length for MakeAliasTable. 
+    // MakeTable must be called first.
+    return CAliasTable::TableLength((int32)(x2 - x1 + 1));
+}
+
+
+void CNCHypergeometricTable::MakeAliasTable(double * buffer, int32 BufferLength) {
+    // Make alias table so that random variates can be generated in constant 
+    // time. The buffer must have the length returned by AliasTableLength.
+    // MakeTable must be called first.
+    if (BufferLength < AliasTableLength()) FatalError("Buffer too small in CNCHypergeometricTable");
+    aliasTable.MakeTable(table, (int32)(x2 - x1 + 1), buffer);
+    useAlias = true;
+}
+
+
+int64 CNCHypergeometricTable::random(double u) {
+    // Random variate generation from the alias table if made, otherwise by 
+    // inversion of the table. 
+    // u is a uniform random number in the interval [0,1).
+    // MakeTable must be called first.
+    uint32 a, b, c;                     // Used in binary search
+    int64 x;
+    if (useAlias) return x1 + aliasTable.random(u);
+    u *= cleft[x2 - x1];                // Sum of table. May be slightly less than 1 if tails are cut off
+
+    // Binary search in table
+    a = 0;  b = (uint32)(x2 - x1 + 1);
+    while (a < b) {
+        c = (a + b) / 2;
+        if (u < cleft[c]) {
+            b = c;
+        }
+        else {
+            a = c + 1;
+        }
+    }
+    x = x1 + a;
+    if (x > x2) x = x2;                 // Prevent values > xmax that occur because of small imprecisions
+    return x;
+}
+
+
+/***********************************************************************
+Methods for class CAliasTable
+***********************************************************************/
+
+void CAliasTable::MakeTable(const double * p, int32 n, double * buffer) {
+    // Make alias table from n probabilities p. The probabilities do not 
+    // have to be normalized. The buffer must have the length returned by 
+    // TableLength(n). 
+    // Vose's algorithm: Each entry with a probability below the average 
+    // (small) is filled up by an entry with a probability above the average
+    // (large). The small and large entries are found by two indexes that
+    // scan the table from the left, so that no work list is needed. 
+    // An unused alias is -1.
+    int32 i, j, s;                      // Index of small, large, and current small entry
+    double sum;                         // Sum of probabilities
+
+    if (n <= 0) FatalError("Empty table in CAliasTable");
+    this->n = n;  prob = buffer;  alias = buffer + n;
+
+    // Scale probabilities so that the average is 1
+    for (i = 0, sum = 0.; i < n; i++) sum += p[i];
+    if (!(sum > 0.)) FatalError("Zero probabilities in CAliasTable");
+    for (i = 0; i < n; i++) {
+        prob[i] = p[i] * (n / sum);
+        alias[i] = -1.;
+    }
+
+    // Find first small and first large entry
+    for (i = 0; i < n && prob[i] >= 1.; i++);
+    for (j = 0; j < n && prob[j] < 1.; j++);
+    s = i;
+    while (s < n && j < n) {
+        // Fill up small entry s with large entry j
+        alias[s] = j;
+        prob[j] -= 1. - prob[s];
+        if (prob[j] < 1.) {
+            // j has become small. Take it next
+            s = j;
+            for (j++; j < n && (prob[j] < 1. || alias[j] >= 0.); j++);
+        }
+        else {
+            // Find next small entry that is not done
+            for (i++; i < n && (prob[i] >= 1. || alias[i] >= 0.); i++);
+            s = i;
+        }
+    }
+    // The remaining entries are 1 except for rounding errors
+    for (i = 0; i < n; i++) {
+        if (alias[i] < 0.) {
+            prob[i] = 1.;  alias[i] = i;
+        }
+    }
+}
+
+
+/***********************************************************************
+Methods for class CMultiFishersNCHypergeometricTable
+***********************************************************************/
+
+CMultiFishersNCHypergeometricTable::CMultiFishersNCHypergeometricTable(int64 n, int64 * m, double * odds, int colors) {
+    // constructor
+    int i;                              // color index
+    int64 sum;                          // sum of m for used colors before i
+    if (colors < 0 || colors > MAXCOLORS) FatalError("Too many colors in CMultiFishersNCHypergeometricTable");
+    this->n = n;  this->colors = colors;
+    Length = 0;  table = 0;
+
+    // remove colors with m = 0 or odds = 0
+    for (i = usedcolors = 0; i < colors; i++) {
+        if (m[i] < 0 || odds[i] < 0) FatalError("Negative parameter in CMultiFishersNCHypergeometricTable");
+        if (m[i] > 0 && odds[i] > 0.) {
+            nonzero[usedcolors] = i;
+            this->m[usedcolors] = m[i];
+            logodds[usedcolors] = log(odds[i]);
+            usedcolors++;
+        }
+    }
+    remaining[usedcolors] = 0;
+    for (i = usedcolors - 1; i >= 0; i--) remaining[i] = remaining[i+1] + this->m[i];
+    if (n < 0 || n > remaining[0]) FatalError("Not enough items with nonzero weight in CMultiFishersNCHypergeometricTable");
+
+    // range of balls left to take before each color
+    for (i = 0, sum = 0; i < usedcolors; i++) {
+        slo[i] = n - sum;  if (slo[i] < 0) slo[i] = 0;
+        shi[i] = remaining[i];  if (shi[i] > n) shi[i] = n;
+        sum += this->m[i];
+    }
+
+    // The buffer starts with space for temporary tables used by MakeTable, 
+    // followed by the position of an alias table for each color and each 
+    // possible number of balls left to take. The last color needs no table
+    headLength = 3. * (double)(n + 1);
+    for (i = 0; i < usedcolors - 1; i++) {
+        cellBase[i] = headLength < LARGE_URN ? (int32)headLength : 0; // not used if too big
+        headLength += (double)(shi[i] - slo[i] + 1);
+    }
+}
+
+
+int32 CMultiFishersNCHypergeometricTable::TableLength(int32 MaxLength) {
+    // Get necessary buffer length, or 0 if the length would exceed MaxLength.
+    // The buffer contains the positions made by the constructor followed by
+    // the alias tables. The time used is proportional to the length.
+    int i;                              // color index
+    int64 s;                            // balls left to take
+    int64 len;                          // number of possible x for one s
+    double total = headLength;          // total length
+    if (Length) return Length <= MaxLength ? Length : 0;
+    if (total > MaxLength) return 0;
+    for (i = 0; i < usedcolors - 1; i++) {
+        for (s = slo[i]; s <= shi[i]; s++) {
+            len = s - remaining[i+1];  if (len < 0) len = 0;
+            len = (s < m[i] ? s : m[i]) - len + 1;
+            if (len > 1) total += CAliasTable::TableLength((int32)len);
+        }
+        if (total > MaxLength) return 0;
+    }
+    Length = (int32)total;
+    return Length;
+}
+
+
+void CMultiFishersNCHypergeometricTable::MakeTable(double * buffer, int32 BufferLength) {
+    // Make table in buffer. The buffer must have the length returned by 
+    // TableLength. 
+    // The table is made backwards from the last color. lg contains
+    // ln(G[i+1](s)) for s from slo[i+1] to shi[i+1], and lf contains
+    // ln(f[i](x)). The probabilities for each s are stored directly in the 
+    // space for the alias table.
+    int i;                              // color index
+    int64 s, x;                         // balls left to take, balls of color i
+    int64 x1, x2;                       // range of x for one s
+    int32 len, pos;                     // length and position of alias table
+    double * lf, * lg, * lg2;           // temporary tables
+    double lmax, sum;                   // for scaling probabilities
+    CAliasTable alias;
+
+    if (Length == 0 || BufferLength < Length) FatalError("Buffer too small in CMultiFishersNCHypergeometricTable");
+    table = buffer;
+    if (usedcolors < 2) return;         // no table needed
+    lf = buffer;  lg = buffer + (n + 1);  lg2 = lg + (n + 1);
+
+    // G for last color is f
+    i = usedcolors - 1;
+    for (x = 0, lf[0] = 0.; x < shi[i]; x++) {
+        lf[x+1] = lf[x] + log((double)(m[i] - x) / (double)(x + 1)) + logodds[i];
+    }
+    for (s = slo[i]; s <= shi[i]; s++) lg[s - slo[i]] = lf[s];
+
+    // alias tables are placed after the table positions
+    pos = cellBase[usedcolors - 2] + (int32)(shi[usedcolors - 2] - slo[usedcolors - 2] + 1);
+
+    for (i = usedcolors - 2; i >= 0; i--) {
+        // ln(f[i](x)) by recursion
+        x2 = m[i] < shi[i] ? m[i] : shi[i];
+        for (x = 0, lf[0] = 0.; x < x2; x++) {
+            lf[x+1] = lf[x] + log((double)(m[i] - x) / (double)(x + 1)) + logodds[i];
+        }
+        for (s = slo[i]; s <= shi[i]; s++) {
+            x1 = s - remaining[i+1];  if (x1 < 0) x1 = 0;
+            x2 = s < m[i] ? s : m[i];
+            len = (int32)(x2 - x1 + 1);
+            lmax = -1.E300;
+            for (x = x1; x <= x2; x++) {
+                double l = lf[x] + lg[s - x - slo[i+1]];
+                if (l > lmax) lmax = l;
+            }
+            if (len > 1) {
+                // make alias table for this s
+                double * p = buffer + pos;
+                for (x = x1, sum = 0.; x <= x2; x++) {
+                    sum += p[x - x1] = exp(lf[x] + lg[s - x - slo[i+1]] - lmax);
+                }
+                alias.MakeTable(p, len, p);
+                buffer[cellBase[i] + (s - slo[i])] = pos;
+                pos += CAliasTable::TableLength(len);
+            }
+            else {
+                sum = 1.;
+                buffer[cellBase[i] + (s - slo[i])] = -1.;
+            }
+            lg2[s - slo[i]] = lmax + log(sum);
+        }
+        // swap lg and lg2
+        double * t = lg;  lg = lg2;  lg2 = t;
+    }
+}
+
+
+void CMultiFishersNCHypergeometricTable::UseTable(double * buffer) {
+    // Use a table previously made by MakeTable in buffer by an object with the 
+    // same parameters. 
+    if (headLength > LARGE_URN) FatalError("Table too big in CMultiFishersNCHypergeometricTable");
+    table = buffer;
+}
+
+
+void CMultiFishersNCHypergeometricTable::random(int64 * x, const double * u) {
+    // Random variate generation. u must contain colors uniform random 
+    // numbers in the interval [0,1). The variate is stored in x[0..colors-1].
+    // MakeTable or UseTable must be called first.
+    int i;                              // used color index
+    int64 s = n;                        // balls left to take
+    int64 x1, x2, xi;                   // range of x and sampled x for color i
+    double pos;                         // position of alias table
+    CAliasTable alias;
+
+    for (i = 0; i < colors; i++) x[i] = 0;
+    if (usedcolors == 0) return;
+    for (i = 0; i < usedcolors - 1; i++) {
+        pos = table[cellBase[i] + (s - slo[i])];
+        x1 = s - remaining[i+1];  if (x1 < 0) x1 = 0;
+        if (pos < 0.) {
+            xi = x1;                    // only one possible value
+        }
+        else {
+            x2 = s < m[i] ? s : m[i];
+            alias.UseTable(table + (int32)pos, (int32)(x2 - x1 + 1));
+            xi = x1 + alias.random(u[i]);
+        }
+        x[nonzero[i]] = xi;
+        s -= xi;
+    }
+    x[nonzero[i]] = s;                  // last color takes the rest
+}
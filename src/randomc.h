@@ -104,6 +104,10 @@
    typedef unsigned int       uint32;     // 32 bit unsigned integer
 #endif
 
+// Define 64 bit signed integer. Used for the number of balls in an urn, 
+// which may exceed the range of a 32 bit integer
+typedef long long int      int64;      // 64 bit signed integer
+
 /***********************************************************************
          System-specific user interface functions
 ***********************************************************************/
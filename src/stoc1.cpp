@@ -32,7 +32,7 @@ const double SHAT2 = 0.8989161620588987408;   // 3-sqrt(12/e)
 /***********************************************************************
 Log factorial function
 ***********************************************************************/
-double LnFac(int32 n) {
+double LnFac(int64 n) {
     // log factorial function. gives natural logarithm of n!
 
     // define constants
@@ -64,24 +64,45 @@ double LnFac(int32 n) {
     }
     // not found in table. use Stirling approximation
     double  n1, r;
-    n1 = n;  r = 1. / n1;
+    n1 = (double)n;  r = 1. / n1;
     return (n1 + 0.5) * log(n1) - n1 + C0 + r * (C1 + r * r * C3);
 }
 
 
+double LnFacDiff(int64 a, int64 b) {
+    // Difference of log factorials, LnFac(a) - LnFac(b).
+    // LnFac(a) - LnFac(b) loses precision when a and b are big, because 
+    // the log factorials are much bigger than their difference. This function
+    // calculates the difference directly from the Stirling approximation
+    // with d = a - b:
+    // LnFac(a) - LnFac(b) = d*log(b) + (a+0.5)*log(1+d/b) - d + correction terms
+    static const double C1 = 1. / 12., C3 = -1. / 360.;
+    double a1, b1, d, ra, rb;
+    if (a < FAK_LEN || b < FAK_LEN) {
+        return LnFac(a) - LnFac(b);      // small values are tabulated
+    }
+    a1 = (double)a;  b1 = (double)b;  d = (double)(a - b);
+    ra = 1. / a1;  rb = 1. / b1;
+    return d * log(b1) + (a1 + 0.5) * log1p(d * rb) - d
+        + ra * (C1 + ra * ra * C3) - rb * (C1 + rb * rb * C3);
+}
+
+
 /***********************************************************************
 Constructor
 ***********************************************************************/
 StochasticLib1::StochasticLib1(int seed)
     : STOC_BASE(seed) {
     normal_x2_valid = 0;
+    for (int i = 0; i < HYP_ENTRIES; i++) hypSetup[i].lastUse = 0; // set-up cache is empty
+    hypClock = 0;
 }
 
 
 /***********************************************************************
 Hypergeometric distribution
 ***********************************************************************/
-int32 StochasticLib1::Hypergeometric(int32 n, int32 m, int32 N) {
+int64 StochasticLib1::Hypergeometric(int64 n, int64 m, int64 N) {
     /*
     This function generates a random variate with the hypergeometric
     distribution. This is the distribution you get when drawing balls without
@@ -92,48 +113,162 @@ int32 StochasticLib1::Hypergeometric(int32 n, int32 m, int32 N) {
     This function uses inversion by chop-down search from the mode when
     parameters are small, and the ratio-of-uniforms method when the former
     method would be too slow or would give overflow.
+
+    The set-up is saved in a cache for the most recently used parameters.
     */
 
-    int32 fak, addd;                    // used for undoing transformations
-    int32 x;                            // result
+    // check if parameters are valid
+    if (n > N || m > N || n < 0 || m < 0) {
+        FatalError("Parameter out of range in hypergeometric function");
+    }
+    // cases with only one possible result end here without using the cache
+    if (n == 0 || m == 0) return 0;
+    if (m == N) return n;
+    if (n == N) return m;
+
+    return Hypergeometric(FindHypSetup(n, m, N));
+}
+
+
+StochasticLib1::SHypSetup & StochasticLib1::FindHypSetup(int64 n, int64 m, int64 N) {
+    // Find the set-up cache entry for these parameters. If not found, the 
+    // least recently used entry is replaced by a new set-up
+    int i, oldest = 0;                  // index of entry
+    hypClock++;
+    for (i = 0; i < HYP_ENTRIES; i++) {
+        SHypSetup & e = hypSetup[i];
+        if (e.lastUse && e.n == n && e.m == m && e.N == N) {
+            e.lastUse = hypClock;
+            return e;
+        }
+        if (e.lastUse < hypSetup[oldest].lastUse) oldest = i;
+    }
+    SHypSetup & e = hypSetup[oldest];
+    HypergeometricSetup(e, n, m, N);
+    e.lastUse = hypClock;
+    return e;
+}
+
+
+void StochasticLib1::HypergeometricSetup(SHypSetup & setup, int64 n, int64 m, int64 N) {
+    // Make the set-up for the hypergeometric distribution: symmetry 
+    // transformations, choice of method, and the set-up for the method.
+    // The set-up does not use random numbers
+    int64 x;                            // temporary
+    int64 L;                            // N-m-n
+    double Mp, np;                      // m + 1, n + 1
+    double p;                           // temporary
+    double modef;                       // mode, float
+    double rNN;                         // 1/(N*(N+2))
+    double my;                          // mean
+    double var;                         // variance
 
     // check if parameters are valid
     if (n > N || m > N || n < 0 || m < 0) {
         FatalError("Parameter out of range in hypergeometric function");
     }
+    setup.n = n;  setup.m = m;  setup.N = N;  setup.lastUse = 0;
 
     // symmetry transformations
-    fak = 1;  addd = 0;
+    setup.fak = 1;  setup.addd = 0;
     if (m > N / 2) {
         // invert m
         m = N - m;
-        fak = -1;  addd = n;
+        setup.fak = -1;  setup.addd = n;
     }
     if (n > N / 2) {
         // invert n
         n = N - n;
-        addd += fak * m;  fak = -fak;
+        setup.addd += setup.fak * m;  setup.fak = -setup.fak;
     }
     if (n > m) {
         // swap n and m
         x = n;  n = m;  m = x;
     }
-    // cases with only one possible result end here
-    if (n == 0)  return addd;
+    setup.tn = n;  setup.tm = m;
+    L = N - m - n;
 
     //------------------------------------------------------------------
     //                 choose method
     //------------------------------------------------------------------
-    if (N > 680 || n > 70) {
-        // use ratio-of-uniforms method
-        x = HypRatioOfUnifoms(n, m, N);
+    if (n == 0) {
+        // only one possible result
+        setup.method = 0;
+    }
+    else if (N > 680 || n > 70) {
+        // ratio-of-uniforms method
+        setup.method = 2;
+        rNN = 1. / ((double)N * (N + 2));                      // make two divisions in one
+        my = (double)n * m * rNN * (N + 2);                    // mean = n*m/N
+        setup.mode = (int64)(double(n + 1) * double(m + 1) * rNN * N); // mode = floor((n+1)*(m+1)/(N+2))
+        var = (double)n * m * (N - m) * (N - n) / ((double)N * N * (N - 1)); // variance
+        setup.h = sqrt(SHAT1 * (var + 0.5)) + SHAT2;           // hat width
+        setup.a = my + 0.5;                                    // hat center
+        setup.g = fc_lnpk(setup.mode, L, m, n);                // maximum
+        setup.bound = (int64)(setup.a + 4.0 * setup.h);        // safety-bound
+        if (setup.bound > n) setup.bound = n;
     }
     else {
         // inversion method, using chop-down search from mode
-        x = HypInversionMod(n, m, N);
+        setup.method = 1;
+        Mp = (double)(m + 1);
+        np = (double)(n + 1);
+        p = Mp / (N + 2.);
+        modef = np * p;                       // mode, real
+        setup.mode = (int64)modef;            // mode, integer
+        if (setup.mode == modef && p == 0.5) {
+            setup.mp = setup.mode--;
+        }
+        else {
+            setup.mp = setup.mode + 1;
+        }
+        // mode probability, using log factorial function
+        // (may read directly from fac_table if N < FAK_LEN)
+        setup.fm = exp(LnFac(N - m) - LnFac(L + setup.mode) - LnFac(n - setup.mode)
+            + LnFac(m) - LnFac(m - setup.mode) - LnFac(setup.mode)
+            - LnFac(N) + LnFac(N - n) + LnFac(n));
+
+        // safety bound - guarantees at least 17 significant decimal digits
+        // bound = min(n, (int64)(modef + k*c'))
+        setup.bound = (int64)(modef + 11. * sqrt(modef * (1. - p) * (1. - n / (double)N) + 1.));
+        if (setup.bound > n) setup.bound = n;
+    }
+}
+
+
+int64 StochasticLib1::Hypergeometric(const SHypSetup & setup) {
+    // Hypergeometric distribution with set-up made by HypergeometricSetup
+    int64 x;                            // result before undoing transformations
+    switch (setup.method) {
+    case 0:                             // only one possible result
+        return setup.addd;
+    case 1:                             // inversion method
+        x = HypInversionMod(setup);  break;
+    default:                            // ratio-of-uniforms method
+        x = HypRatioOfUnifoms(setup);  break;
     }
     // undo symmetry transformations  
-    return x * fak + addd;
+    return x * setup.fak + setup.addd;
+}
+
+
+void StochasticLib1::HypergeometricBatch(int64 * x, int64 k, int64 n, int64 m, int64 N) {
+    // Generate k variates with the hypergeometric distribution into x.
+    // The set-up is looked up once and the method is chosen once for all
+    // the variates
+    int64 i;                            // loop counter
+    SHypSetup & setup = FindHypSetup(n, m, N);
+    switch (setup.method) {
+    case 0:                             // only one possible result
+        for (i = 0; i < k; i++) x[i] = setup.addd;
+        break;
+    case 1:                             // inversion method
+        for (i = 0; i < k; i++) x[i] = HypInversionMod(setup) * setup.fak + setup.addd;
+        break;
+    default:                            // ratio-of-uniforms method
+        for (i = 0; i < k; i++) x[i] = HypRatioOfUnifoms(setup) * setup.fak + setup.addd;
+        break;
+    }
 }
 
 
@@ -141,9 +276,10 @@ int32 StochasticLib1::Hypergeometric(int32 n, int32 m, int32 N) {
 Subfunctions used by hypergeometric
 ***********************************************************************/
 
-int32 StochasticLib1::HypInversionMod(int32 n, int32 m, int32 N) {
+int64 StochasticLib1::HypInversionMod(const SHypSetup & s) {
     /*
-    Subfunction for Hypergeometric distribution. Assumes 0 <= n <= m <= N/2.
+    Subfunction for Hypergeometric distribution. Assumes 0 <= n <= m <= N/2,
+    where n and m are the transformed parameters in the set-up.
     Overflow protection is needed when N > 680 or n > 75.
 
     Hypergeometric distribution by inversion method, using down-up
@@ -152,51 +288,24 @@ int32 StochasticLib1::HypInversionMod(int32 n, int32 m, int32 N) {
     This method is faster than the rejection method when the variance is low.
     */
 
-    // Setup 
-    static int32  h_n_last = -1, h_m_last = -1, h_N_last = -1; // Last values
-    static int32  h_mode, h_mp;         // Mode, mode+1
-    static int32  h_bound;              // Safety bound
-    static double h_fm;                 // Value at mode
+    // Set-up made by HypergeometricSetup
+    const int64 n = s.tn, m = s.tm, N = s.N; // Parameters
+    const int64 h_mode = s.mode, h_mp = s.mp; // Mode, mode+1
+    const int64 h_bound = s.bound;      // Safety bound
+    const double h_fm = s.fm;           // Value at mode
     // Sampling 
-    int32         I;                    // Loop counter
-    int32         L = N - m - n;        // Parameter
-    double        modef;                // mode, float
+    int64         I;                    // Loop counter
+    int64         L = N - m - n;        // Parameter
     double        Mp, np;               // m + 1, n + 1
-    double        p;                    // temporary
     double        U;                    // uniform random
     double        c, d;                 // factors in iteration
     double        divisor;              // divisor, eliminated by scaling
     double        k1, k2;               // float version of loop counter
-    double        L1 = L;               // float version of L
+    double        L1 = (double)L;       // float version of L
 
     Mp = (double)(m + 1);
     np = (double)(n + 1);
 
-    if (N != h_N_last || m != h_m_last || n != h_n_last) {
-        // set-up when parameters have changed
-        h_N_last = N;  h_m_last = m;  h_n_last = n;
-
-        p = Mp / (N + 2.);
-        modef = np * p;                       // mode, real
-        h_mode = (int32)modef;                // mode, integer
-        if (h_mode == modef && p == 0.5) {
-            h_mp = h_mode--;
-        }
-        else {
-            h_mp = h_mode + 1;
-        }
-        // mode probability, using log factorial function
-        // (may read directly from fac_table if N < FAK_LEN)
-        h_fm = exp(LnFac(N - m) - LnFac(L + h_mode) - LnFac(n - h_mode)
-            + LnFac(m) - LnFac(m - h_mode) - LnFac(h_mode)
-            - LnFac(N) + LnFac(N - n) + LnFac(n));
-
-        // safety bound - guarantees at least 17 significant decimal digits
-        // bound = min(n, (int32)(modef + k*c'))
-        h_bound = (int32)(modef + 11. * sqrt(modef * (1. - p) * (1. - n / (double)N) + 1.));
-        if (h_bound > n) h_bound = n;
-    }
-
     // loop until accepted
     while (true) {
         U = Random();                    // uniform random number to be converted
@@ -206,7 +315,7 @@ int32 StochasticLib1::HypInversionMod(int32 n, int32 m, int32 N) {
         c = d = h_fm;
 
         // alternating down- and upward search from the mode
-        k1 = h_mp - 1;  k2 = h_mode + 1;
+        k1 = (double)(h_mp - 1);  k2 = (double)(h_mode + 1);
         for (I = 1; I <= h_mode; I++, k1--, k2++) {
             // Downward search from k1 = h_mp - 1
             divisor = (np - k1) * (Mp - k1);
@@ -228,7 +337,7 @@ int32 StochasticLib1::HypInversionMod(int32 n, int32 m, int32 N) {
         }
 
         // Upward search from k2 = 2*mode + 1 to bound
-        for (k2 = I = h_mp + h_mode; I <= h_bound; I++, k2++) {
+        for (I = h_mp + h_mode, k2 = (double)I; I <= h_bound; I++, k2++) {
             divisor = k2 * (L1 + k2);
             U *= divisor;
             d *= (np - k2) * (Mp - k2);
@@ -240,12 +349,13 @@ int32 StochasticLib1::HypInversionMod(int32 n, int32 m, int32 N) {
 }
 
 
-int32 StochasticLib1::HypRatioOfUnifoms(int32 n, int32 m, int32 N) {
+int64 StochasticLib1::HypRatioOfUnifoms(const SHypSetup & s) {
     /*
     Subfunction for Hypergeometric distribution using the ratio-of-uniforms
     rejection method.
 
-    This code is valid for 0 < n <= m <= N/2.
+    This code is valid for 0 < n <= m <= N/2, where n and m are the 
+    transformed parameters in the set-up.
 
     The computation time hardly depends on the parameters, except that it matters
     a lot whether parameters are within the range where the LnFac function is
@@ -255,44 +365,34 @@ int32 StochasticLib1::HypRatioOfUnifoms(int32 n, int32 m, int32 N) {
     discrete random variates". Journal of Computational and Applied Mathematics,
     vol. 31, no. 1, 1990, pp. 181-189.
     */
-    static int32 h_N_last = -1;         // previous parameter
-    static int32 h_m_last = -1;         // previous parameter
-    static int32 h_n_last = -1;         // previous parameter
-    static int32 h_bound;               // upper bound
-    static double h_a;                  // hat center
-    static double h_h;                  // hat width
-    static double h_g;                  // value at mode
-    int32 L;                            // N-m-n
-    int32 mode;                         // mode
-    int32 k;                            // integer sample
+    const int64 n = s.tn, m = s.tm, N = s.N; // parameters
+    const int64 h_bound = s.bound;      // upper bound
+    const int64 h_mode = s.mode;        // mode
+    const double h_a = s.a;             // hat center
+    const double h_h = s.h;             // hat width
+    const double h_g = s.g;             // value at mode
+    int64 L;                            // N-m-n
+    int64 k;                            // integer sample
     double x;                           // real sample
-    double rNN;                         // 1/(N*(N+2))
-    double my;                          // mean
-    double var;                         // variance
     double u;                           // uniform random
     double lf;                          // ln(f(x))
 
     L = N - m - n;
-    if (h_N_last != N || h_m_last != m || h_n_last != n) {
-        h_N_last = N;  h_m_last = m;  h_n_last = n;            // Set-up
-        rNN = 1. / ((double)N * (N + 2));                      // make two divisions in one
-        my = (double)n * m * rNN * (N + 2);                    // mean = n*m/N
-        mode = (int32)(double(n + 1) * double(m + 1) * rNN * N);  // mode = floor((n+1)*(m+1)/(N+2))
-        var = (double)n * m * (N - m) * (N - n) / ((double)N * N * (N - 1)); // variance
-        h_h = sqrt(SHAT1 * (var + 0.5)) + SHAT2;               // hat width
-        h_a = my + 0.5;                                        // hat center
-        h_g = fc_lnpk(mode, L, m, n);                          // maximum
-        h_bound = (int32)(h_a + 4.0 * h_h);                    // safety-bound
-        if (h_bound > n) h_bound = n;
-    }
     while (1) {
         u = Random();                                          // uniform random number
         if (u == 0) continue;                                  // avoid division by 0
         x = h_a + h_h * (Random() - 0.5) / u;                  // generate hat distribution
-        if (x < 0. || x > 2E9) continue;                       // reject, avoid overflow
-        k = (int32)x;
+        if (x < 0. || x > 9E18) continue;                      // reject, avoid overflow
+        k = (int64)x;
         if (k > h_bound) continue;                             // reject if outside range
-        lf = h_g - fc_lnpk(k, L, m, n);                        // ln(f(k))
+        if (N > LARGE_URN) {
+            // ln(f(k)) from differences of log factorials to avoid loss of precision
+            lf = -(LnFacDiff(k, h_mode) + LnFacDiff(m - k, m - h_mode)
+                + LnFacDiff(n - k, n - h_mode) + LnFacDiff(L + k, L + h_mode));
+        }
+        else {
+            lf = h_g - fc_lnpk(k, L, m, n);                    // ln(f(k))
+        }
         if (u * (4.0 - u) - 3.0 <= lf) break;                  // lower squeeze accept
         if (u * (u - lf) > 1.0) continue;                      // upper squeeze reject
         if (2.0 * log(u) <= lf) break;                         // final acceptance
@@ -301,7 +401,7 @@ int32 StochasticLib1::HypRatioOfUnifoms(int32 n, int32 m, int32 N) {
 }
 
 
-double StochasticLib1::fc_lnpk(int32 k, int32 L, int32 m, int32 n) {
+double StochasticLib1::fc_lnpk(int64 k, int64 L, int64 m, int64 n) {
     // subfunction used by hypergeometric and Fisher's noncentral hypergeometric distribution
     return(LnFac(k) + LnFac(m - k) + LnFac(n - k) + LnFac(L + k));
 }
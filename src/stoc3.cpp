@@ -39,6 +39,42 @@
 ***********************************************************************/
 StochasticLib3::StochasticLib3(int seed) : StochasticLib1(seed) {
     SetAccuracy(1.E-8);                  // set default accuracy
+    int i;                               // mark set-up cache entries as unused
+    for (i = 0; i < TABLE_ENTRIES; i++) wncTableSetup[i].lastUse = 0;
+    for (i = 0; i < SETUP_ENTRIES; i++) {
+        wncRatioSetup[i].lastUse = fncInversionSetup[i].lastUse = fncRatioSetup[i].lastUse = 0;
+    }
+    for (i = 0; i < PLAN_ENTRIES; i++) multiPlan[i].lastUse = 0;
+    chainThin = 0;
+    setupClock = 0;
+}
+
+
+/***********************************************************************
+             FindSetup
+***********************************************************************/
+template <class S>
+bool StochasticLib3::FindSetup(S * list, int entries, int64 n, int64 m, int64 N, double odds, S * & setup) {
+    // Find the set-up cache entry for these parameters and the current accuracy.
+    // Returns true if found. Otherwise the least recently used entry is 
+    // assigned to these parameters and the return value is false. The caller 
+    // must then do the set-up in this entry and set lastUse = setupClock 
+    // when the set-up is complete. The entry is marked as unused until then,
+    // so that a set-up that fails with an error is not used later.
+    int i, oldest = 0;                   // index of entry
+    setupClock++;
+    for (i = 0; i < entries; i++) {
+        S & e = list[i];
+        if (e.lastUse && e.n == n && e.m == m && e.N == N && e.odds == odds && e.accuracy == accuracy) {
+            e.lastUse = setupClock;  setup = &e;
+            return true;
+        }
+        if (e.lastUse < list[oldest].lastUse) oldest = i;
+    }
+    setup = list + oldest;
+    setup->lastUse = 0;                  // unused until set-up is complete
+    setup->n = n;  setup->m = m;  setup->N = N;  setup->odds = odds;  setup->accuracy = accuracy;
+    return false;
 }
 
 
@@ -58,7 +94,7 @@ void StochasticLib3::SetAccuracy(double accur) {
         Wallenius Non-central Hypergeometric distribution
 ***********************************************************************/
 
-int32 StochasticLib3::WalleniusNCHyp(int32 n, int32 m, int32 N, double odds) {
+int64 StochasticLib3::WalleniusNCHyp(int64 n, int64 m, int64 N, double odds) {
     /*
     This function generates a random variate with Wallenius noncentral
     hypergeometric distribution.
@@ -121,11 +157,11 @@ int32 StochasticLib3::WalleniusNCHyp(int32 n, int32 m, int32 N, double odds) {
          Subfunctions for WalleniusNCHyp
 ***********************************************************************/
 
-int32 StochasticLib3::WalleniusNCHypUrn(int32 n, int32 m, int32 N, double odds) {
+int64 StochasticLib3::WalleniusNCHypUrn(int64 n, int64 m, int64 N, double odds) {
     // sampling from Wallenius noncentral hypergeometric distribution 
     // by simulating urn model
-    int32 x;                             // sample
-    int32 m2;                            // items of color 2 in urn
+    int64 x;                             // sample
+    int64 m2;                            // items of color 2 in urn
     double mw1, mw2;                     // total weight of balls of color 1 or 2
     x = 0;  m2 = N - m;
     mw1 = m * odds;  mw2 = m2;
@@ -147,69 +183,110 @@ int32 StochasticLib3::WalleniusNCHypUrn(int32 n, int32 m, int32 N, double odds)
 }
 
 
-int32 StochasticLib3::WalleniusNCHypTable(int32 n, int32 m, int32 N, double odds) {
+void StochasticLib3::WalleniusNCHypBatch(int64 * x, int k, const int64 * n, const int64 * m, 
+const int64 * N, const double * odds) {
+    // Sampling k variates from Wallenius noncentral hypergeometric distribution
+    // with parameters n[i], m[i], N[i], odds[i]. 
+    // The variates that WalleniusNCHyp would make by the urn model are 
+    // simulated together, with one lane for each variate. Each ball is taken
+    // in all lanes at once, using a block of uniform random numbers. 
+    // A lane with fewer balls to take is masked off when it is finished.
+    // The other variates are made one by one by WalleniusNCHyp.
+    int    lane[URN_LANES];              // index of variate in each lane
+    int64  nl[URN_LANES];                // balls to take in each lane
+    double act[URN_LANES];               // 1 if lane is active, 0 if finished
+    double m1[URN_LANES], m2[URN_LANES]; // balls of color 1 and 2 left in urn
+    double o[URN_LANES];                 // odds
+    double xl[URN_LANES];                // sample
+    double u[URN_LANES];                 // uniform random numbers
+    double mw1, take;                    // weight of color 1, ball of color 1 taken
+    int64  nmax = 0;                     // highest n
+    int64  ball;                         // ball number
+    int    i, l, lanes = 0;              // index, lane, number of lanes
+
+    if (k > URN_LANES) FatalError("Too many variates in function WalleniusNCHypBatch");
+    for (i = 0; i < k; i++) {
+        if (n[i] < 30 && n[i] > 0 && n[i] < N[i] && m[i] > 0 && m[i] < N[i] && odds[i] > 0. && odds[i] != 1.) {
+            // same condition as in WalleniusNCHyp for using WalleniusNCHypUrn
+            lane[lanes] = i;  nl[lanes] = n[i];  act[lanes] = 1.;
+            m1[lanes] = (double)m[i];  m2[lanes] = (double)(N[i] - m[i]);
+            o[lanes] = odds[i];  xl[lanes] = 0.;
+            if (n[i] > nmax) nmax = n[i];
+            lanes++;
+        }
+        else {
+            x[i] = WalleniusNCHyp(n[i], m[i], N[i], odds[i]);
+        }
+    }
+
+    // unused lanes are inactive. All lanes are calculated so that the loop 
+    // has a constant count, which makes it easier for the compiler to vectorize
+    for (l = lanes; l < URN_LANES; l++) {
+        nl[l] = 0;  act[l] = xl[l] = u[l] = 0.;  m1[l] = m2[l] = o[l] = 1.;
+    }
+
+    // take one ball in each lane. When one color is exhausted, its weight is 
+    // zero so that the other color is always taken. Lanes are masked off in
+    // a separate loop because the compiler does not vectorize a loop with 
+    // two comparisons
+    for (ball = 0; ball < nmax; ball++) {
+        RandomBlock(u, lanes);
+        for (l = 0; l < lanes; l++) {
+            if (nl[l] == ball) act[l] = 0.;
+        }
+        for (l = 0; l < URN_LANES; l++) {
+            mw1 = m1[l] * o[l];
+            take = (double)(u[l] * (mw1 + m2[l]) < mw1) * act[l];
+            xl[l] += take;  m1[l] -= take;  m2[l] -= act[l] - take;
+        }
+    }
+    for (l = 0; l < lanes; l++) x[lane[l]] = (int64)xl[l];
+}
+
+
+int64 StochasticLib3::WalleniusNCHypTable(int64 n, int64 m, int64 N, double odds) {
     // Sampling from Wallenius noncentral hypergeometric distribution 
-    // using chop-down search from a table created by recursive calculation.
+    // using an alias table made from a table created by recursive calculation.
     // This method is fast when n is low or when called repeatedly with
     // the same parameters.
-    static int32 wnc_n_last = -1, wnc_m_last = -1, wnc_N_last = -1; // previous parameters
-    static double wnc_o_last = -1;
-
-    const int TABLELENGTH = 512;         // max length of table
-    static double ytable[TABLELENGTH];   // table of probability values
-    static int32 len;                    // length of table
-    static int32 x1;                     // lower x limit for table
-    int32 x2;                            // upper x limit for table
-    int32 x;                             // sample
-    double u;                            // uniform random number
+    SWNCTableSetup * s;                  // set-up for these parameters
+    double ytable[WNC_TABLELENGTH];      // table of probability values
+    int64 x2;                            // upper x limit for table
     int success;                         // table long enough
 
-    if (n != wnc_n_last || m != wnc_m_last || N != wnc_N_last || odds != wnc_o_last) {
-        // set-up: This is done only when parameters have changed
-        wnc_n_last = n;  wnc_m_last = m;  wnc_N_last = N;  wnc_o_last = odds;
-
+    if (!FindSetup(wncTableSetup, TABLE_ENTRIES, n, m, N, odds, s)) {
+        // set-up: This is done only when parameters are not in the cache
         CWalleniusNCHypergeometric wnch(n, m, N, odds);   // make object for calculation
-        success = wnch.MakeTable(ytable, TABLELENGTH, &x1, &x2, 0); // make table of probability values
+        success = wnch.MakeTable(ytable, WNC_TABLELENGTH, &s->x1, &x2, 0); // make table of probability values
         if (success) {
-            len = x2 - x1 + 1;
-        }                   // table long enough. remember length
+            s->len = x2 - s->x1 + 1;                      // table long enough. remember length
+            s->alias.MakeTable(ytable, (int32)s->len, s->aliasbuf); // make alias table
+        }
         else {
-            len = 0;
+            s->len = 0;                                   // remember failure
         }
-    }                       // remember failure
+        s->lastUse = setupClock;                      // set-up is complete
+    }
 
-    if (len == 0) {
+    if (s->len == 0) {
         // table not long enough. Use another method
         return WalleniusNCHypRatioOfUnifoms(n, m, N, odds);
     }
 
-    while (true) {                              // repeat in the rare case of failure
-        u = Random();                           // uniform variate to convert
-        for (x = 0; x < len; x++) {             // chop-down search
-            u -= ytable[x];
-            if (u < 0.) return x + x1;          // value found
-        }
-    }
+    return s->x1 + s->alias.random(Random());
 }
 
 
-int32 StochasticLib3::WalleniusNCHypRatioOfUnifoms(int32 n, int32 m, int32 N, double odds) {
+int64 StochasticLib3::WalleniusNCHypRatioOfUnifoms(int64 n, int64 m, int64 N, double odds) {
     // sampling from Wallenius noncentral hypergeometric distribution 
     // using ratio-of-uniforms rejection method.
-    static int32 wnc_n_last = -1, wnc_m_last = -1, wnc_N_last = -1; // previous parameters
-    static double wnc_o_last = -1;
-    static int32 wnc_bound1, wnc_bound2; // lower and upper bound
-    static int32 wnc_mode;               // mode
-    static double wnc_a;                 // hat center
-    static double wnc_h;                 // hat width
-    static double wnc_k;                 // probability value at mode
-    static int UseChopDown;              // use chop down inversion instead
-    int32 xmin, xmax;                    // x limits
+    SWNCRatioSetup * s;                  // set-up for these parameters
+    int64 xmin, xmax;                    // x limits
     double mean;                         // mean
     double variance;                     // variance
     double x;                            // real sample
-    int32 xi;                            // integer sample
-    int32 x2;                            // limit when searching for mode
+    int64 xi;                            // integer sample
+    int64 x2;                            // limit when searching for mode
     double u;                            // uniform random
     double f, f2;                        // probability function value
     double s123;                         // components 1,2,3 of hat width
@@ -223,9 +300,10 @@ int32 StochasticLib3::WalleniusNCHypRatioOfUnifoms(int32 n, int32 m, int32 N, do
     xmin = m + n - N; if (xmin < 0) xmin = 0;  // calculate limits
     xmax = n;     if (xmax > m) xmax = m;
 
-    if (n != wnc_n_last || m != wnc_m_last || N != wnc_N_last || odds != wnc_o_last) {
-        // set-up: This is done only when parameters have changed
-        wnc_n_last = n;  wnc_m_last = m;  wnc_N_last = N;  wnc_o_last = odds;
+    if (!FindSetup(wncRatioSetup, SETUP_ENTRIES, n, m, N, odds, s)) {
+        // set-up: This is done only when parameters are not in the cache
+        int64 & wnc_mode = s->mode;        // references to set-up data
+        double & wnc_k = s->k, & wnc_a = s->a, & wnc_h = s->h;
 
         // find approximate mean
         mean = wnch.mean();
@@ -233,11 +311,11 @@ int32 StochasticLib3::WalleniusNCHypRatioOfUnifoms(int32 n, int32 m, int32 N, do
         // find approximate variance from Fisher's noncentral hypergeometric approximation
         r1 = mean * (m - mean); r2 = (n - mean) * (mean + N - n - m);
         variance = N * r1 * r2 / ((N - 1) * (m * r2 + (N - m) * r1));
-        UseChopDown = variance < 4.;       // use chop-down method if variance is low
+        s->UseChopDown = variance < 4.;    // use chop-down method if variance is low
 
-        if (!UseChopDown) {
+        if (!s->UseChopDown) {
             // find mode (same code in CWalleniusNCHypergeometric::mode)
-            wnc_mode = (int32)(mean);  f2 = 0.;
+            wnc_mode = (int64)(mean);  f2 = 0.;
             if (odds < 1.) {
                 if (wnc_mode < xmax) wnc_mode++;
                 x2 = xmin;
@@ -281,29 +359,33 @@ int32 StochasticLib3::WalleniusNCHypRatioOfUnifoms(int32 n, int32 m, int32 N, do
             wnc_h = 2. * (s123 + s4);
 
             // find safety bounds
-            wnc_bound1 = (int32)(mean - 4. * wnc_h);
-            if (wnc_bound1 < xmin) wnc_bound1 = xmin;
-            wnc_bound2 = (int32)(mean + 4. * wnc_h);
-            if (wnc_bound2 > xmax) wnc_bound2 = xmax;
+            s->bound1 = (int64)(mean - 4. * wnc_h);
+            if (s->bound1 < xmin) s->bound1 = xmin;
+            s->bound2 = (int64)(mean + 4. * wnc_h);
+            if (s->bound2 > xmax) s->bound2 = xmax;
         }
+        s->lastUse = setupClock;                      // set-up is complete
     }
 
-    if (UseChopDown) { // for small variance, use chop down inversion
+    if (s->UseChopDown) { // for small variance, use chop down inversion
         return WalleniusNCHypInversion(n, m, N, odds);
     }
 
+    const double wnc_a = s->a, wnc_h = s->h, wnc_k = s->k; // hat center and width, value at mode
+    const int64 wnc_bound1 = s->bound1, wnc_bound2 = s->bound2; // safety bounds
+
     // use ratio-of-uniforms rejection method
     while (true) {                                   // rejection loop
         u = Random();
         if (u == 0.) continue;                       // avoid division by 0
         x = wnc_a + wnc_h * (Random() - 0.5) / u;
-        if (x < 0. || x > 2E9) continue;             // reject, avoid overflow
-        xi = (int32)(x);                             // truncate
+        if (x < 0. || x > 9E18) continue;            // reject, avoid overflow
+        xi = (int64)(x);                             // truncate
         if (xi < wnc_bound1 || xi > wnc_bound2) {
             continue;
         }                                           // reject if outside safety bounds
 #if false // use rejection in x-domain
-        if (xi == wnc_mode) break;                  // accept      
+        if (xi == s->mode) break;                   // accept      
         f = wnch.probability(xi);                   // function value
         if (f > wnc_k * u * u) {
             break;
@@ -324,12 +406,12 @@ int32 StochasticLib3::WalleniusNCHypRatioOfUnifoms(int32 n, int32 m, int32 N, do
 }
 
 
-int32 StochasticLib3::WalleniusNCHypInversion(int32 n, int32 m, int32 N, double odds) {
+int64 StochasticLib3::WalleniusNCHypInversion(int64 n, int64 m, int64 N, double odds) {
     // sampling from Wallenius noncentral hypergeometric distribution 
     // using down-up search starting at the mean using the chop-down technique.
     // This method is faster than the rejection method when the variance is low.
-    int32 x1, x1s, x2;                   // search values
-    int32 xmin, xmax;                    // x limits
+    int64 x1, x1s, x2;                   // search values
+    int64 xmin, xmax;                    // x limits
     double   u;                          // uniform random number to be converted
     double   f;                          // probability function value
     double   accura;                     // absolute accuracy
@@ -344,7 +426,7 @@ int32 StochasticLib3::WalleniusNCHypInversion(int32 n, int32 m, int32 N, double
     accura = accuracy * 0.01;
     if (accura > 1E-7) accura = 1E-7;       // absolute accuracy
 
-    x1s = (int32)(wnch1.mean());            // start at floor x1, and ceiling x2 of mean
+    x1s = (int64)(wnch1.mean());            // start at floor x1, and ceiling x2 of mean
     xmin = m + n - N;
     if (xmin < 0) xmin = 0;                 // calculate limits
     xmax = n;
@@ -386,12 +468,243 @@ int32 StochasticLib3::WalleniusNCHypInversion(int32 n, int32 m, int32 N, double
 }
 
 
+/***********************************************************************
+      Sampling plan for multivariate distributions
+***********************************************************************/
+
+void StochasticLib3::SetChain(int thin) {
+    // Continue the Markov chains of the multivariate functions between 
+    // variates with thin scans between variates, or start each variate with
+    // a new chain if thin = 0. Any existing chains are discarded
+    chainThin = thin > 0 ? thin : 0;
+    for (int i = 0; i < PLAN_ENTRIES; i++) multiPlan[i].chainValid = 0;
+}
+
+
+int StochasticLib3::MultiUsesChain(int fisher, int64 * source, double * weights, int64 n, int colors) {
+    // Check if the multivariate function uses Metropolis-Hastings or Gibbs 
+    // sampling for these parameters. The plan is saved for later use
+    if (n <= 0 || colors <= 0 || colors > MAXCOLORS) return 0;
+    return MultiPlan(fisher, source, weights, n, colors)->method == 3;
+}
+
+
+StochasticLib3::SMultiPlan * StochasticLib3::MultiPlan(int fisher,
+    int64 * source, double * weights, int64 n, int colors) {
+    // Find the sampling plan for these parameters, or make a new plan in the
+    // least recently used entry. Used by MultiWalleniusNCHyp and 
+    // MultiFishersNCHyp. The caller must check that n > 0 and 
+    // 0 < colors <= MAXCOLORS.
+    SMultiPlan * p;              // sampling plan
+    double var[MAXCOLORS];       // variance of each color
+    double w = 0.;               // weight or variance of one color
+    double w1, w2;               // mean weight of each weight group
+    double wsum;                 // total weight of several colors
+    double r1, r2;               // temporaries in calculation of variance
+    int64 x = 0;                 // number of balls of pooled colors
+    int64 m;                     // number of balls of one color
+    int64 m1, m2;                // number of balls in each weight group
+    int64 msum;                  // total number of balls of several or all colors
+    int64 N;                     // total number of balls with nonzero weight
+    int i, j, k;                 // loop counters
+    int a, b;                    // color index delimiting weight group
+    int c, c2;                   // color index
+    int colors2;                 // reduced number of colors
+    int oldest = 0;              // least recently used entry
+
+    // search for saved plan
+    setupClock++;
+    for (i = 0; i < PLAN_ENTRIES; i++) {
+        p = multiPlan + i;
+        if (p->lastUse && p->fisher == fisher && p->n == n && p->colors == colors && p->accuracy == accuracy) {
+            for (j = 0; j < colors; j++) {
+                if (p->source[j] != source[j] || p->weights[j] != weights[j]) break;
+            }
+            if (j == colors) {
+                p->lastUse = setupClock;
+                return p;
+            }
+        }
+        if (p->lastUse < multiPlan[oldest].lastUse) oldest = i;
+    }
+
+    // check validity of array parameters
+    for (i = 0, msum = 0; i < colors; i++) {
+        m = source[i];  w = weights[i];
+        if (m < 0 || w < 0) FatalError(fisher ? "Parameter negative in function MultiFishersNCHyp"
+            : "Parameter negative in function MultiWalleniusNCHyp");
+        if (w) msum += m;
+    }
+    N = msum;
+
+    // make new plan. It is not valid until finished
+    p = multiPlan + oldest;
+    p->lastUse = 0;
+    p->fisher = fisher;  p->n = n;  p->colors = colors;  p->accuracy = accuracy;
+    for (i = 0; i < colors; i++) {
+        p->source[i] = source[i];  p->weights[i] = weights[i];
+    }
+    p->N = N;  p->invert = 0;  p->chainValid = 0;
+
+    // sort colors by weight, heaviest first
+    for (i = 0; i < colors; i++) p->order1[i] = p->order3[i] = i;
+    for (i = 0; i < colors - 1; i++) {
+        c = p->order1[i];  k = i;
+        w = weights[c];
+        if (source[c] == 0) w = 0; // zero number treated as zero weight
+        for (j = i + 1; j < colors; j++) {
+            c2 = p->order1[j];
+            if (weights[c2] > w && source[c2]) {
+                w = weights[c2];  k = j;
+            }
+        }
+        p->order1[i] = p->order1[k];  p->order1[k] = c;
+    }
+
+    // skip any colors with zero weight or zero number.
+    // this solves all problems with zero weights
+    while (colors && (weights[c = p->order1[colors - 1]] == 0 || source[c] == 0)) {
+        colors--;
+    }
+    p->colors1 = colors;
+
+    // check if there are more than n balls with nonzero weight
+    if (n >= N) {
+        if (n > N) FatalError(fisher ? "Taking more items than there are in function MultiFishersNCHyp"
+            : "Taking more items than there are in function MultiWalleniusNCHyp");
+        p->method = 0;
+        p->lastUse = setupClock;
+        return p;
+    }
+
+    if (fisher && n > N / 2) {
+        // improve accuracy by symmetry transformation
+        for (i = 0, j = colors - 1; i < j; i++, j--) { // reverse order list
+            c = p->order1[i];  p->order1[i] = p->order1[j];  p->order1[j] = c;
+        }
+        n = N - n;  p->invert = 1;
+    }
+    p->nn = n;
+
+    // copy source and weights into ordered lists 
+    // and pool together colors with same weight
+    for (i = 0, c2 = -1; i < colors; i++) {
+        c = p->order1[i];
+        if (i == 0 || weights[c] != w) {
+            c2++;
+            x = source[c];
+            p->oweights[c2] = w = p->invert ? 1. / weights[c] : weights[c];
+        }
+        else {
+            x += source[c]; // join colors with same weight
+        }
+        p->osource[c2] = x;
+        p->order2[i] = c2;
+    }
+    p->colors2 = colors2 = c2 + 1;
+
+    // decide which method to use
+    if (colors2 < 3) {
+        p->method = 1;           // simple cases
+    }
+    else if (!fisher && n < 5000 * colors2) {
+        p->method = 2;           // simulate urn experiment
+    }
+    else {
+        // conditional method followed by Metropolis-Hastings or Gibbs sampling
+        p->method = 3;
+
+        // divide weights into two groups, heavy and light
+        a = 0;  b = colors2 - 1;
+        w = sqrt(p->oweights[0] * p->oweights[colors2 - 1]);
+        do {
+            c = (a + b) / 2;
+            if (p->oweights[c] > w) a = c; else b = c;
+        } while (b > a + 1);
+        // heavy group goes from 0 to b-1, light group goes from b to colors2-1
+        p->split = b;
+
+        // calculate mean weight for heavy color group
+        for (i = 0, m1 = 0, wsum = 0; i < b; i++) {
+            m1 += p->osource[i];  wsum += p->oweights[i] * p->osource[i];
+        }
+        w1 = wsum / m1;
+
+        // calculate mean weight for light color group
+        for (i = b, m2 = 0, wsum = 0; i < colors2; i++) {
+            m2 += p->osource[i];  wsum += p->oweights[i] * p->osource[i];
+        }
+        w2 = wsum / m2;
+        p->m1 = m1;  p->m2 = m2;  p->odds12 = w1 / w2;
+
+        // odds for splitting each group into single colors, one color at a time
+        for (k = 0, a = 0; k < 2; k++) {
+            for (i = a; i < b - 1; i++) {
+                w = p->oweights[i];
+
+                // calculate mean weight of remaining colors
+                for (j = i + 1, msum = 0, wsum = 0; j < b; j++) {
+                    m1 = p->osource[j];  w1 = p->oweights[j];
+                    msum += m1;  wsum += m1 * w1;
+                }
+                p->gsum[i] = msum;
+                if (fisher && w == w1) p->godds[i] = 0.; // central hypergeometric
+                else if (wsum == 0) p->godds[i] = -1.;   // take all
+                else p->godds[i] = w * msum / wsum;
+            }
+            // second group
+            a = b;  b = colors2;
+        }
+
+        // calculate approximate variance
+        if (fisher) {
+            CMultiFishersNCHypergeometric(n, p->osource, p->oweights, colors2).variance(var);
+        }
+        else {
+            CMultiWalleniusNCHypergeometric(n, p->osource, p->oweights, colors2).mean(var);
+            // calculate approximate variance from mean
+            for (i = 0; i < colors2; i++) {
+                m = p->osource[i];
+                r1 = var[i] * (m - var[i]);
+                r2 = (n - var[i]) * (var[i] + N - n - m);
+                if (r1 <= 0. || r2 <= 0.) {
+                    var[i] = 0.;
+                }
+                else {
+                    var[i] = N * r1 * r2 / ((N - 1) * (m * r2 + (N - m) * r1));
+                }
+            }
+        }
+
+        // sort again, this time by variance
+        for (i = 0; i < colors2 - 1; i++) {
+            c = p->order3[i];  k = i;
+            w = var[c];
+            for (j = i + 1; j < colors2; j++) {
+                c2 = p->order3[j];
+                if (var[c2] > w) {
+                    w = var[c2];  k = j;
+                }
+            }
+            p->order3[i] = p->order3[k];  p->order3[k] = c;
+        }
+
+        // number of scans (this value has not been fine-tuned)
+        p->scans = 4;
+        if (accuracy < 1E-6) p->scans = 6;
+        if (colors2 > 5) p->scans++;
+    }
+    p->lastUse = setupClock;
+    return p;
+}
+
+
 /***********************************************************************
       Multivariate Wallenius noncentral hypergeometric distribution
 ***********************************************************************/
 
-void StochasticLib3::MultiWalleniusNCHyp(int32 * destination,
-    int32 * source, double * weights, int32 n, int colors) {
+void StochasticLib3::MultiWalleniusNCHyp(int64 * destination,
+    int64 * source, double * weights, int64 n, int colors) {
     /*
     This function generates a vector of random variables with the
     multivariate Wallenius noncentral hypergeometric distribution.
@@ -449,34 +762,28 @@ void StochasticLib3::MultiWalleniusNCHyp(int32 * destination,
     */
 
     // variables 
-    int order1[MAXCOLORS];       // sort order, index into source and destination
-    int order2[MAXCOLORS];       // corresponding index into arrays when equal weights pooled together
-    int order3[MAXCOLORS];       // secondary index for sorting by variance
-    int32 osource[MAXCOLORS];    // contents of source, sorted by weight with equal weights pooled together
-    int32 urn[MAXCOLORS];        // balls from osource not taken yet
-    int32 osample[MAXCOLORS];    // balls sampled
+    SMultiPlan * plan;           // sampling plan with the set-up for these parameters
+    int order2[MAXCOLORS];       // index into arrays when equal weights pooled together
+    int64 osource[MAXCOLORS];    // contents of source, sorted by weight with equal weights pooled together
+    int64 urn[MAXCOLORS];        // balls from osource not taken yet
+    int64 osample[MAXCOLORS];    // balls sampled
     double oweights[MAXCOLORS];  // sorted list of weights
     double wcum[MAXCOLORS];      // list of accumulated probabilities
-    double var[MAXCOLORS];       // sorted list of variance
     double w = 0.;               // weight of balls of one color
-    double w1, w2;               // odds within group; mean weight in group
     double wsum;                 // total weight of all balls of several or all colors
     double p;                    // probability
     double f0, f1;               // multivariate probability function
     double g0, g1;               // conditional probability function
-    double r1, r2;               // temporaries in calculation of variance
-    int32 nn;                    // number of balls left to sample
-    int32 m;                     // number of balls of one color
-    int32 msum;                  // total number of balls of several or all colors
-    int32 N;                     // total number of balls with nonzero weight
-    int32 x0, x = 0;             // sample of one color
-    int32 n1, n2, ng;            // size of weight group sample or partial sample
-    int32 m1, m2;                // size of weight group
+    int64 nn;                    // number of balls left to sample
+    int64 m;                     // number of balls of one color
+    int64 N;                     // total number of balls with nonzero weight
+    int64 x0, x = 0;             // sample of one color
+    int64 n1, n2, ng;            // size of weight group sample or partial sample
     int i, j, k;                 // loop counters
     int c, c1, c2;               // color index
     int colors2;                 // reduced number of colors
     int a, b;                    // color index delimiting weight group
-    int nHastings;               // number of scans in Metropolis-Hastings sampling
+    int scans;                   // number of Metropolis-Hastings scans
 
     // check validity of parameters
     if (n < 0 || colors < 0 || colors > MAXCOLORS) FatalError("Parameter out of range in function MultiWalleniusNCHyp");
@@ -486,62 +793,30 @@ void StochasticLib3::MultiWalleniusNCHyp(int32 * destination,
         return;
     }
 
-    // check validity of array parameters
-    for (i = 0, msum = 0; i < colors; i++) {
-        m = source[i];  w = weights[i];
-        if (m < 0 || w < 0) FatalError("Parameter negative in function MultiWalleniusNCHyp");
-        if (w) msum += m;
-    }
-    N = msum;
+    // find or make sampling plan
+    plan = MultiPlan(0, source, weights, n, colors);
+    N = plan->N;
 
-    // sort colors by weight, heaviest first
-    for (i = 0; i < colors; i++) order1[i] = order3[i] = i;
-    for (i = 0; i < colors - 1; i++) {
-        c = order1[i];  k = i;
-        w = weights[c];
-        if (source[c] == 0) w = 0; // zero number treated as zero weight
-        for (j = i + 1; j < colors; j++) {
-            c2 = order1[j];
-            if (weights[c2] > w && source[c2]) {
-                w = weights[c2];  k = j;
-            }
-        }
-        order1[i] = order1[k];  order1[k] = c;
-    }
-
-    // skip any colors with zero weight or zero number.
-    // this solves all problems with zero weights
-    while (colors && (weights[c = order1[colors - 1]] == 0 || source[c] == 0)) {
-        colors--;  destination[c] = 0;
-    }
+    // skip any colors with zero weight or zero number
+    for (i = plan->colors1; i < colors; i++) destination[plan->order1[i]] = 0;
+    colors = plan->colors1;
 
-    // check if there are more than n balls with nonzero weight
-    if (n >= N) {
-        if (n > N) FatalError("Taking more items than there are in function MultiWalleniusNCHyp");
-        for (i = 0; i < colors; i++) { c = order1[i];  destination[c] = source[c]; }
+    // check if all balls with nonzero weight are taken
+    if (plan->method == 0) {
+        for (i = 0; i < colors; i++) { c = plan->order1[i];  destination[c] = source[c]; }
         return;
     }
 
-    // copy source and weights into ordered lists 
-    // and pool together colors with same weight
-    for (i = 0, c2 = -1; i < colors; i++) {
-        c = order1[i];
-        if (i == 0 || weights[c] != w) {
-            c2++;
-            x = source[c];
-            oweights[c2] = w = weights[c];
-        }
-        else {
-            x += source[c]; // join colors with same weight
-        }
-        urn[c2] = osource[c2] = x;
-        order2[i] = c2;
-        osample[c2] = 0;
+    // copy ordered lists from plan
+    colors2 = plan->colors2;
+    for (i = 0; i < colors; i++) order2[i] = plan->order2[i];
+    for (i = 0; i < colors2; i++) {
+        urn[i] = osource[i] = plan->osource[i];
+        oweights[i] = plan->oweights[i];
+        osample[i] = 0;
     }
-    colors2 = c2 + 1;
 
-    // check number of colors left
-    if (colors2 < 3) {
+    if (plan->method == 1) {
         // simple cases
         if (colors2 == 1) osample[0] = n;
         if (colors2 == 2) {
@@ -549,105 +824,89 @@ void StochasticLib3::MultiWalleniusNCHyp(int32 * destination,
             osample[0] = x;  osample[1] = n - x;
         }
     }
-    else {
-        // more than 2 colors
+    else if (plan->method == 2) {
+
+        // Simulate urn experiment
         nn = n;
 
-        // decide which method to use
-        if (nn < 5000 * colors2) {
+        // Make list of accumulated probabilities of each color
+        for (i = 0, wsum = 0; i < colors2; i++) {
+            wsum += urn[i] * oweights[i];
+            wcum[i] = wsum;
+        }
 
-            // Simulate urn experiment
+        // take one item nn times
+        j = colors2 - 1;
+        do {
 
-            // Make list of accumulated probabilities of each color
-            for (i = 0, wsum = 0; i < colors2; i++) {
-                wsum += urn[i] * oweights[i];
-                wcum[i] = wsum;
+            // get random color according to probability distribution wcum
+            p = Random() * wcum[colors2 - 1];
+            // get color from search in probability distribution wcum
+            for (i = 0; i < j; i++) {
+                if (p < wcum[i]) break;
             }
 
-            // take one item nn times
-            j = colors2 - 1;
-            do {
-
-                // get random color according to probability distribution wcum
-                p = Random() * wcum[colors2 - 1];
-                // get color from search in probability distribution wcum
-                for (i = 0; i < j; i++) {
-                    if (p < wcum[i]) break;
+            // sample one ball of color i
+            osample[i]++;  urn[i]--;  nn--;
+
+            // check if this color has been exhausted
+            if (urn[i] == 0) {
+                if (i != j) {
+                    // put exhausted color at the end of lists so that colors2 can be reduced
+                    m = osource[i]; osource[i] = osource[j]; osource[j] = m;
+                    m = urn[i]; urn[i] = urn[j]; urn[j] = m;
+                    m = osample[i]; osample[i] = osample[j]; osample[j] = m;
+                    w = oweights[i]; oweights[i] = oweights[j]; oweights[j] = w;
+                    // update order2 list (no longer sorted by weight)
+                    for (k = 0; k < colors; k++) {
+                        if (order2[k] == i) order2[k] = j;
+                        else if (order2[k] == j) order2[k] = i;
+                    }
+                }
+                colors2--;  j = colors2 - 1;  // decrement number of colors left in urn
+
+                if (colors2 == 2 && nn > 50) {
+                    // two colors left. use univariate distribution for the rest
+                    x = WalleniusNCHyp(nn, urn[0], urn[0] + urn[1], oweights[0] / oweights[1]);
+                    osample[0] += x;
+                    osample[1] += nn - x;
+                    break;
                 }
 
-                // sample one ball of color i
-                osample[i]++;  urn[i]--;  nn--;
-
-                // check if this color has been exhausted
-                if (urn[i] == 0) {
-                    if (i != j) {
-                        // put exhausted color at the end of lists so that colors2 can be reduced
-                        m = osource[i]; osource[i] = osource[j]; osource[j] = m;
-                        m = urn[i]; urn[i] = urn[j]; urn[j] = m;
-                        m = osample[i]; osample[i] = osample[j]; osample[j] = m;
-                        w = oweights[i]; oweights[i] = oweights[j]; oweights[j] = w;
-                        // update order2 list (no longer sorted by weight)
-                        for (k = 0; k < colors; k++) {
-                            if (order2[k] == i) order2[k] = j;
-                            else if (order2[k] == j) order2[k] = i;
-                        }
-                    }
-                    colors2--;  j = colors2 - 1;  // decrement number of colors left in urn
-
-                    if (colors2 == 2 && nn > 50) {
-                        // two colors left. use univariate distribution for the rest
-                        x = WalleniusNCHyp(nn, urn[0], urn[0] + urn[1], oweights[0] / oweights[1]);
-                        osample[0] += x;
-                        osample[1] += nn - x;
-                        break;
-                    }
+                if (colors2 == 1) {
+                    // only one color left. The rest is deterministic
+                    osample[0] += nn;
+                    break;
+                }
 
-                    if (colors2 == 1) {
-                        // only one color left. The rest is deterministic
-                        osample[0] += nn;
-                        break;
-                    }
+                // make sure wcum is re-calculated from beginning
+                i = 0;
+            }
 
-                    // make sure wcum is re-calculated from beginning
-                    i = 0;
-                }
+            // update list of accumulated probabilities
+            wsum = i > 0 ? wcum[i - 1] : 0.;
+            for (k = i; k < colors2; k++) {
+                wsum += urn[k] * oweights[k];
+                wcum[k] = wsum;
+            }
+        } while (nn);
+    }
 
-                // update list of accumulated probabilities
-                wsum = i > 0 ? wcum[i - 1] : 0.;
-                for (k = i; k < colors2; k++) {
-                    wsum += urn[k] * oweights[k];
-                    wcum[k] = wsum;
-                }
-            } while (nn);
+    else {
+        if (chainThin && plan->chainValid) {
+            // continue Markov chain from previous variate
+            for (i = 0; i < colors2; i++) osample[i] = plan->chain[i];
+            f0 = plan->chainf0;  scans = chainThin;
         }
-
         else {
             // use conditional method to make starting point for
             // Metropolis-Hastings sampling
 
-            // divide weights into two groups, heavy and light
-            a = 0;  b = colors2 - 1;
-            w = sqrt(oweights[0] * oweights[colors2 - 1]);
-            do {
-                c = (a + b) / 2;
-                if (oweights[c] > w) a = c; else b = c;
-            } while (b > a + 1);
             // heavy group goes from 0 to b-1, light group goes from b to colors2-1
-
-            // calculate mean weight for heavy color group
-            for (i = 0, m1 = 0, wsum = 0; i < b; i++) {
-                m1 += urn[i];  wsum += oweights[i] * urn[i];
-            }
-            w1 = wsum / m1;
-
-            // calculate mean weight for light color group
-            for (i = b, m2 = 0, wsum = 0; i < colors2; i++) {
-                m2 += urn[i];  wsum += oweights[i] * urn[i];
-            }
-            w2 = wsum / m2;
+            b = plan->split;
 
             // split partial sample n into heavy (n1) and light (n2)
-            n1 = WalleniusNCHyp(n, m1, m1 + m2, w1 / w2);
+            n1 = WalleniusNCHyp(n, plan->m1, plan->m1 + plan->m2, plan->odds12);
             n2 = n - n1;
 
             // set parameters for first group (heavy)
@@ -658,17 +917,9 @@ void StochasticLib3::MultiWalleniusNCHyp(int32 * destination,
 
                 // split group into single colors by calling univariate distribution b-a-1 times
                 for (i = a; i < b - 1; i++) {
-                    m = urn[i];  w = oweights[i];
-
-                    // calculate mean weight of remaining colors
-                    for (j = i + 1, msum = 0, wsum = 0; j < b; j++) {
-                        m1 = urn[j];  w1 = oweights[j];
-                        msum += m1;  wsum += m1 * w1;
-                    }
-
                     // sample color i in group
-                    x = wsum ? WalleniusNCHyp(ng, m, msum + m, w * msum / wsum) : ng;
-
+                    m = urn[i];
+                    x = plan->godds[i] >= 0. ? WalleniusNCHyp(ng, m, plan->gsum[i] + m, plan->godds[i]) : ng;
                     osample[i] = x;
                     ng -= x;
                 }
@@ -682,79 +933,53 @@ void StochasticLib3::MultiWalleniusNCHyp(int32 * destination,
 
             // finished with conditional method. 
             // osample contains starting point for Metropolis-Hastings sampling
+            f0 = -1.;  scans = plan->scans;
+        }
 
-            // make object for calculating probabilities and mean
-            CMultiWalleniusNCHypergeometric wmnc(n, osource, oweights, colors2);
+        // make object for calculating probabilities
+        CMultiWalleniusNCHypergeometric wmnc(n, osource, oweights, colors2);
 
-            wmnc.mean(var); // calculate mean
-            // calculate approximate variance from mean
-            for (i = 0; i < colors; i++) {
-                r1 = var[i] * (osource[i] - var[i]);
-                r2 = (n - var[i]) * (var[i] + N - n - osource[i]);
-                if (r1 <= 0. || r2 <= 0.) {
-                    var[i] = 0.;
+        // Metropolis-Hastings sampler. Colors are rotated in the order of variance
+        for (k = 0; k < scans; k++) {
+            for (i = 0; i < colors2; i++) {
+                j = i + 1;
+                if (j >= colors2) j = 0;
+                c1 = plan->order3[i];  c2 = plan->order3[j];
+                w = oweights[c1] / oweights[c2];
+                n1 = osample[c1] + osample[c2];
+                x0 = osample[c1];
+                x = WalleniusNCHyp(n1, osource[c1], osource[c1] + osource[c2], w);
+                if (x == x0) continue; // accepted
+                if (f0 < 0.) f0 = wmnc.probability(osample);
+                CWalleniusNCHypergeometric nc(n1, osource[c1], osource[c1] + osource[c2], w, accuracy);
+                g0 = nc.probability(x0);
+                g1 = nc.probability(x);
+                osample[c1] = x;
+                osample[c2] = n1 - x;
+                f1 = wmnc.probability(osample);
+                g0 = f1 * g0;  g1 = f0 * g1;
+                if (g0 >= g1 || g0 > g1 * Random()) {
+                    // new state accepted
+                    f0 = -1.;
                 }
                 else {
-                    var[i] = N * r1 * r2 / ((N - 1) * (osource[i] * r2 + (N - osource[i]) * r1));
-                }
-            }
-
-            // sort again, this time by variance
-            for (i = 0; i < colors2 - 1; i++) {
-                c = order3[i];  k = i;
-                w = var[c];
-                for (j = i + 1; j < colors2; j++) {
-                    c2 = order3[j];
-                    if (var[c2] > w) {
-                        w = var[c2];  k = j;
-                    }
-                }
-                order3[i] = order3[k];  order3[k] = c;
-            }
-
-            // number of scans (this value of nHastings has not been fine-tuned)
-            nHastings = 4;
-            if (accuracy < 1E-6) nHastings = 6;
-            if (colors2 > 5) nHastings++;
-
-            // Metropolis-Hastings sampler
-            f0 = -1.;
-            for (k = 0; k < nHastings; k++) {
-                for (i = 0; i < colors2; i++) {
-                    j = i + 1;
-                    if (j >= colors2) j = 0;
-                    c1 = order3[i];  c2 = order3[j];
-                    w = oweights[c1] / oweights[c2];
-                    n1 = osample[c1] + osample[c2];
-                    x0 = osample[c1];
-                    x = WalleniusNCHyp(n1, osource[c1], osource[c1] + osource[c2], w);
-                    if (x == x0) continue; // accepted
-                    if (f0 < 0.) f0 = wmnc.probability(osample);
-                    CWalleniusNCHypergeometric nc(n1, osource[c1], osource[c1] + osource[c2], w, accuracy);
-                    g0 = nc.probability(x0);
-                    g1 = nc.probability(x);
-                    osample[c1] = x;
-                    osample[c2] = n1 - x;
-                    f1 = wmnc.probability(osample);
-                    g0 = f1 * g0;  g1 = f0 * g1;
-                    if (g0 >= g1 || g0 > g1 * Random()) {
-                        // new state accepted
-                        f0 = -1.;
-                    }
-                    else {
-                        // rejected. restore old sample
-                        osample[c1] = x0;
-                        osample[c2] = n1 - x0;
-                    }
+                    // rejected. restore old sample
+                    osample[c1] = x0;
+                    osample[c2] = n1 - x0;
                 }
             }
         }
+        if (chainThin) {
+            // save state of Markov chain for next variate
+            for (i = 0; i < colors2; i++) plan->chain[i] = osample[i];
+            plan->chainf0 = f0;  plan->chainValid = 1;
+        }
     }
 
     // finished sampling by either method
     // un-sort sample into destination and untangle re-orderings
     for (i = 0; i < colors; i++) {
-        c1 = order1[i];  c2 = order2[i];
+        c1 = plan->order1[i];  c2 = order2[i];
         if (source[c1] == osource[c2]) {
             destination[c1] = osample[c2];
         }
@@ -769,19 +994,117 @@ void StochasticLib3::MultiWalleniusNCHyp(int32 * destination,
 }
 
 
+void StochasticLib3::MultiWalleniusNCHypBatch(int64 * destination, int k, 
+int64 * source, double * weights, int64 n, int colors) {
+    // Sampling k variates from multivariate Wallenius noncentral 
+    // hypergeometric distribution, stored consecutively in destination.
+    // If the sampling plan uses the urn experiment and n < 30, the k 
+    // variates are simulated together, with one lane for each variate. Each
+    // ball is taken in all lanes at once, using a block of uniform random 
+    // numbers. The color is found by comparing with the accumulated weights
+    // of all colors, and the counts are updated for all colors with a mask.
+    // Otherwise the variates are made one by one by MultiWalleniusNCHyp.
+    // The limit is the same as for the urn method in WalleniusNCHyp. The time
+    // of the simulation is proportional to n, and MultiWalleniusNCHyp 
+    // switches to the univariate distribution when two colors are left and 
+    // more than 50 balls remain, which the batch does not do.
+    SMultiPlan * plan;                   // sampling plan
+    double urn[MAXCOLORS][URN_LANES];    // balls left in urn
+    double sample[MAXCOLORS][URN_LANES]; // balls sampled
+    double p[URN_LANES];                 // random point in accumulated weights
+    double cum[URN_LANES];               // accumulated weight
+    double done[URN_LANES];              // 1 if ball has been taken
+    double h;                            // 1 if this color is taken
+    double w;                            // weight of one color
+    int64 osample[MAXCOLORS];            // sample of one variate
+    int64 osource[MAXCOLORS];            // pooled balls of one variate
+    int64 * dest;                        // destination of one variate
+    int64 ball, x;                       // ball number, sample of one color
+    int i, l, c, c1, c2;                 // loop counters, color index
+    int colors2;                         // number of pooled colors
+
+    if (k > URN_LANES) FatalError("Too many variates in function MultiWalleniusNCHypBatch");
+    if (n <= 0 || n >= 30 || colors <= 0 || colors > MAXCOLORS || k < 2 
+    || (plan = MultiPlan(0, source, weights, n, colors))->method != 2) {
+        // not using urn simulation
+        for (l = 0; l < k; l++) MultiWalleniusNCHyp(destination + l * colors, source, weights, n, colors);
+        return;
+    }
+    // All lanes are calculated so that the loops have a constant count, which 
+    // makes it easier for the compiler to vectorize. Unused lanes have p = 0
+    colors2 = plan->colors2;
+    for (c = 0; c < colors2; c++) {
+        for (l = 0; l < URN_LANES; l++) {
+            urn[c][l] = (double)plan->osource[c];  sample[c][l] = 0.;
+        }
+    }
+    for (l = 0; l < URN_LANES; l++) p[l] = 0.;
+
+    // take one ball in each lane
+    for (ball = 0; ball < n; ball++) {
+        RandomBlock(p, k);
+        for (l = 0; l < URN_LANES; l++) cum[l] = 0.;
+        for (c = 0; c < colors2; c++) {
+            w = plan->oweights[c];
+            for (l = 0; l < URN_LANES; l++) cum[l] += urn[c][l] * w;
+        }
+        for (l = 0; l < URN_LANES; l++) {
+            p[l] *= cum[l];  cum[l] = 0.;  done[l] = 0.;
+        }
+        for (c = 0; c < colors2; c++) {
+            w = plan->oweights[c];
+            for (l = 0; l < URN_LANES; l++) {
+                cum[l] += urn[c][l] * w;
+                h = (double)(p[l] < cum[l]) * (1. - done[l]);
+                urn[c][l] -= h;  sample[c][l] += h;  done[l] += h;
+            }
+        }
+        for (l = 0; l < k; l++) {
+            if (done[l] == 0.) {
+                // p rounded up to the total weight. Take the last color left
+                for (c = colors2 - 1; urn[c][l] == 0.; c--);
+                urn[c][l] -= 1.;  sample[c][l] += 1.;
+            }
+        }
+    }
+
+    // un-sort each sample into destination as in MultiWalleniusNCHyp
+    for (l = 0; l < k; l++) {
+        dest = destination + l * colors;
+        for (c = 0; c < colors2; c++) {
+            osample[c] = (int64)sample[c][l];  osource[c] = plan->osource[c];
+        }
+        for (i = plan->colors1; i < colors; i++) dest[plan->order1[i]] = 0;
+        for (i = 0; i < plan->colors1; i++) {
+            c1 = plan->order1[i];  c2 = plan->order2[i];
+            if (source[c1] == osource[c2]) {
+                dest[c1] = osample[c2];
+            }
+            else {
+                // split colors with same weight that have been treated as one
+                x = Hypergeometric(osample[c2], source[c1], osource[c2]);
+                dest[c1] = x;
+                osample[c2] -= x;
+                osource[c2] -= source[c1];
+            }
+        }
+    }
+}
+
+
 /******************************************************************************
   Multivariate complementary Wallenius noncentral hypergeometric distribution
 ******************************************************************************/
 
 void StochasticLib3::MultiComplWalleniusNCHyp(
-    int32 * destination, int32 * source, double * weights, int32 n, int colors) {
+    int64 * destination, int64 * source, double * weights, int64 n, int colors) {
     // This function generates a vector of random variables with the multivariate
     // complementary Wallenius noncentral hypergeometric distribution.
     // See MultiWalleniusNCHyp for details.
     double rweights[MAXCOLORS];          // reciprocal weights
-    int32 sample[MAXCOLORS];             // balls sampled
+    int64 sample[MAXCOLORS];             // balls sampled
     double w;                            // weight
-    int32 N;                             // total number of balls
+    int64 N;                             // total number of balls
     int i;                               // color index
 
     // make reciprocal weights and calculate N
@@ -805,7 +1128,7 @@ void StochasticLib3::MultiComplWalleniusNCHyp(
 /******************************************************************************
             Fisher's noncentral hypergeometric distribution
 ******************************************************************************/
-int32 StochasticLib3::FishersNCHyp(int32 n, int32 m, int32 N, double odds) {
+int64 StochasticLib3::FishersNCHyp(int64 n, int64 m, int64 N, double odds) {
     /*
     This function generates a random variate with Fisher's noncentral
     hypergeometric distribution.
@@ -820,8 +1143,8 @@ int32 StochasticLib3::FishersNCHyp(int32 n, int32 m, int32 N, double odds) {
     are small, and the ratio-of-uniforms rejection method when the former
     method would be too slow or would give overflow.
     */
-    int32 fak, addd;     // used for undoing transformations
-    int32 x;             // result
+    int64 fak, addd;     // used for undoing transformations
+    int64 x;             // result
 
     // check if parameters are valid
     if (n > N || m > N || n < 0 || m < 0 || odds <= 0.) {
@@ -884,8 +1207,8 @@ int32 StochasticLib3::FishersNCHyp(int32 n, int32 m, int32 N, double odds) {
              Subfunctions used by FishersNCHyp
 ***********************************************************************/
 
-int32 StochasticLib3::FishersNCHypInversion
-(int32 n, int32 m, int32 N, double odds) {
+int64 StochasticLib3::FishersNCHypInversion
+(int64 n, int64 m, int64 N, double odds) {
     /*
     Subfunction for FishersNCHyp distribution.
     Implements Fisher's noncentral hypergeometric distribution by inversion
@@ -900,11 +1223,9 @@ int32 StochasticLib3::FishersNCHypInversion
 
     See the file nchyp.pdf for theoretical explanation.
     */
-    static int32 fnc_n_last = -1, fnc_m_last = -1, fnc_N_last = -1;
-    static double   fnc_o_last = -1, fnc_f0, fnc_scale;
-
-    int32 x;                       // x value
-    int32 L;                       // derived parameter
+    SFNCInversionSetup * s;        // set-up for these parameters
+    int64 x;                       // x value
+    int64 L;                       // derived parameter
     double f;                      // scaled function value 
     double sum;                    // scaled sum of function values
     double a1, a2, b1, b2, f1, f2; // factors in recursive calculation
@@ -912,9 +1233,9 @@ int32 StochasticLib3::FishersNCHypInversion
 
     L = N - m - n;
 
-    if (n != fnc_n_last || m != fnc_m_last || N != fnc_N_last || odds != fnc_o_last) {
-        // parameters have changed. set-up
-        fnc_n_last = n; fnc_m_last = m; fnc_N_last = N; fnc_o_last = odds;
+    if (!FindSetup(fncInversionSetup, SETUP_ENTRIES, n, m, N, odds, s)) {
+        // parameters are not in the cache. set-up
+        double & fnc_f0 = s->f0, & fnc_scale = s->scale;
 
         // f(0) is set to an arbitrary value because it cancels out.
         // A low value is chosen to avoid overflow.
@@ -940,14 +1261,15 @@ int32 StochasticLib3::FishersNCHypInversion
         fnc_scale = sum;
         // now f(0) = fnc_f0 / fnc_scale.
         // We are still avoiding all divisions by saving the scale factor
+        s->lastUse = setupClock;                      // set-up is complete
     }
 
     // uniform random
-    u = Random() * fnc_scale;
+    u = Random() * s->scale;
 
     // recursive calculation:
     // f(x) = f(x-1) * (m-x+1)*(n-x+1)*odds / (x*(L+x))
-    f = fnc_f0;  x = 0;  a1 = m;  a2 = n;  b1 = 0;  b2 = L;
+    f = s->f0;  x = 0;  a1 = m;  a2 = n;  b1 = 0;  b2 = L;
     do {
         u -= f;
         if (u <= 0) break;
@@ -962,8 +1284,8 @@ int32 StochasticLib3::FishersNCHypInversion
 }
 
 
-int32 StochasticLib3::FishersNCHypRatioOfUnifoms
-(int32 n, int32 m, int32 N, double odds) {
+int64 StochasticLib3::FishersNCHypRatioOfUnifoms
+(int64 n, int64 m, int64 N, double odds) {
     /*
     Subfunction for FishersNCHyp distribution.
     Valid for 0 <= n <= m <= N/2, odds != 1
@@ -973,28 +1295,22 @@ int32 StochasticLib3::FishersNCHypRatioOfUnifoms
 
     The execution time of this function is almost independent of the parameters.
     */
-    static int32 fnc_n_last = -1, fnc_m_last = -1, fnc_N_last = -1; // previous parameters
-    static double fnc_o_last = -1;
-    static int32 fnc_bound;              // upper bound
-    static double fnc_a;                 // hat center
-    static double fnc_h;                 // hat width
-    static double fnc_lfm;               // ln(f(mode))
-    static double fnc_logb;              // ln(odds)
-    int32 L;                             // N-m-n
-    int32 mode;                          // mode
+    SFNCRatioSetup * s;                  // set-up for these parameters
+    int64 L;                             // N-m-n
+    int64 mode;                          // mode
     double mean;                         // mean
     double variance;                     // variance
     double x;                            // real sample
-    int32 k;                             // integer sample
+    int64 k;                             // integer sample
     double u;                            // uniform random
     double lf;                           // ln(f(x))
     double AA, BB, g1, g2;               // temporary
 
     L = N - m - n;
 
-    if (n != fnc_n_last || m != fnc_m_last || N != fnc_N_last || odds != fnc_o_last) {
-        // parameters have changed. set-up
-        fnc_n_last = n;  fnc_m_last = m;  fnc_N_last = N;  fnc_o_last = odds;
+    if (!FindSetup(fncRatioSetup, SETUP_ENTRIES, n, m, N, odds, s)) {
+        // parameters are not in the cache. set-up
+        double & fnc_logb = s->logb, & fnc_a = s->a, & fnc_h = s->h;
 
         // find approximate mean
         AA = (m + n) * odds + L; BB = sqrt(AA * AA - 4 * odds * (odds - 1) * m * n);
@@ -1012,27 +1328,40 @@ int32 StochasticLib3::FishersNCHypRatioOfUnifoms
         fnc_h = 1.028 + 1.717 * sqrt(variance + 0.5) + 0.032 * fabs(fnc_logb);
 
         // find safety bound
-        fnc_bound = (int32)(mean + 4.0 * fnc_h);
-        if (fnc_bound > n) fnc_bound = n;
+        s->bound = (int64)(mean + 4.0 * fnc_h);
+        if (s->bound > n) s->bound = n;
 
         // find mode
-        mode = (int32)(mean);
+        mode = (int64)(mean);
         g1 = (double)(m - mode) * (n - mode) * odds;
         g2 = (double)(mode + 1) * (L + mode + 1);
         if (g1 > g2 && mode < n) mode++;
 
         // value at mode to scale with:
-        fnc_lfm = mode * fnc_logb - fc_lnpk(mode, L, m, n);
+        s->lfm = mode * fnc_logb - fc_lnpk(mode, L, m, n);
+        s->mode = mode;
+        s->lastUse = setupClock;                      // set-up is complete
     }
 
+    const double fnc_a = s->a, fnc_h = s->h, fnc_lfm = s->lfm, fnc_logb = s->logb; // hat and scale
+    const int64 fnc_bound = s->bound, fnc_mode = s->mode; // safety bound and mode
+
     while (true) {
         u = Random();
         if (u == 0) continue;                       // avoid divide by 0
         x = fnc_a + fnc_h * (Random() - 0.5) / u;
-        if (x < 0. || x > 2E9) continue;            // reject, avoid overflow
-        k = (int32)(x);                             // truncate
+        if (x < 0. || x > 9E18) continue;           // reject, avoid overflow
+        k = (int64)(x);                             // truncate
         if (k > fnc_bound) continue;                // reject if outside safety bound
-        lf = k * fnc_logb - fc_lnpk(k, L, m, n) - fnc_lfm; // compute function value
+        if (N > LARGE_URN) {
+            // difference of log factorials relative to mode avoids loss of precision
+            lf = (double)(k - fnc_mode) * fnc_logb
+                - (LnFacDiff(k, fnc_mode) + LnFacDiff(m - k, m - fnc_mode)
+                + LnFacDiff(n - k, n - fnc_mode) + LnFacDiff(L + k, L + fnc_mode));
+        }
+        else {
+            lf = k * fnc_logb - fc_lnpk(k, L, m, n) - fnc_lfm; // compute function value
+        }
         if (u * (4.0 - u) - 3.0 <= lf) break;       // lower squeeze accept
         if (u * (u - lf) > 1.0) continue;             // upper squeeze reject
         if (2.0 * log(u) <= lf) break;
@@ -1045,8 +1374,8 @@ int32 StochasticLib3::FishersNCHypRatioOfUnifoms
 /***********************************************************************
      Multivariate Fisher's noncentral hypergeometric distribution
 ***********************************************************************/
-void StochasticLib3::MultiFishersNCHyp(int32 * destination,
-    int32 * source, double * weights, int32 n, int colors) {
+void StochasticLib3::MultiFishersNCHyp(int64 * destination,
+    int64 * source, double * weights, int64 n, int colors) {
     /*
     This function generates a vector of random variates with the
     multivariate Fisher's noncentral hypergeometric distribution.
@@ -1082,125 +1411,66 @@ void StochasticLib3::MultiFishersNCHyp(int32 * destination,
     are taken. The problem thus reduced is handled in the arrays osource,
     oweights and osample of dimension colors2.
     */
-    int order1[MAXCOLORS];       // sort order, index into source and destination
-    int order2[MAXCOLORS];       // corresponding index into osource when equal weights pooled together
-    int order3[MAXCOLORS];       // secondary index for sorting by variance
-    int32 osource[MAXCOLORS];    // contents of source, sorted by weight with equal weights pooled together
-    int32 osample[MAXCOLORS];    // balls sampled, sorted by weight
-    double oweights[MAXCOLORS];  // sorted list of weights
-    double var[MAXCOLORS];       // sorted list of variance
-    int32 x = 0;                 // univariate sample
-    int32 m;                     // number of items of one color
-    int32 m1, m2;                // number of items in each weight group
-    int32 msum;                  // total number of items of several or all colors
-    int32 n0;                    // remaining balls to sample
-    int32 n1, n2;                // sample size for each weight group
-    double w = 0.;               // weight or variance of items of one color
-    double w1, w2;               // mean weight of each weight group  
-    double wsum;                 // total weight of all items of several or all colors
+    SMultiPlan * plan;           // sampling plan with the set-up for these parameters
+    int64 osource[MAXCOLORS];    // contents of source, sorted by weight with equal weights pooled together
+    int64 osample[MAXCOLORS];    // balls sampled, sorted by weight
+    double * oweights;           // sorted list of weights
+    int64 x = 0;                 // univariate sample
+    int64 m;                     // number of items of one color
+    int64 n0;                    // remaining balls to sample
+    int64 n1, n2;                // sample size for each weight group
     double odds;                 // weight ratio
     int i, j, k;                 // loop counters
     int a, b;                    // limits for weight group
     int c, c1, c2;               // color index
     int colors2;                 // reduced number of colors, number of entries in osource
-    int ngibbs;                  // number of scans in Gibbs sampler
-    int invert = 0;              // 1 if symmetry transformation used
+    int scans = 0;               // number of Gibbs scans
 
     // check validity of parameters
     if (n < 0 || colors < 0 || colors > MAXCOLORS) FatalError("Parameter out of range in function MultiFishersNCHyp");
     if (colors == 0) return;
     if (n == 0) { for (i = 0; i < colors; i++) destination[i] = 0; return; }
 
-    // check validity of array parameters
-    for (i = 0, msum = 0; i < colors; i++) {
-        m = source[i];  w = weights[i];
-        if (m < 0 || w < 0) FatalError("Parameter negative in function MultiFishersNCHyp");
-        if (w) msum += m;
-    }
-
-    // sort by weight, heaviest first
-    for (i = 0; i < colors; i++) order1[i] = order3[i] = i;
-    for (i = 0; i < colors - 1; i++) {
-        c = order1[i];  k = i;
-        w = weights[c];  if (source[c] == 0) w = 0;
-        for (j = i + 1; j < colors; j++) {
-            c2 = order1[j];
-            if (weights[c2] > w && source[c2]) {
-                w = weights[c2];  k = j;
-            }
-        }
-        order1[i] = order1[k];  order1[k] = c;
-    }
+    // find or make sampling plan
+    plan = MultiPlan(1, source, weights, n, colors);
 
     // Skip any items with zero weight
-    // this solves all problems with zero weights
-    while (colors && (weights[c = order1[colors - 1]] == 0 || source[c] == 0)) {
-        colors--;  destination[c] = 0;
-    }
+    for (i = plan->colors1; i < colors; i++) destination[plan->order1[i]] = 0;
+    colors = plan->colors1;
 
-    // check if we are taking all, or too many, balls
-    if (n >= msum) {
-        if (n > msum) FatalError("Taking more items than there are in function MultiFishersNCHyp");
-        for (i = 0; i < colors; i++) { c = order1[i];  destination[c] = source[c]; }
+    // check if we are taking all balls
+    if (plan->method == 0) {
+        for (i = 0; i < colors; i++) { c = plan->order1[i];  destination[c] = source[c]; }
         return;
     }
 
-    if (n > msum / 2) {
-        // improve accuracy by symmetry transformation
-        for (i = 0, j = colors - 1; i < j; i++, j--) { // reverse order list
-            c = order1[i];  order1[i] = order1[j];  order1[j] = c;
-        }
-        n = msum - n;  invert = 1;
-    }
-
-    // copy source and weights into ordered lists and pool together colors with same weight
-    for (i = 0, c2 = -1; i < colors; i++) {
-        c = order1[i];
-        if (i == 0 || weights[c] != w) {
-            c2++;
-            x = source[c];
-            oweights[c2] = w = invert ? 1. / weights[c] : weights[c];
-        }
-        else {
-            x += source[c];
-        }
-        osource[c2] = x;
-        order2[i] = c2;
-        osample[c2] = 0;
+    // copy ordered lists from plan. n is changed if symmetry transformation is used
+    n = plan->nn;
+    colors2 = plan->colors2;
+    oweights = plan->oweights;
+    for (i = 0; i < colors2; i++) {
+        osource[i] = plan->osource[i];
+        osample[i] = 0;
     }
-    colors2 = c2 + 1;
 
     // simple cases  
     if (colors2 == 1) osample[0] = n;
     if (colors2 == 2) {
-        x = FishersNCHyp(n, osource[0], msum, oweights[0] / oweights[1]);
+        x = FishersNCHyp(n, osource[0], plan->N, oweights[0] / oweights[1]);
         osample[0] = x;  osample[1] = n - x;
     }
 
-    if (colors2 > 2) {
-        // divide weights into two groups, heavy and light
-        a = 0;  b = colors2 - 1;
-        w = sqrt(oweights[0] * oweights[colors2 - 1]);
-        do {
-            c = (a + b) / 2;
-            if (oweights[c] > w) a = c; else b = c;
-        } while (b > a + 1);
-        a = 0; // heavy group goes from a to b-1, light group goes from b to colors2-1
-
-        // calculate mean weight for heavy group
-        for (i = a, m1 = 0, wsum = 0; i < b; i++) {
-            m1 += osource[i];  wsum += oweights[i] * osource[i];
-        }
-        w1 = wsum / m1;
-
-        // calculate mean weight for light group
-        for (i = b, m2 = 0, wsum = 0; i < colors2; i++) {
-            m2 += osource[i];  wsum += oweights[i] * osource[i];
-        }
-        w2 = wsum / m2;
+    if (colors2 > 2 && chainThin && plan->chainValid) {
+        // continue Markov chain from previous variate
+        for (i = 0; i < colors2; i++) osample[i] = plan->chain[i];
+        scans = chainThin;
+    }
+    else if (colors2 > 2) {
+        // heavy group goes from a to b-1, light group goes from b to colors2-1
+        a = 0;  b = plan->split;
 
         // split sample n into heavy (n1) and light (n2) groups
-        n1 = FishersNCHyp(n, m1, m1 + m2, w1 / w2);
+        n1 = FishersNCHyp(n, plan->m1, plan->m1 + plan->m2, plan->odds12);
         n2 = n - n1;
         n0 = n1;
 
@@ -1209,26 +1479,17 @@ void StochasticLib3::MultiFishersNCHyp(int32 * destination,
 
             // split group into single colors by calling FishersNCHyp b-a-1 times
             for (i = a; i < b - 1; i++) {
-                m = osource[i];  w = oweights[i];
-
-                // calculate mean weight of remaining colors
-                for (j = i + 1, msum = 0, wsum = 0; j < b; j++) {
-                    m1 = osource[j];  w1 = oweights[j];
-                    msum += m1;  wsum += m1 * w1;
-                }
+                m = osource[i];  odds = plan->godds[i];
 
                 // split out color i
-                if (w == w1) {
-                    x = Hypergeometric(n0, m, msum + m);
+                if (odds == 0.) {
+                    x = Hypergeometric(n0, m, plan->gsum[i] + m);
+                }
+                else if (odds < 0.) {
+                    x = n0;
                 }
                 else {
-                    if (wsum == 0) {
-                        x = n0;
-                    }
-                    else {
-                        odds = w * msum / wsum;
-                        x = FishersNCHyp(n0, m, msum + m, odds);
-                    }
+                    x = FishersNCHyp(n0, m, plan->gsum[i] + m, odds);
                 }
                 osample[i] += x;
                 n0 -= x;
@@ -1240,41 +1501,30 @@ void StochasticLib3::MultiFishersNCHyp(int32 * destination,
             // set parameters for second group
             a = b;  b = colors2;  n0 = n2;
         }
+        scans = plan->scans;
+    }
 
-        // calculate variance
-        CMultiFishersNCHypergeometric(n, osource, oweights, colors2).variance(var);
-
-        // sort again, this time by variance
-        for (i = 0; i < colors2 - 1; i++) {
-            c = order3[i];  k = i;
-            w = var[c];
-            for (j = i + 1; j < colors2; j++) {
-                c2 = order3[j];
-                if (var[c2] > w) {
-                    w = var[c2];  k = j;
-                }
-            }
-            order3[i] = order3[k];  order3[k] = c;
-        }
-
-        // determine number of scans (not fine-tuned):
-        ngibbs = 4;  if (accuracy < 1E-6) ngibbs = 6;  if (colors2 > 5) ngibbs++;
-
-        // Gibbs sampler
-        for (k = 0; k < ngibbs; k++) {
+    if (colors2 > 2) {
+        // Gibbs sampler. Colors are rotated in the order of variance
+        for (k = 0; k < scans; k++) {
             for (i = 0; i < colors2; i++) {
-                c1 = order3[i];
+                c1 = plan->order3[i];
                 j = i + 1;  if (j == colors2) j = 0;
-                c2 = order3[j];
+                c2 = plan->order3[j];
                 n1 = osample[c1] + osample[c2];
                 x = FishersNCHyp(n1, osource[c1], osource[c1] + osource[c2], oweights[c1] / oweights[c2]);
                 osample[c1] = x;
                 osample[c2] = n1 - x;
             }
         }
+        if (chainThin) {
+            // save state of Markov chain for next variate
+            for (i = 0; i < colors2; i++) plan->chain[i] = osample[i];
+            plan->chainValid = 1;
+        }
     }
 
-    if (invert) {
+    if (plan->invert) {
         // reverse symmetry transformation on result
         for (i = 0; i < colors2; i++) {
             osample[i] = osource[i] - osample[i];
@@ -1283,7 +1533,7 @@ void StochasticLib3::MultiFishersNCHyp(int32 * destination,
 
     // un-sort sample into destination
     for (i = 0; i < colors; i++) {
-        c1 = order1[i];  c2 = order2[i];
+        c1 = plan->order1[i];  c2 = plan->order2[i];
         if (source[c1] == osource[c2]) {
             destination[c1] = osample[c2];
         }
@@ -13,7 +13,12 @@
 * GNU General Public License http://www.gnu.org/licenses/gpl.html
 *****************************************************************************/
 
+#include <chrono>                      // steady_clock for time limit
+#include <string.h>                    // memcpy, strncpy functions
 #include "stocc.h"                     // class definition
+#ifdef _OPENMP
+#include <omp.h>                       // omp_get_level
+#endif
 
 /***********************************************************************
 Fatal error exit (Replaces userintf.cpp)
@@ -24,5 +29,269 @@ void FatalError(const char * ErrorText) {
     
     // Error exit in R.DLL, according to the manual "Writing R Extensions". This fails if R_NO_REMAP is defined, 
     // error("%s", ErrorText);
+#ifdef _OPENMP
+    // Rf_error cannot be called from a parallel region. The error is caught
+    // by CParallelError::Run and reported after the parallel region
+    if (omp_get_level() > 0) {
+        CThreadError e = {ErrorText};
+        throw e;
+    }
+#endif
+    StopDeadline();                        // No time limit after error exit
     Rf_error("%s", ErrorText);             // Error exit in R.DLL
 }
+
+
+void CParallelError::SetError(const char * ErrorText) {
+    // Save the first error message from any thread
+#ifdef _OPENMP
+    #pragma omp critical(BiasedUrnError)
+#endif
+    {
+        if (!failed) {
+            strncpy(text, ErrorText, sizeof(text) - 1);
+            text[sizeof(text) - 1] = 0;
+#ifdef _OPENMP
+            #pragma omp atomic write
+#endif
+            failed = 1;
+        }
+    }
+}
+
+
+/***********************************************************************
+Time limit and user interrupt for long calculations
+***********************************************************************/
+// The clock is read only at every 256th call to DeadlinePassed, so that 
+// the check can be placed in inner loops. Loops with slow iterations use 
+// DeadlinePassed(true) to check every time. The check for user interrupt 
+// uses R_ToplevelExec so that R_CheckUserInterrupt does not jump out of the 
+// calculation. The caller reports the interrupt after cleaning up.
+
+static struct {
+    int    active;                      // StartDeadline has been called
+    int    status;                      // 0, DEADLINE_TIME or DEADLINE_INTERRUPT
+    int    counter;                     // Calls since last check
+    double limit;                       // Time limit in seconds, or 0
+    std::chrono::steady_clock::time_point start; // Time of StartDeadline
+} Deadline;                             // Static storage, so all fields start as zero
+
+static double DeadlineElapsed(void) {
+    // Seconds since StartDeadline
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - Deadline.start).count();
+}
+
+static void CheckInterrupt(void *) {
+    R_CheckUserInterrupt();
+}
+
+void StartDeadline(double seconds) {
+    Deadline.active = 1;  Deadline.status = 0;  Deadline.counter = 0;
+    Deadline.limit = seconds > 0. ? seconds : 0.;
+    Deadline.start = std::chrono::steady_clock::now();
+}
+
+int StopDeadline(void) {
+    int status = Deadline.status;
+    Deadline.active = Deadline.status = 0;
+    return status;
+}
+
+int DeadlinePassed(bool now) {
+    if (!Deadline.active || Deadline.status) return Deadline.status;
+    if ((++Deadline.counter & 0xFF) && !now) return 0;
+    if (Deadline.limit > 0. && DeadlineElapsed() > Deadline.limit) {
+        Deadline.status = DEADLINE_TIME;
+    }
+    else if (!R_ToplevelExec(CheckInterrupt, NULL)) {
+        Deadline.status = DEADLINE_INTERRUPT;
+    }
+    return Deadline.status;
+}
+
+void DeadlineUnwind(void *, Rboolean jump) {
+    // Cleanup function for R_UnwindProtect in RunWithDeadline
+    if (jump) StopDeadline();
+}
+
+double DeadlineRemaining(void) {
+    if (!Deadline.active || Deadline.limit <= 0.) return R_PosInf;
+    if (Deadline.status) return 0.;
+    double r = Deadline.limit - DeadlineElapsed();
+    return r > 0. ? r : 0.;
+}
+
+
+/***********************************************************************
+Number of random variates
+***********************************************************************/
+
+R_xlen_t NumberOfVariates(SEXP rnran) {
+    // Get the number of random variates desired from the parameter nran.
+    // nran may be integer or double so that more than 2^31-1 variates can be
+    // requested. If nran is a vector then the length of the vector is used,
+    // as in the random generating functions of R.
+    // An invalid value returns 0, which is caught by the caller.
+    double nran;
+    if (XLENGTH(rnran) < 1) FatalError("Parameter has wrong length");
+    if (XLENGTH(rnran) > 1) return XLENGTH(rnran);
+    nran = Rf_asReal(rnran);
+    if (!R_FINITE(nran) || nran < 0.) return 0;
+    if (nran > (double)R_XLEN_T_MAX) FatalError("Parameter nran too big");
+    return (R_xlen_t)nran;
+}
+
+
+int64 CountValue(double x) {
+    // Convert a number of balls or an x value from double to int64.
+    // Non-integer values are truncated as by as.integer in R.
+    // Values too big for int64 are limited so that they are still out of range.
+    if (ISNAN(x)) return -1;
+    if (x > 4E18) return (int64)4E18;
+    if (x < -4E18) return -(int64)4E18;
+    return (int64)x;
+}
+
+
+SEXP AllocCountVector(R_xlen_t length, int64 xmax) {
+    // Allocate a vector for returning numbers of balls. The vector is
+    // integer for compatibility with previous versions unless xmax is too
+    // big for an int. The caller must protect the result.
+    return Rf_allocVector(xmax > INT_MAX ? REALSXP : INTSXP, length);
+}
+
+
+R_xlen_t GetCounts(SEXP r, R_xlen_t i, R_xlen_t n, int64 * buf) {
+    // Read n numbers of balls or x values from vector r, starting at index i.
+    // The vector is read in pieces with INTEGER_GET_REGION or REAL_GET_REGION.
+    // This does not expand ALTREP vectors such as compact sequences, and it
+    // does not copy the whole vector if it is integer.
+    // The return value is the number of values read.
+    const int CHUNK = 512;              // Size of temporary buffer
+    R_xlen_t done = 0, j, k;
+    if (TYPEOF(r) == INTSXP) {
+        int ibuf[CHUNK];
+        while (done < n) {
+            k = n - done;  if (k > CHUNK) k = CHUNK;
+            k = INTEGER_GET_REGION(r, i + done, k, ibuf);
+            if (k <= 0) break;
+            for (j = 0; j < k; j++) buf[done + j] = ibuf[j] == NA_INTEGER ? -1 : ibuf[j];
+            done += k;
+        }
+    }
+    else if (TYPEOF(r) == REALSXP) {
+        double dbuf[CHUNK];
+        while (done < n) {
+            k = n - done;  if (k > CHUNK) k = CHUNK;
+            k = REAL_GET_REGION(r, i + done, k, dbuf);
+            if (k <= 0) break;
+            for (j = 0; j < k; j++) buf[done + j] = CountValue(dbuf[j]);
+            done += k;
+        }
+    }
+    else {
+        FatalError("x must be numeric");
+    }
+    return done;
+}
+
+
+/***********************************************************************
+Counter-based random number generator
+***********************************************************************/
+// Philox4x32-10 (Salmon et al. 2011) makes 128 random bits from a 128 bit 
+// counter and a 64 bit key. The key is the seed. The upper half of the 
+// counter is the substream number and the lower half counts blocks within
+// the substream. Any variate can therefore be generated independently of 
+// the others, so that the result is the same regardless of the order or 
+// the number of threads used.
+
+void StocRBase::InitRan(SEXP rseed) {
+    // Select generator and seed
+    if (XLENGTH(rseed) == 0) {
+        philox = 0;                      // Use random number generator in R.DLL
+        GetRNGstate();
+        return;
+    }
+    if (XLENGTH(rseed) != 1) FatalError("Parameter seed has wrong length");
+    double seed = *REAL(rseed);
+    if (ISNAN(seed)) {
+        // Get key from the random number generator in R.DLL
+        GetRNGstate();
+        philoxKey[0] = (uint32)(unif_rand() * 4294967296.);
+        philoxKey[1] = (uint32)(unif_rand() * 4294967296.);
+        PutRNGstate();
+    }
+    else {
+        // Use the bits of seed as key
+        if (seed == 0.) seed = 0.;       // Make -0 and +0 equal
+        memcpy(philoxKey, &seed, sizeof(philoxKey));
+    }
+    philox = 1;
+    SetStream(0);
+}
+
+void StocRBase::SetStream(R_xlen_t stream) {
+    // Start substream number stream of the counter-based generator
+    philoxCounter[0] = philoxCounter[1] = 0;
+    philoxCounter[2] = (uint32)stream;
+    philoxCounter[3] = (uint32)((unsigned long long)stream >> 32);
+    philoxPos = 4;                       // No random bits available
+}
+
+int StocRBase::VariateThreads(int nthreads, R_xlen_t nran) {
+    // Number of threads for generating nran variates. The random number 
+    // generator in R.DLL is not thread safe, so more than one thread is used
+    // only with the counter-based generator. Each thread must have at least
+    // one chunk of RNG_CHUNK variates
+#ifdef _OPENMP
+    R_xlen_t nchunks = (nran + RNG_CHUNK - 1) / RNG_CHUNK;
+    if (!philox || nthreads < 1) nthreads = 1;
+    if (nthreads > nchunks) nthreads = nchunks < 1 ? 1 : (int)nchunks;
+    return nthreads;
+#else
+    return 1;
+#endif
+}
+
+void StocRBase::RandomBlock(double * u, int n) {
+    // Fill u with n uniform random numbers in the interval [0,1), 
+    // the same as n calls to Random
+    int i = 0;
+    if (!philox) {
+        for (; i < n; i++) u[i] = unif_rand(); // From R.DLL
+        return;
+    }
+    // Use the rest of the current block
+    for (; i < n && philoxPos < 4; i++) u[i] = Random();
+    // Two numbers from each new block
+    for (; i + 2 <= n; i += 2) {
+        PhiloxBlock();
+        u[i]   = ((philoxOut[0] >> 5) * 67108864. + (philoxOut[1] >> 6)) * (1. / 9007199254740992.);
+        u[i+1] = ((philoxOut[2] >> 5) * 67108864. + (philoxOut[3] >> 6)) * (1. / 9007199254740992.);
+        philoxPos = 4;
+    }
+    if (i < n) u[i] = Random();
+}
+
+void StocRBase::PhiloxBlock() {
+    // Generate 128 random bits from counter and key, and increment counter
+    const uint32 M0 = 0xD2511F53, M1 = 0xCD9E8D57; // Multipliers
+    const uint32 W0 = 0x9E3779B9, W1 = 0xBB67AE85; // Key increments
+    uint32 c0 = philoxCounter[0], c1 = philoxCounter[1], c2 = philoxCounter[2], c3 = philoxCounter[3];
+    uint32 k0 = philoxKey[0], k1 = philoxKey[1];
+    unsigned long long p0, p1;           // Products
+    for (int round = 0; round < 10; round++) {
+        p0 = (unsigned long long)M0 * c0;
+        p1 = (unsigned long long)M1 * c2;
+        c0 = (uint32)(p1 >> 32) ^ c1 ^ k0;
+        c2 = (uint32)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32)p1;
+        c3 = (uint32)p0;
+        k0 += W0;  k1 += W1;
+    }
+    philoxOut[0] = c0;  philoxOut[1] = c1;  philoxOut[2] = c2;  philoxOut[3] = c3;
+    philoxPos = 0;
+    if (++philoxCounter[0] == 0) philoxCounter[1]++; // Next block
+}
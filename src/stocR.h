@@ -15,10 +15,35 @@
 * the R-language interface.
 * Member functions:
 *
+* void InitRan(SEXP rseed);
+* Select the random number generator. If rseed has length 0, the random 
+* number generator in R.DLL is used. Otherwise the built-in counter-based 
+* generator Philox4x32-10 is used, with rseed as key. A seed of NA takes the
+* key from the random number generator in R.DLL.
+*
+* void StartVariate(R_xlen_t i);
+* Call this before generating variate number i. With the counter-based 
+* generator, each block of RNG_CHUNK variates uses its own independent 
+* substream, so that the variates do not depend on the order in which the
+* blocks are generated.
+*
+* int VariateThreads(int nthreads, R_xlen_t nran);
+* Number of threads to use for generating nran variates. More than one thread
+* is used only with the counter-based generator.
+*
+* void CopyGenerator(const StocRBase & s);
+* Use the same generator and seed as s. Used for making one generator object 
+* for each thread.
+*
+* void RandomBlock(double * u, int n);
+* Fill u with n uniform random numbers in the interval [0,1). This gives the
+* same numbers as n calls to Random, but the counter-based generator makes 
+* two numbers from each block without testing for the end of the block.
+*
 * double Normal(double m, double s);
 * Normal distribution with mean m and standard deviation s.
 *
-* int32 Hypergeometric (int32 n, int32 m, int32 N);
+* int64 Hypergeometric (int64 n, int64 m, int64 N);
 * Hypergeometric distribution. Taking n items out N, m of which are colored.
 *
 *
@@ -73,30 +98,218 @@
    #define REXPORTS extern "C"
 #endif
 
+// Get number of random variates from parameter nran of the r functions (stocR.cpp)
+R_xlen_t NumberOfVariates(SEXP rnran);
+
+// Numbers of balls are passed from R as doubles so that urns with more than
+// 2^31-1 balls can be handled. A double represents all integers up to 2^53
+// exactly. The total number of balls in the urn must not exceed MAXURN.
+const int64 MAXURN = (int64)1 << 52;
+
+// Convert a number of balls from double to int64 (stocR.cpp).
+// NA and NaN give -1, which is rejected by the parameter checks.
+int64 CountValue(double x);
+
+// Result vector for numbers of balls. The vector is integer if all values
+// fit into an int, otherwise double. NA is stored for negative values.
+class CCountVector {
+public:
+   CCountVector(SEXP r) {                           // Constructor. r must be INTSXP or REALSXP
+      if (TYPEOF(r) == INTSXP) {pi = INTEGER(r); pd = 0;}
+      else {pi = 0; pd = REAL(r);}}
+   void set(R_xlen_t i, int64 x) {                  // Store value x at index i
+      if (pi) pi[i] = x < 0 ? NA_INTEGER : (int)x;
+      else pd[i] = x < 0 ? NA_REAL : (double)x;}
+protected:
+   int * pi;                                        // Pointer to integer data
+   double * pd;                                     // Pointer to double data
+};
+
+// Allocate a result vector for numbers of balls <= xmax (stocR.cpp)
+SEXP AllocCountVector(R_xlen_t length, int64 xmax);
+
+// Input vector of numbers of balls. The vector may be integer or double, so
+// that R does not have to copy it. NA gives -1, as with CountValue.
+class CCountInput {
+public:
+   CCountInput(SEXP r) {                            // Constructor. r must be INTSXP or REALSXP
+      if (TYPEOF(r) == INTSXP) {pi = INTEGER(r); pd = 0;}
+      else if (TYPEOF(r) == REALSXP) {pi = 0; pd = REAL(r);}
+      else FatalError("x must be numeric");}
+   int64 operator[](R_xlen_t i) const {             // Get value at index i
+      if (pi) return pi[i] == NA_INTEGER ? -1 : pi[i];
+      return CountValue(pd[i]);}
+protected:
+   const int * pi;                                  // Pointer to integer data
+   const double * pd;                               // Pointer to double data
+};
+
+// Read n numbers of balls from an integer or double vector, starting at
+// index i, without expanding ALTREP vectors such as 0:n (stocR.cpp)
+R_xlen_t GetCounts(SEXP r, R_xlen_t i, R_xlen_t n, int64 * buf);
+
+
+// Time limit and user interrupt for long calculations (stocR.cpp).
+// Long loops call DeadlinePassed periodically and stop early when it 
+// returns nonzero. The caller can then use the result obtained so far.
+// StartDeadline with seconds <= 0 sets no time limit, but still allows the
+// user to interrupt the calculation. Use only from the main thread.
+// Use RunWithDeadline rather than StartDeadline and StopDeadline, so that
+// the time limit is removed also when the calculation exits with an R error.
+const int DEADLINE_TIME = 1;           // Return value from DeadlinePassed when time limit is exceeded
+const int DEADLINE_INTERRUPT = 2;      // Return value from DeadlinePassed when user has interrupted
+void StartDeadline(double seconds);    // Start time limit
+int  StopDeadline(void);               // Remove time limit. Returns the value of DeadlinePassed
+int  DeadlinePassed(bool now = false); // Check if time limit exceeded or user interrupt
+double DeadlineRemaining(void);        // Seconds left before time limit
+void DeadlineUnwind(void * data, Rboolean jump); // Remove time limit when R unwinds the stack (stocR.cpp)
+
+template <class F>
+int RunWithDeadline(double seconds, F f) {
+   // Run the function f() with a time limit. Returns the value of StopDeadline.
+   // R_UnwindProtect removes the time limit if f exits with an R error or
+   // any other jump, so that a time limit never stays active after the call
+   SEXP cont;
+   PROTECT(cont = R_MakeUnwindCont());
+   StartDeadline(seconds);
+   R_UnwindProtect([](void * data) -> SEXP {(*(F*)data)(); return R_NilValue;}, &f,
+      DeadlineUnwind, 0, cont);
+   UNPROTECT(1);
+   return StopDeadline();
+}
+
+// Errors in parallel threads (stocR.cpp).
+// FatalError exits with Rf_error, which makes a longjmp. This would crash R
+// if done in a thread of a parallel region. Therefore, FatalError throws an
+// exception of type CThreadError when called in a parallel region. Each
+// thread runs its work through CParallelError::Run, which catches the
+// error, saves the message, and skips all remaining work once an error has
+// occurred. The main thread calls CParallelError::Check after the parallel
+// region to make the error exit.
+struct CThreadError {                               // Exception thrown by FatalError in parallel region
+   const char * text;                               // Error message
+};
+
+class CParallelError {
+public:
+   CParallelError() {failed = 0; text[0] = 0;}     // Constructor
+   template <class F>
+   void Run(F f) {                                  // Run f() in a thread. Catch error
+      int fail;
+#ifdef _OPENMP
+      #pragma omp atomic read
+#endif
+      fail = failed;
+      if (fail) return;                             // Skip work after error
+      try {
+         f();
+      }
+      catch (CThreadError & e) {
+         SetError(e.text);
+      }
+   }
+   void Check() {                                   // Error exit after parallel region. Call from main thread
+      if (failed) FatalError(text);}
+protected:
+   void SetError(const char * ErrorText);           // Save first error message (stocR.cpp)
+   int failed;                                      // An error has occurred
+   char text[256];                                  // Error message
+};
+
 
 /***********************************************************************
          Class StochasticLib1
 ***********************************************************************/
 
+// Number of variates in each substream of the counter-based generator
+const R_xlen_t RNG_CHUNK = 1024;
+
 class StocRBase {
    // This class is used as base class for the random variate generating 
    // classes when used for the R-language interface
-   // Encapsulates the random number generator in R.DLL.
+   // Encapsulates the random number generator in R.DLL, or the counter-based
+   // generator Philox4x32-10 which can make independent substreams.
 public:
-   StocRBase(int32 seed) {}                         // Constructor
-   static void InitRan() {                          // Call this before first random number
-      GetRNGstate();}                               // From R.DLL
-   static void EndRan() {                           // Call this after last random number
-      PutRNGstate();}                               // From R.DLL
+   StocRBase(int32) {philox = 0;}                   // Constructor. Seed is not used
+   void InitRan(SEXP rseed);                        // Call this before first random number. Selects generator (stocR.cpp)
+   void EndRan() {                                  // Call this after last random number
+      if (!philox) PutRNGstate();}                  // From R.DLL
+   void SetStream(R_xlen_t stream);                 // Start substream of counter-based generator (stocR.cpp)
+   int VariateThreads(int nthreads, R_xlen_t nran); // Number of threads for generating nran variates (stocR.cpp)
+   void CopyGenerator(const StocRBase & s) {        // Use same generator and seed as s
+      philox = s.philox;  philoxKey[0] = s.philoxKey[0];  philoxKey[1] = s.philoxKey[1];
+      if (philox) SetStream(0);}
+   void StartVariate(R_xlen_t i) {                  // Call before generating variate number i
+      if (philox && i % RNG_CHUNK == 0) SetStream(i / RNG_CHUNK);}
    double Random() {                                // output random float number in the interval 0 <= x < 1
-      return unif_rand();}                          // From R.DLL
+      if (!philox) return unif_rand();              // From R.DLL
+      if (philoxPos >= 4) PhiloxBlock();            // Next block of 128 random bits
+      uint32 a = philoxOut[philoxPos++] >> 5, b = philoxOut[philoxPos++] >> 6;
+      return (a * 67108864. + b) * (1. / 9007199254740992.);} // 53 bit resolution
+   void RandomBlock(double * u, int n);             // n uniform random numbers (stocR.cpp)
    double Normal(double m, double s) {              // normal distribution
-      return norm_rand()*s + m;}                    // From R.DLL
-   int32 Hypergeometric(int32 n, int32 m, int32 N); // hypergeometric distribution (stocR.cpp)
+      if (!philox) return norm_rand()*s + m;        // From R.DLL
+      double u = 1. - Random();                     // Box-Muller transformation
+      return sqrt(-2. * log(u)) * cos(6.283185307179586 * Random()) * s + m;}
+   int64 Hypergeometric(int64 n, int64 m, int64 N); // hypergeometric distribution (stocR.cpp)
 protected:
-   int32 HypInversionMod (int32 n, int32 M, int32 N);  // hypergeometric by inversion searching from mode
-   int32 HypRatioOfUnifoms (int32 n, int32 M, int32 N);// hypergeometric by ratio of uniforms method
-   static double fc_lnpk(int32 k, int32 N_Mn, int32 M, int32 n); // used by Hypergeometric
+   void PhiloxBlock();                              // Generate next block of counter-based generator (stocR.cpp)
+   int philox;                                      // Counter-based generator is used
+   int philoxPos;                                   // Next unused word in philoxOut
+   uint32 philoxKey[2];                             // Key = seed
+   uint32 philoxCounter[4];                         // Counter. Block number in [0..1], substream in [2..3]
+   uint32 philoxOut[4];                             // Random bits
+
+   int64 HypInversionMod (int64 n, int64 M, int64 N);  // hypergeometric by inversion searching from mode
+   int64 HypRatioOfUnifoms (int64 n, int64 M, int64 N);// hypergeometric by ratio of uniforms method
+   static double fc_lnpk(int64 k, int64 N_Mn, int64 M, int64 n); // used by Hypergeometric
 };
 
+
+/***********************************************************************
+Generation of random variates in multiple threads
+***********************************************************************/
+// Generate nran variates with the function f(S & sto, R_xlen_t i), which 
+// must store variate number i. The variates are divided between threads in
+// chunks of RNG_CHUNK variates. Each chunk is generated from its own 
+// substream of the counter-based generator, so the result is the same for
+// any number of threads. Each thread has its own object of class S, because
+// the set-up of the generating functions is saved in the object.
+template <class S, class F>
+void GenerateVariates(S & sto, double accuracy, R_xlen_t nran, int nthreads, F f) {
+   R_xlen_t i;                                      // Loop counter
+   if (nthreads <= 1) {
+      for (i = 0; i < nran; i++) {
+         sto.StartVariate(i);
+         f(sto, i);
+      }
+      return;
+   }
+   R_xlen_t nchunks = (nran + RNG_CHUNK - 1) / RNG_CHUNK; // Number of substreams
+   R_xlen_t c;                                      // Chunk number
+   CParallelError err;                              // Error in any thread
+#ifdef _OPENMP
+   #pragma omp parallel num_threads(nthreads) private(i)
+#endif
+   {
+      S tsto(0);                                    // Generator object for this thread
+      tsto.SetAccuracy(accuracy);
+      tsto.CopyGenerator(sto);
+#ifdef _OPENMP
+      #pragma omp for schedule(dynamic)
+#endif
+      for (c = 0; c < nchunks; c++) {
+         err.Run([&]() {
+            R_xlen_t iend = (c + 1) * RNG_CHUNK;    // End of chunk
+            if (iend > nran) iend = nran;
+            for (i = c * RNG_CHUNK; i < iend; i++) {
+               tsto.StartVariate(i);
+               f(tsto, i);
+            }
+         });
+      }
+   }
+   err.Check();                                     // Error exit from main thread
+}
+
 #endif
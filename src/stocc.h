@@ -25,9 +25,12 @@
 * double Erf (double x);
 * Calculates the error function, which is the integral of the normal distribution.
 *
-* double LnFac(int32 n);
+* double LnFac(int64 n);
 * Calculates the natural logarithm of the factorial of n.
 *
+* double LnFacDiff(int64 a, int64 b);
+* Calculates LnFac(a) - LnFac(b) without loss of precision when a and b are big.
+*
 *
 * class StochasticLib1:
 * ====================
@@ -47,8 +50,22 @@
 * int32 Binomial (int32 n, double p);
 * Binomial distribution. n trials with probability p.
 *
-* int32 Hypergeometric (int32 n, int32 m, int32 N);
+* int64 Hypergeometric (int64 n, int64 m, int64 N);
 * Hypergeometric distribution. Taking n items out N, m of which are colored.
+* The set-up for the most recently used parameter sets is saved in a cache,
+* so that a caller that alternates between several parameter sets does not
+* repeat the set-up.
+*
+* void HypergeometricSetup (SHypSetup & setup, int64 n, int64 m, int64 N);
+* int64 Hypergeometric (const SHypSetup & setup);
+* Hypergeometric distribution with an explicit set-up object. The set-up is
+* made once by HypergeometricSetup and can be kept by the caller for any 
+* number of variates with the same parameters.
+*
+* void HypergeometricBatch (int64 * x, int64 k, int64 n, int64 m, int64 N);
+* Generate k variates with the hypergeometric distribution into x, using the
+* same set-up. The random numbers are used in the same order as when the 
+* variates are made one by one.
 *
 * void Multinomial (int32 * destination, double * source, int32 n, int colors);
 * void Multinomial (int32 * destination, int32 * source, int32 n, int colors);
@@ -79,27 +96,55 @@
 * the univariate and multivariate Wallenius' and Fisher's noncentral
 * hypergeometric distributions.
 *
-* int32 WalleniusNCHyp (int32 n, int32 m, int32 N, double odds);
+* int64 WalleniusNCHyp (int64 n, int64 m, int64 N, double odds);
 * Sampling from Wallenius' noncentral hypergeometric distribution, which is 
 * what you get when taking n items out N, m of which are colored, without 
 * replacement, with bias.
 *
-* int32 FishersNCHyp (int32 n, int32 m, int32 N, double odds);
+* int64 FishersNCHyp (int64 n, int64 m, int64 N, double odds);
 * Sampling from Fisher's noncentral hypergeometric distribution which is the
 * conditional distribution of independent binomial variates given their sum n.
 *
-* void MultiWalleniusNCHyp (int32 * destination, int32 * source, double * weights, int32 n, int colors);
+* void MultiWalleniusNCHyp (int64 * destination, int64 * source, double * weights, int64 n, int colors);
 * Sampling from multivariate Wallenius' noncentral hypergeometric distribution.
 *
-* void MultiFishersNCHyp (int32 * destination, int32 * source, double * weights, int32 n, int colors);
+* void MultiFishersNCHyp (int64 * destination, int64 * source, double * weights, int64 n, int colors);
 * Sampling from multivariate Fisher's noncentral hypergeometric distribution.
 *
+* void SetChain(int thin);
+* The multivariate functions use Metropolis-Hastings or Gibbs sampling from
+* a starting point made by the conditional method. By default, each variate
+* starts a new Markov chain. With thin > 0, the chain is continued from the 
+* previous variate with the same parameters, with thin scans between 
+* variates. This is faster, but successive variates are correlated. 
+* SetChain starts new chains.
+*
+* int MultiUsesChain(int fisher, int64 * source, double * weights, int64 n, int colors);
+* Returns 1 if MultiFishersNCHyp (fisher = 1) or MultiWalleniusNCHyp 
+* (fisher = 0) uses a Markov chain for these parameters, and 0 if the
+* variates are made by a method that SetChain has no influence on.
+*
+* void WalleniusNCHypBatch (int64 * x, int k, const int64 * n, const int64 * m, const int64 * N, const double * odds);
+* void MultiWalleniusNCHypBatch (int64 * destination, int k, int64 * source, double * weights, int64 n, int colors);
+* Generate k <= URN_LANES variates at once. Variates that would be made by
+* simulating the urn model with n < 30 are simulated together, one lane for
+* each variate, without branches that depend on the random numbers, so that
+* the compiler can use vector instructions. The univariate function has one 
+* parameter set for each variate. The multivariate function stores variate 
+* i in destination[i*colors .. i*colors+colors-1]. The random numbers are
+* used in a different order than when the variates are made one by one.
+*
 *
 * Uniform random number generators (integer and float) are also available, as
 * these are inherited from the random number generator class that is the base
 * class of StochasticLib1.
 *
 *
+* The number of balls in the urn, the number of balls taken and the number
+* of balls of each color are 64 bit integers in StochasticLib3 and in the
+* following classes, so that urns with more than 2^31 balls can be handled.
+*
+*
 * class CWalleniusNCHypergeometric
 * ================================
 * This class implements various methods for calculating the probability 
@@ -133,6 +178,19 @@
 * of the multivariate Fisher's noncentral hypergeometric distribution.
 *
 *
+* class CNCHypergeometricTable
+* ============================
+* This class makes a table of probabilities and cumulative probabilities
+* for the univariate Wallenius' or Fisher's noncentral hypergeometric 
+* distribution, for calculating many values with the same parameters.
+*
+*
+* class CMultiFishersNCHypergeometricTable
+* ========================================
+* This class makes tables for exact sampling from the multivariate Fisher's
+* noncentral hypergeometric distribution when n is moderate.
+*
+*
 * source code:
 * ============
 * The code for EndOfProgram and FatalError is found in the file userintf.cpp.
@@ -144,6 +202,8 @@
 * is found in the file wnchyppr.cpp.
 * The code for the functions in CFishersNCHypergeometric and 
 * CMultiFishersNCHypergeometric is found in the file fnchyppr.cpp
+* The code for the functions in CNCHypergeometricTable and 
+* CMultiFishersNCHypergeometricTable is found in the file nchyptab.cpp.
 * LnFac is found in stoc1.cpp.
 * Erf is found in wnchyppr.cpp.
 *
@@ -225,9 +285,11 @@
          Other simple functions
 ***********************************************************************/
 
-double LnFac(int32 n);                 // log factorial (stoc1.cpp)
+double LnFac(int64 n);                 // log factorial (stoc1.cpp)
+double LnFacDiff(int64 a, int64 b);    // LnFac(a) - LnFac(b) without loss of precision (stoc1.cpp)
 double LnFacr(double x);               // log factorial of non-integer (wnchyppr.cpp)
 double FallingFactorial(double a, double b); // Falling factorial (wnchyppr.cpp)
+double LnBinom(int64 m, int64 x);     // log binomial coefficient for big m (wnchyppr.cpp)
 double Erf (double x);                 // error function (wnchyppr.cpp)
 int32 FloorLog2(float x);              // floor(log2(x)) for x > 0 (wnchyppr.cpp)
 int NumSD (double accuracy);           // used internally for determining summation interval
@@ -245,6 +307,11 @@ int NumSD (double accuracy);           // used internally for determining summat
 // constant for LnFac function:
 static const int FAK_LEN = 1024;       // length of factorial table
 
+// Urns with more balls than this use differences of log factorials
+// (LnFacDiff) where LnFac would lose too much precision. Results for
+// smaller urns are calculated as before
+static const int64 LARGE_URN = 0x7FFFFFFF;
+
 // The following tables are tables of residues of a certain expansion
 // of the error function. These tables are used in the Laplace method
 // for calculating Wallenius' noncentral hypergeometric distribution.
@@ -267,6 +334,34 @@ extern "C" double ErfRes [ERFRES_N][ERFRES_L];
 extern "C" double NumSDev[ERFRES_N];
 
 
+/***********************************************************************
+Class CAliasTable
+***********************************************************************/
+
+class CAliasTable {
+   // This class makes an alias table for sampling from a discrete 
+   // distribution in constant time, using Walker's alias method with
+   // Vose's algorithm for making the table. Each variate needs one uniform 
+   // random number and one comparison.
+   // The memory for the table is supplied by the caller.
+public:
+   CAliasTable() {n = 0; prob = alias = 0;}        // constructor
+   static int32 TableLength(int32 n) {return 2 * n;} // necessary buffer length for n probabilities
+   void MakeTable(const double * p, int32 n, double * buffer); // make table from n probabilities, not necessarily normalized
+   void UseTable(double * buffer, int32 n) {       // use a table previously made by MakeTable in buffer
+      this->n = n;  prob = buffer;  alias = buffer + n;}
+   int32 random(double u) {                       // random index from uniform u in [0,1)
+      double v = u * n;
+      int32 i = (int32)v;
+      if (i >= n) i = n - 1;                      // in case u * n is rounded up to n
+      return v - i < prob[i] ? i : (int32)alias[i];}
+protected:
+   int32 n;                            // number of entries
+   double * prob;                      // probability of keeping index i, scaled to [0,1]
+   double * alias;                     // alternative index, stored as double
+};
+
+
 /***********************************************************************
          Class StochasticLib1
 ***********************************************************************/
@@ -282,7 +377,20 @@ public:
    #endif
    int32 Poisson (double L);           // poisson distribution
    int32 Binomial (int32 n, double p); // binomial distribution
-   int32 Hypergeometric (int32 n, int32 m, int32 N); // hypergeometric distribution
+   int64 Hypergeometric (int64 n, int64 m, int64 N); // hypergeometric distribution
+   struct SHypSetup {                  // set-up for the hypergeometric distribution
+      int64 n, m, N;                   // parameters
+      int64 lastUse;                   // time of last use in set-up cache. 0 = unused
+      int method;                      // 0: only one possible result, 1: inversion, 2: ratio-of-uniforms
+      int64 fak, addd;                 // for undoing symmetry transformations
+      int64 tn, tm;                    // n and m after symmetry transformations
+      int64 mode, mp, bound;           // mode, mode + 1, safety bound
+      double fm;                       // value at mode (inversion)
+      double a, h, g;                  // hat center, hat width, ln(f(mode)) (ratio-of-uniforms)
+   };
+   void HypergeometricSetup (SHypSetup & setup, int64 n, int64 m, int64 N); // make set-up for hypergeometric distribution
+   int64 Hypergeometric (const SHypSetup & setup); // hypergeometric distribution with set-up made by HypergeometricSetup
+   void HypergeometricBatch (int64 * x, int64 k, int64 n, int64 m, int64 N); // k variates with hypergeometric distribution
    void Multinomial (int32 * destination, double * source, int32 n, int colors); // multinomial distribution
    void Multinomial (int32 * destination, int32 * source, int32 n, int colors);  // multinomial distribution
    void MultiHypergeometric (int32 * destination, int32 * source, int32 n, int colors); // multivariate hypergeometric distribution
@@ -290,7 +398,7 @@ public:
 
    // functions used internally
 protected:
-   static double fc_lnpk(int32 k, int32 N_Mn, int32 M, int32 n); // used by Hypergeometric
+   static double fc_lnpk(int64 k, int64 N_Mn, int64 M, int64 n); // used by Hypergeometric
 
    // subfunctions for each approximation method
    int32 PoissonInver(double L);                       // poisson by inversion
@@ -298,11 +406,18 @@ protected:
    int32 PoissonLow(double L);                         // poisson for extremely low L
    int32 BinomialInver (int32 n, double p);            // binomial by inversion
    int32 BinomialRatioOfUniforms (int32 n, double p);  // binomial by ratio of uniforms
-   int32 HypInversionMod (int32 n, int32 M, int32 N);  // hypergeometric by inversion searching from mode
-   int32 HypRatioOfUnifoms (int32 n, int32 M, int32 N);// hypergeometric by ratio of uniforms method
+   int64 HypInversionMod (const SHypSetup & s);        // hypergeometric by inversion searching from mode
+   int64 HypRatioOfUnifoms (const SHypSetup & s);      // hypergeometric by ratio of uniforms method
 
    // variables used by Normal distribution
    double normal_x2;  int normal_x2_valid;
+   // Cache of set-up for the hypergeometric distribution. The conditional
+   // method of the multivariate distributions alternates between several
+   // parameter sets. The least recently used entry is replaced.
+   static const int HYP_ENTRIES = 8;   // number of parameter sets saved
+   SHypSetup hypSetup[HYP_ENTRIES];
+   int64 hypClock;                     // counter for least recently used replacement
+   SHypSetup & FindHypSetup(int64 n, int64 m, int64 N); // find or make cache entry
 };
 
 
@@ -340,21 +455,111 @@ class StochasticLib3 : public StochasticLib1 {
 public:
    StochasticLib3(int seed); // constructor
    void SetAccuracy(double accur);  // define accuracy of calculations
-   int32 WalleniusNCHyp (int32 n, int32 m, int32 N, double odds); // Wallenius noncentral hypergeometric distribution
-   int32 FishersNCHyp (int32 n, int32 m, int32 N, double odds); // Fisher's noncentral hypergeometric distribution
-   void MultiWalleniusNCHyp (int32 * destination, int32 * source, double * weights, int32 n, int colors); // multivariate Wallenius noncentral hypergeometric distribution
-   void MultiComplWalleniusNCHyp (int32 * destination, int32 * source, double * weights, int32 n, int colors); // multivariate complementary Wallenius noncentral hypergeometric distribution
-   void MultiFishersNCHyp (int32 * destination, int32 * source, double * weights, int32 n, int colors); // multivariate Fisher's noncentral hypergeometric distribution
+   int64 WalleniusNCHyp (int64 n, int64 m, int64 N, double odds); // Wallenius noncentral hypergeometric distribution
+   int64 FishersNCHyp (int64 n, int64 m, int64 N, double odds); // Fisher's noncentral hypergeometric distribution
+   void MultiWalleniusNCHyp (int64 * destination, int64 * source, double * weights, int64 n, int colors); // multivariate Wallenius noncentral hypergeometric distribution
+   void MultiComplWalleniusNCHyp (int64 * destination, int64 * source, double * weights, int64 n, int colors); // multivariate complementary Wallenius noncentral hypergeometric distribution
+   void MultiFishersNCHyp (int64 * destination, int64 * source, double * weights, int64 n, int colors); // multivariate Fisher's noncentral hypergeometric distribution
+   void SetChain(int thin);         // continue Markov chains between multivariate variates with thin scans. 0 = independent variates. Starts new chains
+   int MultiUsesChain(int fisher, int64 * source, double * weights, int64 n, int colors); // 1 if the multivariate function uses a Markov chain for these parameters
+   static const int URN_LANES = 16; // maximum number of variates in batch functions
+   void WalleniusNCHypBatch (int64 * x, int k, const int64 * n, const int64 * m, const int64 * N, const double * odds); // k variates of WalleniusNCHyp
+   void MultiWalleniusNCHypBatch (int64 * destination, int k, int64 * source, double * weights, int64 n, int colors); // k variates of MultiWalleniusNCHyp
    // subfunctions for each approximation method
 protected:
-   int32 WalleniusNCHypUrn (int32 n, int32 m, int32 N, double odds); // WalleniusNCHyp by urn model
-   int32 WalleniusNCHypInversion (int32 n, int32 m, int32 N, double odds); // WalleniusNCHyp by inversion method
-   int32 WalleniusNCHypTable (int32 n, int32 m, int32 N, double odds); // WalleniusNCHyp by table method
-   int32 WalleniusNCHypRatioOfUnifoms (int32 n, int32 m, int32 N, double odds); // WalleniusNCHyp by ratio-of-uniforms
-   int32 FishersNCHypInversion (int32 n, int32 m, int32 N, double odds); // FishersNCHyp by inversion
-   int32 FishersNCHypRatioOfUnifoms (int32 n, int32 m, int32 N, double odds); // FishersNCHyp by ratio-of-uniforms
+   int64 WalleniusNCHypUrn (int64 n, int64 m, int64 N, double odds); // WalleniusNCHyp by urn model
+   int64 WalleniusNCHypInversion (int64 n, int64 m, int64 N, double odds); // WalleniusNCHyp by inversion method
+   int64 WalleniusNCHypTable (int64 n, int64 m, int64 N, double odds); // WalleniusNCHyp by table method
+   int64 WalleniusNCHypRatioOfUnifoms (int64 n, int64 m, int64 N, double odds); // WalleniusNCHyp by ratio-of-uniforms
+   int64 FishersNCHypInversion (int64 n, int64 m, int64 N, double odds); // FishersNCHyp by inversion
+   int64 FishersNCHypRatioOfUnifoms (int64 n, int64 m, int64 N, double odds); // FishersNCHyp by ratio-of-uniforms
    // variables
    double accuracy; // desired accuracy of calculations
+   int chainThin;   // number of scans between variates when Markov chains are continued. 0 = independent variates
+
+   // Cache of set-up data. The set-up of each sampling method is saved for the
+   // most recently used parameter sets, so that the multivariate functions and
+   // other callers that alternate between several parameter sets can avoid 
+   // repeating the set-up. The least recently used entry is replaced.
+   static const int SETUP_ENTRIES = 8;  // number of parameter sets saved for each method
+   static const int TABLE_ENTRIES = 4;  // number of tables saved for WalleniusNCHypTable
+   static const int WNC_TABLELENGTH = 512; // max length of table in WalleniusNCHypTable
+   struct SSetupKey {                   // parameters that a set-up depends on
+      int64 n, m, N;                    // number of balls taken, number of red balls, total number of balls
+      double odds, accuracy;            // odds ratio and accuracy
+      int64 lastUse;                    // time of last use for least recently used replacement. 0 = unused
+   };
+   struct SWNCTableSetup : SSetupKey {  // set-up for WalleniusNCHypTable
+      int64 len;                        // length of table, 0 if table not long enough
+      int64 x1;                         // lower x limit for table
+      CAliasTable alias;                // alias table
+      double aliasbuf[2*WNC_TABLELENGTH]; // buffer for alias table
+   };
+   struct SWNCRatioSetup : SSetupKey {  // set-up for WalleniusNCHypRatioOfUnifoms
+      int64 bound1, bound2;             // lower and upper bound
+      int64 mode;                       // mode
+      double a;                         // hat center
+      double h;                         // hat width
+      double k;                         // probability value at mode
+      int UseChopDown;                  // use chop down inversion instead
+   };
+   struct SFNCInversionSetup : SSetupKey { // set-up for FishersNCHypInversion
+      double f0, scale;                 // f(0) = f0 / scale
+   };
+   struct SFNCRatioSetup : SSetupKey {  // set-up for FishersNCHypRatioOfUnifoms
+      int64 bound;                      // upper bound
+      double a;                         // hat center
+      double h;                         // hat width
+      double lfm;                       // ln(f(mode))
+      double logb;                      // ln(odds)
+      int64 mode;                       // mode
+   };
+   SWNCTableSetup     wncTableSetup[TABLE_ENTRIES];
+   SWNCRatioSetup     wncRatioSetup[SETUP_ENTRIES];
+   SFNCInversionSetup fncInversionSetup[SETUP_ENTRIES];
+   SFNCRatioSetup     fncRatioSetup[SETUP_ENTRIES];
+   int64 setupClock;                    // counter for least recently used replacement
+   template <class S>
+   bool FindSetup(S * list, int entries, int64 n, int64 m, int64 N, double odds, S * & setup); // find cache entry
+
+   // Sampling plan for the multivariate functions. The plan contains all the
+   // set-up that does not depend on random numbers: colors sorted by weight, 
+   // colors with equal weight pooled, the split into weight groups and the 
+   // order of the Metropolis-Hastings or Gibbs scans. The plans for the most
+   // recently used parameter sets are saved, so that repeated calls with the
+   // same parameters only do the random sampling.
+   static const int PLAN_ENTRIES = 2;   // number of plans saved
+   struct SMultiPlan {
+      int64 lastUse;                    // time of last use for least recently used replacement. 0 = unused
+      int fisher;                       // 1 = Fisher's, 0 = Wallenius' distribution
+      int colors;                       // number of colors in source
+      int64 n;                          // number of balls taken
+      double accuracy;                  // accuracy
+      int64 source[MAXCOLORS];          // number of balls of each color
+      double weights[MAXCOLORS];        // weight of each color
+      int colors1;                      // number of colors with nonzero weight and number
+      int colors2;                      // number of colors when equal weights are pooled
+      int method;                       // 0: all balls taken, 1: less than 3 colors, 2: urn simulation, 3: conditional method + MCMC
+      int invert;                       // symmetry transformation used (Fisher's)
+      int64 nn;                         // number of balls taken after symmetry transformation
+      int64 N;                          // total number of balls with nonzero weight
+      int order1[MAXCOLORS];            // sort order, index into source and destination
+      int order2[MAXCOLORS];            // corresponding index into osource when equal weights pooled together
+      int order3[MAXCOLORS];            // sort order by variance, for MCMC scans
+      int64 osource[MAXCOLORS];         // source sorted by weight with equal weights pooled together
+      double oweights[MAXCOLORS];       // sorted list of weights
+      int split;                        // first color in light weight group
+      int64 m1, m2;                     // number of balls in heavy and light weight group
+      double odds12;                    // odds of heavy group relative to light group
+      int64 gsum[MAXCOLORS];            // number of balls in the rest of the group after color i
+      double godds[MAXCOLORS];          // odds for splitting color i from the rest of the group. 0 = central, -1 = all
+      int scans;                        // number of Metropolis-Hastings or Gibbs scans
+      int chainValid;                   // chain contains the state of a Markov chain
+      double chainf0;                   // probability of chain state, or -1 if not calculated
+      int64 chain[MAXCOLORS];           // state of Markov chain, indexed as osource
+   };
+   SMultiPlan multiPlan[PLAN_ENTRIES];
+   SMultiPlan * MultiPlan(int fisher, int64 * source, double * weights, int64 n, int colors); // find or make plan
 };
 
 
@@ -366,15 +571,17 @@ class CWalleniusNCHypergeometric {
    // This class contains methods for calculating the univariate
    // Wallenius' noncentral hypergeometric probability function
 public:
-   CWalleniusNCHypergeometric(int32 n, int32 m, int32 N, double odds, double accuracy=1.E-8); // constructor
-   void SetParameters(int32 n, int32 m, int32 N, double odds); // change parameters
-   double probability(int32 x);                 // calculate probability function
-   int32 MakeTable(double * table, int32 MaxLength, int32 * xfirst, int32 * xlast, bool * useTable, double cutoff = 0.); // make table of probabilities
+   CWalleniusNCHypergeometric(int64 n, int64 m, int64 N, double odds, double accuracy=1.E-8); // constructor
+   void SetParameters(int64 n, int64 m, int64 N, double odds); // change parameters
+   void SetOdds(double odds);                   // change odds only, keep n, m, N
+   double probability(int64 x);                 // calculate probability function
+   int32 MakeTable(double * table, int32 MaxLength, int64 * xfirst, int64 * xlast, bool * useTable, double cutoff = 0.); // make table of probabilities
    double mean(void);                           // approximate mean
    double variance(void);                       // approximate variance (poor approximation)
-   int32 mode(void);                              // calculate mode
+   int64 mode(void);                              // calculate mode
    double moments(double * mean, double * var); // calculate exact mean and variance
-   int BernouilliH(int32 x, double h, double rh, StochasticLib1 *sto); // used by rejection method
+   double FindOdds(double mu, double odds0);    // calculate odds from exact mean
+   int BernouilliH(int64 x, double h, double rh, StochasticLib1 *sto); // used by rejection method
 
    // implementations of different calculation methods
 protected:
@@ -391,15 +598,15 @@ protected:
 
    // parameters
    double omega;                       // Odds
-   int32 n, m, N, x;                   // Parameters
-   int32 xmin, xmax;                   // Minimum and maximum x
+   int64 n, m, N, x;                   // Parameters
+   int64 xmin, xmax;                   // Minimum and maximum x
    double accuracy;                    // Desired precision
    // parameters used by lnbico
-   int32 xLastBico;
+   int64 xLastBico;
    double bico, mFac, xFac;
    // parameters generated by findpars and used by probability, laplace, integrate:
    double r, rd, w, wr, E, phi2d;
-   int32 xLastFindpars;
+   int64 xLastFindpars;
 };
 
 
@@ -411,9 +618,9 @@ class CMultiWalleniusNCHypergeometric {
    // This class encapsulates the different methods for calculating the
    // multivariate Wallenius noncentral hypergeometric probability function
 public:
-   CMultiWalleniusNCHypergeometric(int32 n, int32 * m, double * odds, int colors, double accuracy=1.E-8); // constructor
-   void SetParameters(int32 n, int32 * m, double * odds, int colors); // change parameters
-   double probability(int32 * x);      // calculate probability function
+   CMultiWalleniusNCHypergeometric(int64 n, int64 * m, double * odds, int colors, double accuracy=1.E-8); // constructor
+   void SetParameters(int64 n, int64 * m, double * odds, int colors); // change parameters
+   double probability(int64 * x);      // calculate probability function
    void mean(double * mu);             // calculate approximate mean
    void variance(double * var, double * mean = 0); // calculate approximate variance and mean
 
@@ -432,8 +639,8 @@ protected:
    // parameters
    double * omega;
    double accuracy;
-   int32 n, N;
-   int32 * m, * x;
+   int64 n, N;
+   int64 * m, * x;
    int colors;
    int Dummy_align;
    // parameters generated by findpars and used by probability, laplace, integrate:
@@ -452,17 +659,17 @@ class CMultiWalleniusNCHypergeometricMoments: public CMultiWalleniusNCHypergeome
    // Wallenius noncentral hypergeometric distribution by calculating all the 
    // possible x-combinations with probability < accuracy
 public:
-   CMultiWalleniusNCHypergeometricMoments(int32 n, int32 * m, double * odds, int colors, double accuracy=1.E-8) 
+   CMultiWalleniusNCHypergeometricMoments(int64 n, int64 * m, double * odds, int colors, double accuracy=1.E-8) 
       : CMultiWalleniusNCHypergeometric(n, m, odds, colors, accuracy) {};
    double moments(double * mean, double * var, int32 * combinations = 0);
 
 protected:
    // functions used internally
-   double loop(int32 n, int c);        // recursive loops
+   double loop(int64 n, int c);        // recursive loops
    // data
-   int32 xi[MAXCOLORS];                // x vector to calculate probability of
-   int32 xm[MAXCOLORS];                // rounded approximate mean of x[i]
-   int32 remaining[MAXCOLORS];         // number of balls of color > c in urn
+   int64 xi[MAXCOLORS];                // x vector to calculate probability of
+   int64 xm[MAXCOLORS];                // rounded approximate mean of x[i]
+   int64 remaining[MAXCOLORS];         // number of balls of color > c in urn
    double sx[MAXCOLORS];               // sum of x*f(x)
    double sxx[MAXCOLORS];              // sum of x^2*f(x)
    int32 sn;                           // number of combinations
@@ -477,27 +684,29 @@ class CFishersNCHypergeometric {
    // This class contains methods for calculating the univariate Fisher's
    // noncentral hypergeometric probability function
 public:
-   CFishersNCHypergeometric(int32 n, int32 m, int32 N, double odds, double accuracy = 1E-8); // constructor
-   double probability(int32 x);                   // calculate probability function
-   double probabilityRatio(int32 x, int32 x0);    // calculate probability f(x)/f(x0)
-   double MakeTable(double * table, int32 MaxLength, int32 * xfirst, int32 * xlast, bool * useTable, double cutoff = 0.); // make table of probabilities
+   CFishersNCHypergeometric(int64 n, int64 m, int64 N, double odds, double accuracy = 1E-8); // constructor
+   double probability(int64 x);                   // calculate probability function
+   double probabilityRatio(int64 x, int64 x0);    // calculate probability f(x)/f(x0)
+   double MakeTable(double * table, int32 MaxLength, int64 * xfirst, int64 * xlast, bool * useTable, double cutoff = 0.); // make table of probabilities
+   double MakeLogTable(double * table, int32 MaxLength, int64 * xfirst, int64 * xlast, double cutoff = 0.); // make table of log probabilities
    double mean(void);                             // calculate approximate mean
    double variance(void);                         // approximate variance
-   int32 mode(void);                              // calculate mode (exact)
+   int64 mode(void);                              // calculate mode (exact)
    double moments(double * mean, double * var);   // calculate exact mean and variance
 
 protected:
-   double lng(int32 x);                           // natural log of proportional function
+   double lng(int64 x);                           // natural log of proportional function
 
    // parameters
    double odds;                        // odds ratio
    double logodds;                     // ln odds ratio
    double accuracy;                    // accuracy
-   int32 n, m, N;                      // Parameters
-   int32 xmin, xmax;                   // minimum and maximum of x
+   int64 n, m, N;                      // Parameters
+   int64 xmin, xmax;                   // minimum and maximum of x
 
    // parameters used by subfunctions
-   int32 xLast;
+   int64 xLast;
+   int64 xRef;                         // reference x for log factorial differences when N > LARGE_URN
    double mFac, xFac;                  // log factorials
    double scale;                       // scale to apply to lng function
    double rsum;                        // reciprocal sum of proportional function
@@ -505,6 +714,48 @@ protected:
 };
 
 
+/***********************************************************************
+Class CNCHypergeometricTable
+***********************************************************************/
+
+class CNCHypergeometricTable {
+   // This class makes a table of probabilities and cumulative probabilities
+   // for the univariate Fisher's or Wallenius' noncentral hypergeometric
+   // distribution. The table is used for calculating the probability
+   // function, the cumulative distribution function and the quantile
+   // function for many x or p values with the same parameters.
+   // The memory for the table is supplied by the caller.
+public:
+   CNCHypergeometricTable(int fisher, int64 n, int64 m, int64 N, double odds, double accuracy = 1E-8); // constructor
+   int32 TableLength(void);                       // get necessary buffer length
+   bool UseTable(int32 nx);                       // check if a table is advantageous for nx probabilities
+   void MakeTable(double * buffer, int32 BufferLength); // make table in buffer
+   double probability(int64 x);                   // probability function
+   double cumulative(int64 x, int lower_tail);    // cumulative distribution function
+   int64 quantile(double p, int lower_tail);      // quantile function
+   int32 AliasTableLength(void);                  // get buffer length for MakeAliasTable
+   void MakeAliasTable(double * buffer, int32 BufferLength); // make alias table for random, after MakeTable
+   int64 random(double u);                        // random variate from uniform u in [0,1)
+protected:
+   CFishersNCHypergeometric fnc;       // calculator for Fisher's distribution
+   CWalleniusNCHypergeometric wnc;     // calculator for Wallenius' distribution
+   int fisher;                         // 1 = Fisher's, 0 = Wallenius' distribution
+   double cutoff;                      // cutoff for tails in table
+   int64 xmin, xmax;                   // minimum and maximum of x
+   int64 x1, x2;                       // table limits
+   int64 xmean;                        // rounded mean
+   int32 Length;                       // length of each part of the table
+   bool useTable;                      // table recommended by MakeTable
+   double * table;                     // probabilities, not normalized
+   double * cleft;                     // cumulative sum from the left
+   double * cright;                    // cumulative sum from the right
+   double sum;                         // sum of table
+   double factor;                      // normalization factor
+   CAliasTable aliasTable;             // alias table for random variates
+   bool useAlias;                      // alias table has been made
+};
+
+
 /***********************************************************************
 Class CMultiFishersNCHypergeometric
 ***********************************************************************/
@@ -516,23 +767,23 @@ class CMultiFishersNCHypergeometric {
    // probability or moments is proportional to the total number of
    // possible x combinations, which may be extreme!
 public:
-   CMultiFishersNCHypergeometric(int32 n, int32 * m, double * odds, int colors, double accuracy = 1E-9); // constructor
-   double probability(int32 * x);      // calculate probability function
+   CMultiFishersNCHypergeometric(int64 n, int64 * m, double * odds, int colors, double accuracy = 1E-9); // constructor
+   double probability(int64 * x);      // calculate probability function
    void mean(double * mu);             // calculate approximate mean
    void variance(double * var, double * mean = 0); // calculate approximate variance and mean
    double moments(double * mean, double * var, int32 * combinations = 0); // calculate exact mean and variance
 protected:
    void mean1(double * mu);            // calculate approximate mean except for unused colors
-   double lng(int32 * x);              // natural log of proportional function
+   double lng(int64 * x);              // natural log of proportional function
    void SumOfAll(void);                // calculates sum of proportional function for all x combinations
-   double loop(int32 n, int c);        // recursive loops used by SumOfAll
+   double loop(int64 n, int c);        // recursive loops used by SumOfAll
    double odds[MAXCOLORS];             // copy of all nonzero odds
    double logodds[MAXCOLORS];          // log odds
-   int32 m[MAXCOLORS];                 // copy of all nonzero m
+   int64 m[MAXCOLORS];                 // copy of all nonzero m
    int   nonzero[MAXCOLORS];           // colors for which m and odds are not zero
-   int32 n;                            // number of balls to take
-   int32 N;                            // number of balls in urn
-   int32 Nu;                           // number of balls in urn with nonzero weight
+   int64 n;                            // number of balls to take
+   int64 N;                            // number of balls in urn
+   int64 Nu;                           // number of balls in urn with nonzero weight
    int Colors;                         // number of colors
    int reduced;                        // bit 0: some colors have m=0 or odds=0.
                                        // bit 1: all nonzero odds are equal
@@ -543,12 +794,48 @@ protected:
    double accuracy;                    // accuracy of calculation
 
    // data used by used by SumOfAll
-   int32 xi[MAXCOLORS];                // x vector to calculate probability of
-   int32 xm[MAXCOLORS];                // rounded approximate mean of x[i]
-   int32 remaining[MAXCOLORS];         // number of balls of color > c in urn
+   int64 xi[MAXCOLORS];                // x vector to calculate probability of
+   int64 xm[MAXCOLORS];                // rounded approximate mean of x[i]
+   int64 remaining[MAXCOLORS];         // number of balls of color > c in urn
    double sx[MAXCOLORS];               // sum of x*f(x) or mean
    double sxx[MAXCOLORS];              // sum of x^2*f(x) or variance
    int32 sn;                           // number of possible combinations of x
 };
 
+
+/***********************************************************************
+Class CMultiFishersNCHypergeometricTable
+***********************************************************************/
+
+class CMultiFishersNCHypergeometricTable {
+   // This class makes tables for exact sampling from the multivariate
+   // Fisher's noncentral hypergeometric distribution by the sequential 
+   // conditional method. The conditional distribution of each color, given
+   // the number of balls remaining to be taken, is stored as an alias table
+   // for every possible remaining number. Each variate then needs one alias
+   // table lookup for each color. The table size is proportional to 
+   // colors * n^2, so it can only be used for moderate n.
+   // The memory for the table is supplied by the caller.
+public:
+   CMultiFishersNCHypergeometricTable(int64 n, int64 * m, double * odds, int colors); // constructor
+   int32 TableLength(int32 MaxLength);            // get necessary buffer length, or 0 if more than MaxLength
+   void MakeTable(double * buffer, int32 BufferLength); // make table in buffer
+   void UseTable(double * buffer);                // use a table previously made in buffer with the same parameters
+   void random(int64 * x, const double * u);      // random variate from colors uniform u in [0,1)
+protected:
+   int64 n;                            // number of balls to take
+   int colors;                         // number of colors
+   int usedcolors;                     // number of colors with m > 0 and odds > 0
+   int nonzero[MAXCOLORS];             // index of each used color
+   int64 m[MAXCOLORS];                 // m of each used color
+   double logodds[MAXCOLORS];          // log odds of each used color
+   int64 remaining[MAXCOLORS+1];       // number of balls of used color >= i in urn
+   int64 slo[MAXCOLORS];               // lowest possible number of balls left to take before color i
+   int64 shi[MAXCOLORS];               // highest possible number of balls left to take before color i
+   int32 cellBase[MAXCOLORS];          // index to table positions for color i
+   double headLength;                  // length of temporary tables and table positions
+   int32 Length;                       // necessary buffer length
+   double * table;                     // buffer containing table
+};
+
 #endif
@@ -14,7 +14,982 @@
 
 #include <R.h>
 #include <Rinternals.h>
+#include <Rversion.h>
+#include <string.h>                     // memcpy
+#include <new>                          // placement new
 #include "stocc.h"
+#ifdef _OPENMP
+#include <omp.h>                        // multithreading
+#endif
+
+
+/******************************************************************************
+      Recycling of parameters
+******************************************************************************/
+// The functions d, p, q, and r accept vectors for all parameters. The
+// parameters are recycled to the length of the longest vector, as in the 
+// distribution functions of R. The parameter sets are sorted so that 
+// identical parameter sets are grouped together, and only one table is made
+// for each group. The groups are distributed between threads if OpenMP is 
+// available.
+
+struct SParameterSet {                  // Parameter set, used for sorting
+    int64 m1, m2, n;                    // Balls in urn and balls drawn
+    double odds;                        // Odds
+    double prec;                        // Precision
+    R_xlen_t index;                     // Index into result vector
+};
+
+static int CompareParameterSets(const void * a, const void * b) {
+    // Compare function used by qsort
+    const SParameterSet * p = (const SParameterSet *)a, * q = (const SParameterSet *)b;
+    if (p->m1 != q->m1) return p->m1 < q->m1 ? -1 : 1;
+    if (p->m2 != q->m2) return p->m2 < q->m2 ? -1 : 1;
+    if (p->n  != q->n)  return p->n  < q->n  ? -1 : 1;
+    if (p->odds != q->odds) return p->odds < q->odds ? -1 : 1;
+    if (p->prec != q->prec) return p->prec < q->prec ? -1 : 1;
+    return p->index < q->index ? -1 : (p->index > q->index ? 1 : 0);
+}
+
+static bool SameParameters(const SParameterSet & a, const SParameterSet & b) {
+    // Check if two parameter sets are identical
+    return a.m1 == b.m1 && a.m2 == b.m2 && a.n == b.n && a.odds == b.odds && a.prec == b.prec;
+}
+
+static SParameterSet * GroupParameterSets(
+    R_xlen_t nres,   // Length of result. All parameters are recycled to this length
+    SEXP rm1,        // Number of red balls in urn
+    SEXP rm2,        // Number of white balls in urn
+    SEXP rn,         // Number of balls drawn from urn
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision, // Precision of calculation
+    R_xlen_t * ngroups, // Returns the number of groups with identical parameters
+    R_xlen_t ** groups  // Returns index to first entry of each group in the list
+) {
+    // Make sorted list of parameter sets.
+    // The list and the groups index are allocated with R_alloc
+    R_xlen_t lm1 = XLENGTH(rm1), lm2 = XLENGTH(rm2), ln = XLENGTH(rn);
+    R_xlen_t lodds = XLENGTH(rodds), lprec = XLENGTH(rprecision);
+    double* pm1 = REAL(rm1), * pm2 = REAL(rm2), * pn = REAL(rn);
+    double* podds = REAL(rodds), * pprec = REAL(rprecision);
+    SParameterSet * list;               // Sorted list of parameter sets
+    R_xlen_t i, ng;                     // Loop counter, number of groups
+
+    list = (SParameterSet*)R_alloc(nres > 0 ? nres : 1, sizeof(SParameterSet));
+    for (i = 0; i < nres; i++) {
+        SParameterSet & s = list[i];
+        s.m1 = CountValue(pm1[i % lm1]);  s.m2 = CountValue(pm2[i % lm2]);  s.n = CountValue(pn[i % ln]);
+        s.odds = podds[i % lodds];  s.prec = pprec[i % lprec];  s.index = i;
+
+        // Check validity of parameters
+        if (!R_FINITE(s.odds) || s.odds < 0) FatalError("Invalid value for odds");
+        if (s.m1 < 0 || s.m2 < 0 || s.n < 0) FatalError("Negative parameter");
+        if (s.m1 + s.m2 > MAXURN) FatalError("Overflow");
+        if (s.n > s.m1 + s.m2) FatalError("n > m1 + m2: Taking more items than there are");
+        if (s.n > s.m2 && s.odds == 0) FatalError("Not enough items with nonzero weight");
+        if (!R_FINITE(s.prec) || s.prec < 0 || s.prec > 1) s.prec = 1E-7;
+    }
+
+    // Sort by parameters
+    qsort(list, nres, sizeof(SParameterSet), CompareParameterSets);
+
+    // Find groups
+    *groups = (R_xlen_t*)R_alloc(nres + 1, sizeof(R_xlen_t));
+    for (ng = 0, i = 0; i < nres; i++) {
+        if (i == 0 || !SameParameters(list[i], list[i - 1])) {
+            (*groups)[ng++] = i;
+        }
+    }
+    (*groups)[ng] = nres;
+    *ngroups = ng;
+    return list;
+}
+
+static int64 MaxXValue(SParameterSet * list, R_xlen_t nres) {
+    // Find the highest possible x value for all parameter sets in list.
+    // This is used for deciding if results can be returned as integers
+    int64 xmax = 0, x;
+    for (R_xlen_t i = 0; i < nres; i++) {
+        x = list[i].n < list[i].m1 ? list[i].n : list[i].m1;
+        if (x > xmax) xmax = x;
+    }
+    return xmax;
+}
+
+static SEXP RecycledNCHypergeo(
+    int fisher,      // 1 = Fisher's, 0 = Wallenius' distribution
+    int func,        // 0 = mass function, 1 = cumulative distribution function, 2 = quantile function
+    SEXP rx,         // x for mass function and cumulative distribution function, p for quantile function
+    SEXP rm1,        // Number of red balls in urn
+    SEXP rm2,        // Number of white balls in urn
+    SEXP rn,         // Number of balls drawn from urn
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision, // Precision of calculation
+    int lower_tail,  // TRUE: P(X <= x), FALSE: P(X > x)
+    int nthreads     // Number of threads
+) {
+    // Evaluate d, p, or q function with recycled parameters
+    R_xlen_t lx = XLENGTH(rx);          // Length of x or p vector
+    R_xlen_t nres = lx;                 // Number of values to return
+    R_xlen_t ngroups;                   // Number of groups with identical parameters
+    R_xlen_t * groups;                  // Index to first entry of each group in sorted list
+    int   * lengths;                    // Buffer length needed for each group
+    SParameterSet * list;               // Sorted list of parameter sets
+    double* buffers;                    // Buffers for all threads
+    int     MaxLength = 1;              // Biggest buffer length needed
+    R_xlen_t g;                         // Loop counter
+
+    // Length of result is the length of the longest vector, or 0 if any vector is empty
+    SEXP    rpar[5] = {rm1, rm2, rn, rodds, rprecision};
+    for (g = 0; g < 5; g++) {
+        if (XLENGTH(rpar[g]) > nres) nres = XLENGTH(rpar[g]);
+    }
+    for (g = 0; g < 5; g++) {
+        if (XLENGTH(rpar[g]) == 0) nres = 0;
+    }
+    if (lx == 0) nres = 0;
+#ifdef _OPENMP
+    if (nthreads < 1) nthreads = 1;
+#else
+    nthreads = 1;
+#endif
+
+    // Sort parameter sets into groups
+    list = GroupParameterSets(nres, rm1, rm2, rn, rodds, rprecision, &ngroups, &groups);
+
+    // Allocate result vector
+    SEXP result;
+    PROTECT(result = func == 2 ? AllocCountVector(nres, MaxXValue(list, nres)) : Rf_allocVector(REALSXP, nres));
+    double * presult = func == 2 ? 0 : REAL(result);
+    CCountVector qresult(result);
+    CCountInput px(rx);                 // x values for mass function and cumulative distribution function
+    double * pp = func == 2 ? REAL(rx) : 0;
+    lengths = (int*)R_alloc(ngroups + 1, sizeof(int));
+    LnFac(2);                           // Initialize static table before starting threads
+    CParallelError err;                 // Error in any thread
+
+    // Find buffer length needed for each group
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        lengths[g] = 0;
+        err.Run([&]() {
+            SParameterSet & s = list[groups[g]];
+            CNCHypergeometricTable tab(fisher, s.n, s.m1, s.m1 + s.m2, s.odds, s.prec);
+            R_xlen_t count = groups[g + 1] - groups[g]; // Number of values with these parameters
+            if (func != 0 || tab.UseTable(count > 0x7FFFFFFF ? 0x7FFFFFFF : (int32)count)) {
+                lengths[g] = tab.TableLength();
+            }
+            // else lengths[g] = 0: Probabilities are calculated one by one
+        });
+    }
+    err.Check();                        // Error exit from main thread
+    for (g = 0; g < ngroups; g++) {
+        if (lengths[g] > MaxLength) MaxLength = lengths[g];
+    }
+
+    // Allocate one buffer for each thread
+    buffers = (double*)R_alloc((size_t)nthreads * MaxLength, sizeof(double));
+
+    // Loop through groups
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        err.Run([&]() {
+            int thread = 0;
+    #ifdef _OPENMP
+            thread = omp_get_thread_num();
+    #endif
+            SParameterSet & s = list[groups[g]];
+            CNCHypergeometricTable tab(fisher, s.n, s.m1, s.m1 + s.m2, s.odds, s.prec);
+            R_xlen_t j, i;                  // Loop counter, index into result
+            double p;                       // Probability
+
+            if (lengths[g]) {
+                tab.MakeTable(buffers + (size_t)thread * MaxLength, lengths[g]);
+            }
+            // Loop through entries in group
+            for (j = groups[g]; j < groups[g + 1]; j++) {
+                i = list[j].index;
+                switch (func) {
+                case 0:  // Mass function
+                    presult[i] = tab.probability(px[i % lx]);
+                    break;
+                case 1:  // Cumulative distribution function
+                    presult[i] = tab.cumulative(px[i % lx], lower_tail);
+                    break;
+                default: // Quantile function
+                    p = pp[i % lx];
+                    if (!R_FINITE(p) || p < 0. || p > 1.) {
+                        qresult.set(i, -1);         // Invalid input. Return NA
+                    }
+                    else {
+                        qresult.set(i, tab.quantile(p, lower_tail));
+                    }
+                }
+            }
+        });
+    }
+    err.Check();                        // Error exit from main thread
+
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
+
+static SEXP RecycledRandomNCHypergeo(
+    int fisher,      // 1 = Fisher's, 0 = Wallenius' distribution
+    R_xlen_t nran,   // Number of random variates desired
+    SEXP rm1,        // Number of red balls in urn
+    SEXP rm2,        // Number of white balls in urn
+    SEXP rn,         // Number of balls drawn from urn
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision, // Precision of calculation
+    SEXP rseed,      // Seed for counter-based random number generator, or length 0
+    int nthreads     // Number of threads used with counter-based generator
+) {
+    // Generate random variates with recycled parameters.
+    // The variates are generated in the order of the sorted list. With the
+    // counter-based generator, the substreams follow the order of the sorted 
+    // list, and chunks of the sorted list can be generated in parallel 
+    // threads. Each thread makes its own table for a group and keeps it for
+    // the following variates in the same group.
+    R_xlen_t ngroups;                   // Number of groups with identical parameters
+    R_xlen_t * groups;                  // Index to first entry of each group in sorted list
+    SParameterSet * list;               // Sorted list of parameter sets
+    int   * lengths;                    // Table length for each group, 0 if no table
+    double* buffers;                    // Table buffers for all threads
+    double* aliasBuffers;               // Alias table buffers for all threads
+    int     MaxLength = 1;              // Biggest table length
+    int     AliasLength;                // Alias table length for biggest table
+    R_xlen_t nchunks;                   // Number of chunks of variates
+    R_xlen_t g;                         // Loop counter
+
+    if (nran <= 0) FatalError("Parameter nran must be positive");
+    if (XLENGTH(rm1) == 0 || XLENGTH(rm2) == 0 || XLENGTH(rn) == 0
+        || XLENGTH(rodds) == 0 || XLENGTH(rprecision) == 0) {
+        FatalError("Parameter has wrong length");
+    }
+
+    // Sort parameter sets into groups
+    list = GroupParameterSets(nran, rm1, rm2, rn, rodds, rprecision, &ngroups, &groups);
+
+    // Allocate result vector
+    SEXP result;
+    PROTECT(result = AllocCountVector(nran, MaxXValue(list, nran)));
+    CCountVector presult(result);
+
+    // Make object for generating variates
+    StochasticLib3 sto(0);              // Seed is not used
+    sto.InitRan(rseed);                 // Initialize RNG
+    nthreads = sto.VariateThreads(nthreads, nran); // Number of threads
+    lengths = (int*)R_alloc(ngroups, sizeof(int));
+    LnFac(2);                           // Initialize static table before starting threads
+    CParallelError err;                 // Error in any thread
+
+    // Decide which groups use a table
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        SParameterSet & s = list[groups[g]];
+        R_xlen_t count = groups[g + 1] - groups[g]; // Number of variates with these parameters
+        lengths[g] = 0;
+        if (count > 4) err.Run([&]() {
+            // It is advantageous to make a table when the number of variates
+            // is more than half the number of table entries
+            CNCHypergeometricTable tab(fisher, s.n, s.m1, s.m1 + s.m2, s.odds, s.prec);
+            if (tab.TableLength() / 6 < count) lengths[g] = tab.TableLength();
+        });
+    }
+    err.Check();                        // Error exit from main thread
+    for (g = 0; g < ngroups; g++) {
+        if (lengths[g] > MaxLength) MaxLength = lengths[g];
+    }
+
+    // Allocate one table buffer and one alias table buffer for each thread
+    AliasLength = CAliasTable::TableLength(MaxLength);
+    buffers = (double*)R_alloc((size_t)nthreads * MaxLength, sizeof(double));
+    aliasBuffers = (double*)R_alloc((size_t)nthreads * AliasLength, sizeof(double));
+
+    // Loop through chunks of the sorted list
+    nchunks = (nran + RNG_CHUNK - 1) / RNG_CHUNK;
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(nthreads)
+#endif
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        double * buffer = buffers + (size_t)thread * MaxLength;
+        double * aliasBuffer = aliasBuffers + (size_t)thread * AliasLength;
+        StochasticLib3 tsto(0);         // Generator object for this thread
+        tsto.CopyGenerator(sto);
+        SParameterSet & s0 = list[0];
+        CNCHypergeometricTable tab(fisher, s0.n, s0.m1, s0.m1 + s0.m2, s0.odds, s0.prec);
+        R_xlen_t tabGroup = -1;         // Group of the table in buffer
+        R_xlen_t c, j, jend, gend, a, b, k; // Loop counters and limits
+        const int lanes = StochasticLib3::URN_LANES;
+        int64 bn[lanes], bm[lanes], bN[lanes], bx[lanes]; // Batch of Wallenius variates
+        double bodds[lanes];
+        R_xlen_t bindex[lanes];         // Index into result for each variate in batch
+        double bprec = 0.;              // Precision of batch
+        int nb = 0;                     // Number of variates in batch
+        auto FlushBatch = [&]() {       // Generate and store batch
+            tsto.SetAccuracy(bprec);
+            tsto.WalleniusNCHypBatch(bx, nb, bn, bm, bN, bodds);
+            while (nb) {
+                nb--;  presult.set(bindex[nb], bx[nb]);
+            }
+        };
+
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+#endif
+        for (c = 0; c < nchunks; c++) {
+            err.Run([&]() {
+                j = c * RNG_CHUNK;
+                jend = j + RNG_CHUNK;  if (jend > nran) jend = nran;
+                // Find group of first variate in chunk by binary search
+                a = 0;  b = ngroups;
+                while (b - a > 1) {
+                    k = (a + b) / 2;
+                    if (groups[k] <= j) a = k; else b = k;
+                }
+                // Loop through groups in chunk
+                for (k = a; j < jend; k++) {
+                    SParameterSet & s = list[groups[k]];
+                    int64 N = s.m1 + s.m2;  // Total number of balls
+                    gend = groups[k + 1] < jend ? groups[k + 1] : jend;
+                    if (lengths[k]) {
+                        // Generate variates from table
+                        if (tabGroup != k) {
+                            tab = CNCHypergeometricTable(fisher, s.n, s.m1, N, s.odds, s.prec);
+                            tab.MakeTable(buffer, lengths[k]);
+                            // Make alias table so that each variate takes constant time
+                            tab.MakeAliasTable(aliasBuffer, AliasLength);
+                            tabGroup = k;
+                        }
+                        for (; j < gend; j++) {
+                            tsto.StartVariate(j);
+                            presult.set(list[j].index, tab.random(tsto.Random()));
+                        }
+                    }
+                    else if (fisher && s.odds == 1.) {
+                        // Central hypergeometric. Generate variates in pieces
+                        // with the same set-up
+                        int64 hx[64];       // Piece of variates
+                        R_xlen_t h, nh;     // Index and number of variates in piece
+                        while (j < gend) {
+                            tsto.StartVariate(j);
+                            nh = gend - j < 64 ? gend - j : 64;
+                            tsto.HypergeometricBatch(hx, nh, s.n, s.m1, N);
+                            for (h = 0; h < nh; h++, j++) presult.set(list[j].index, hx[h]);
+                        }
+                    }
+                    else if (fisher) {
+                        // Generate variates one by one
+                        tsto.SetAccuracy(s.prec);
+                        for (; j < gend; j++) {
+                            tsto.StartVariate(j);
+                            presult.set(list[j].index, tsto.FishersNCHyp(s.n, s.m1, N, s.odds));
+                        }
+                    }
+                    else {
+                        // Collect variates in batches, so that urn simulations 
+                        // with different parameters are made in parallel lanes.
+                        // A batch has only one precision
+                        if (nb && s.prec != bprec) FlushBatch();
+                        bprec = s.prec;
+                        for (; j < gend; j++) {
+                            tsto.StartVariate(j);
+                            bn[nb] = s.n;  bm[nb] = s.m1;  bN[nb] = N;  bodds[nb] = s.odds;
+                            bindex[nb++] = list[j].index;
+                            if (nb == lanes) FlushBatch();
+                        }
+                    }
+                }
+                if (nb) FlushBatch();       // Rest of batch at end of chunk
+            });
+        }
+    }
+    sto.EndRan();                       // Return RNG state to R.dll
+    err.Check();                        // Error exit from main thread
+
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
+
+
+/******************************************************************************
+      Lookup in table of probabilities
+******************************************************************************/
+// The d and p functions with scalar parameters look up the x values in a 
+// table of probabilities or cumulative probabilities. The x vector may be
+// integer or double, and it is read in pieces so that a compact sequence 
+// such as 0:n is not expanded. A run of consecutive x values inside the 
+// table is copied directly from the table without looking up each x value.
+
+struct SProbTable {                     // Table of probabilities and its parameters
+    int     fisher;                     // 1 = Fisher's, 0 = Wallenius' distribution
+    int     cumulative;                 // 0 = mass function, 1 = cumulative distribution function
+    int     lower_tail;                 // TRUE: P(X <= x), FALSE: P(X > x)
+    int64   m1, N, n;                   // Parameters
+    double  odds, prec;                 // Odds and precision
+    int64   x1, x2;                     // Table limits
+    int64   xmin, xmax;                 // Absolute limits for x
+    int64   xmean;                      // Left tail of cumulative table is summed up to xmean
+    double  factor;                     // Scale factor for table values
+};
+
+template <class C>
+static inline double TableValue(const SProbTable * t, const double * table, int64 x, C & calc) {
+    // Get mass function or cumulative distribution function for one x value
+    double p;
+    if (!t->cumulative) {
+        if (x >= t->x1 && x <= t->x2) return table[x - t->x1] * t->factor;
+        if (x >= t->xmin && x <= t->xmax) return calc.probability(x); // very small but not 0
+        return 0.;
+    }
+    if (x <= t->xmean) {                // Left tail
+        p = x < t->x1 ? 0. : table[x - t->x1] * t->factor;
+        return t->lower_tail ? p : 1. - p;
+    }
+    else {                              // Right tail
+        p = x >= t->x2 ? 0. : table[x - t->x1 + 1] * t->factor;
+        return t->lower_tail ? 1. - p : p;
+    }
+}
+
+template <class C>
+static void TableValues(const SProbTable * t, const double * table, C & calc, 
+SEXP rx, R_xlen_t i0, R_xlen_t n, double * buf) {
+    // Get n results for x values starting at rx[i0]. 
+    // calc is used only for x outside the table
+    const int CHUNK = 256;              // Number of x values to read at a time
+    int64   xb[CHUNK];                  // Piece of x vector
+    int64   xa, xb1;                    // First and last x in piece
+    const double * tp;                  // Pointer into table
+    double  f = t->factor;              // Scale factor
+    bool    run;                        // x values are consecutive and inside table part
+    R_xlen_t i, j, k;                   // Loop counters
+    for (i = 0; i < n; i += k) {
+        k = n - i;  if (k > CHUNK) k = CHUNK;
+        k = GetCounts(rx, i0 + i, k, xb);
+        if (k <= 0) break;
+        double * b = buf + i;
+        xa = xb[0];  xb1 = xb[k - 1];
+        // Check if all x are inside the same part of the table
+        if (!t->cumulative) run = xa >= t->x1 && xb1 <= t->x2;
+        else if (xb1 <= t->xmean) run = xa >= t->x1;
+        else run = xa > t->xmean && xb1 < t->x2;
+        // Check if x values are consecutive
+        for (j = 0; run && j < k; j++) run = xb[j] == xa + j;
+        if (run) {
+            // Copy consecutive values from table
+            tp = table + (xa - t->x1);
+            if (!t->cumulative) {
+                for (j = 0; j < k; j++) b[j] = tp[j] * f;
+            }
+            else if (xb1 <= t->xmean) {     // Left tail
+                if (t->lower_tail) for (j = 0; j < k; j++) b[j] = tp[j] * f;
+                else for (j = 0; j < k; j++) b[j] = 1. - tp[j] * f;
+            }
+            else {                          // Right tail
+                if (t->lower_tail) for (j = 0; j < k; j++) b[j] = 1. - tp[j + 1] * f;
+                else for (j = 0; j < k; j++) b[j] = tp[j + 1] * f;
+            }
+        }
+        else {
+            // Look up each x value
+            for (j = 0; j < k; j++) b[j] = TableValue(t, table, xb[j], calc);
+        }
+    }
+}
+
+
+/******************************************************************************
+      Cache of cumulative tables
+******************************************************************************/
+// The p and q functions with scalar parameters keep their normalized 
+// cumulative tables in a process-wide cache, so that repeated calls with the same 
+// parameters, for example in an apply loop, do not make the same table again.
+// A table made with a better precision is also used for a request with a 
+// poorer precision. The least recently used tables are discarded when the 
+// total size exceeds the limit set with cacheNCHypergeo. The tables are R 
+// vectors kept with R_PreserveObject, so that a lazy result vector can still
+// refer to a table after it has been discarded from the cache.
+// The cache is used only by the main thread.
+
+const int TABLE_CACHE_ENTRIES = 64;     // Maximum number of tables in cache
+
+struct STableCacheEntry {               // Entry in cache of tables
+    SEXP    table;                      // R vector containing table, or 0 if entry is unused
+    SEXP    guide;                      // Guide table for quantiles, or 0 if not made
+    SProbTable t;                       // Parameters and limits of table
+    double  size;                       // Size of table and guide table in bytes
+    int64   lastUse;                    // Time of last use
+};
+
+static struct {                         // Cache of cumulative tables
+    STableCacheEntry entry[TABLE_CACHE_ENTRIES]; // Tables
+    double  size;                       // Total size of tables in bytes
+    double  maxSize;                    // Limit for total size
+    int64   clock;                      // Incremented at each use
+    double  hits, misses, evictions;    // Statistics
+} TableCache = {{}, 0., 64. * 1024 * 1024, 0, 0., 0., 0.};
+
+static bool SameDistribution(const SProbTable & a, int fisher, int64 m1, int64 N, int64 n, double odds) {
+    // Check if a table has the specified parameters, except precision
+    return a.fisher == fisher && a.m1 == m1 && a.N == N && a.n == n && a.odds == odds;
+}
+
+static void TableCacheDiscard(int i) {
+    // Remove entry i from cache
+    STableCacheEntry & e = TableCache.entry[i];
+    if (e.table == 0) return;
+    R_ReleaseObject(e.table);
+    if (e.guide) R_ReleaseObject(e.guide);
+    TableCache.size -= e.size;
+    e.table = e.guide = 0;
+}
+
+static void TableCacheShrink(double size, bool needEntry) {
+    // Discard least recently used tables until there is room for a table of 
+    // the specified size, and a free entry if needEntry
+    int i, lru, used;
+    for (;;) {
+        lru = -1;  used = 0;
+        for (i = 0; i < TABLE_CACHE_ENTRIES; i++) {
+            if (TableCache.entry[i].table == 0) continue;
+            used++;
+            if (lru < 0 || TableCache.entry[i].lastUse < TableCache.entry[lru].lastUse) lru = i;
+        }
+        if (lru < 0) break;             // Cache is empty
+        if (TableCache.size + size <= TableCache.maxSize 
+            && !(needEntry && used == TABLE_CACHE_ENTRIES)) break;
+        TableCacheDiscard(lru);
+        TableCache.evictions++;
+    }
+}
+
+static SEXP TableCacheFind(int fisher, int64 m1, int64 N, int64 n, double odds, double prec, SProbTable * t) {
+    // Find table with the specified parameters and the same or better precision.
+    // Returns R_NilValue if not found
+    int i, best = -1;
+    for (i = 0; i < TABLE_CACHE_ENTRIES; i++) {
+        STableCacheEntry & e = TableCache.entry[i];
+        if (e.table == 0 || !SameDistribution(e.t, fisher, m1, N, n, odds) || e.t.prec > prec) continue;
+        // Use the smallest table that is good enough
+        if (best < 0 || e.t.prec > TableCache.entry[best].t.prec) best = i;
+    }
+    if (best < 0) {
+        TableCache.misses++;
+        return R_NilValue;
+    }
+    TableCache.hits++;
+    TableCache.entry[best].lastUse = ++TableCache.clock;
+    *t = TableCache.entry[best].t;
+    return TableCache.entry[best].table;
+}
+
+static void TableCacheInsert(SEXP table, const SProbTable & t) {
+    // Put table in cache
+    int i;
+    double size = (double)XLENGTH(table) * sizeof(double);
+    if (size > TableCache.maxSize) return;    // Too big for cache
+    // Tables with the same parameters and a poorer precision are not needed any more
+    for (i = 0; i < TABLE_CACHE_ENTRIES; i++) {
+        STableCacheEntry & e = TableCache.entry[i];
+        if (e.table != 0 && SameDistribution(e.t, t.fisher, t.m1, t.N, t.n, t.odds) && e.t.prec >= t.prec) {
+            TableCacheDiscard(i);
+        }
+    }
+    TableCacheShrink(size, true);
+    for (i = 0; i < TABLE_CACHE_ENTRIES; i++) {
+        STableCacheEntry & e = TableCache.entry[i];
+        if (e.table != 0) continue;
+        R_PreserveObject(table);
+        e.table = table;  e.guide = 0;  e.t = t;  e.size = size;  e.lastUse = ++TableCache.clock;
+        TableCache.size += size;
+        break;
+    }
+}
+
+static SEXP CumulativeTable(int fisher, int64 m1, int64 N, int64 n, double odds, double prec, SProbTable * t) {
+    // Get normalized cumulative table for the p and q functions from the cache, or
+    // make it. The left tail is summed from the left up to xmean, the right
+    // tail is summed from the right in order to avoid loss of precision.
+    // Returns an R vector that must be protected by the caller.
+    SEXP    rtable;                     // R vector containing table
+    double* buffer;                     // Table of probabilities
+    int     BufferLength;               // Length of table
+    double  factor = 1.;                // Scale factor
+    double  sum;                        // Used for summation
+    int64   x;                          // Temporary x
+    int64   x1, x2;                     // Table limits
+    int64   xmin, xmax;                 // Absolute limits for x
+    int64   xmean;                      // Approximate mean of x
+    bool    useTable = false;           // unused
+
+    rtable = TableCacheFind(fisher, m1, N, n, odds, prec, t);
+    if (rtable != R_NilValue) return rtable;
+
+    // min and max
+    xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
+    xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
+
+    if (fisher) {
+        // Make object for calculating probabilities
+        CFishersNCHypergeometric fnc(n, m1, N, odds, prec);
+
+        // Get necessary buffer length
+        BufferLength = (int)fnc.MakeTable(0, 0, &x1, &x2, &useTable, prec * 0.001);
+        if (BufferLength <= 0) BufferLength = 1;
+
+        // Allocate buffer
+        PROTECT(rtable = Rf_allocVector(REALSXP, BufferLength));
+        buffer = REAL(rtable);
+
+        // Make table of probabilities. The table is scaled by an arbitrary factor
+        factor = 1. / fnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+
+        // Get mean
+        xmean = (int64)(fnc.mean() + 0.5);       // Round mean
+    }
+    else {
+        // Make object for calculating probabilities
+        CWalleniusNCHypergeometric wnc(n, m1, N, odds, prec);
+
+        // Get necessary buffer length
+        BufferLength = wnc.MakeTable(0, 0, &x1, &x2, &useTable, prec * 0.001);
+        if (BufferLength <= 0) BufferLength = 1;
+
+        // Allocate buffer
+        PROTECT(rtable = Rf_allocVector(REALSXP, BufferLength));
+        buffer = REAL(rtable);
+
+        // Make table of probabilities
+        wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+
+        // Get mean
+        xmean = (int64)(wnc.mean() + 0.5);       // Round mean
+    }
+
+    // Check for consistency
+    // (The rounded mean may be outside the table if the distribution is very skewed.
+    // Example: pWNCHypergeo(x = 643, m1 = 643, m2 = 17000, n = 17610, odds=1))
+    if (xmean < x1) xmean = x1;
+    if (xmean > x2) xmean = x2;
+    if (x2 >= x1 + BufferLength) x2 = x1 + BufferLength - 1;
+
+    // Make left tail of table cumulative:
+    for (x = x1, sum = 0; x <= xmean; x++) sum = buffer[x - x1] += sum;
+
+    // Probabilities for x > xmean are calculated by summation from the
+    // right in order to avoid loss of precision.
+    // Make right tail of table cumulative from the right:
+    for (x = x2, sum = 0; x > xmean; x--) sum = buffer[x - x1] += sum;
+
+    // Normalize
+    if (factor != 1.) {
+        for (x = x1; x <= x2; x++) buffer[x - x1] *= factor;
+    }
+
+    SProbTable t1 = {fisher, 1, 1, m1, N, n, odds, prec, x1, x2, xmin, xmax, xmean, 1.};
+    *t = t1;
+    TableCacheInsert(rtable, t1);
+    UNPROTECT(1);
+    return rtable;
+}
+
+
+/******************************************************************************
+      Guide tables for quantiles
+******************************************************************************/
+// The q functions with scalar parameters find quantiles in the cumulative 
+// table made by CumulativeTable. A guide table (Chen and Asau, 1974) gives 
+// a starting point for the search so that each quantile is found in 
+// constant expected time. The guide table has K = x2 - x1 + 1 entries for
+// each tail. Entry j of the lower tail part is the first table index where 
+// P(X <= x) >= j/K. Entry j of the upper tail part is the first table index
+// where P(X > x) <= (j+1)/K. The search for p starts at entry floor(p*K) 
+// and goes up. The upper tail is searched in P(X > x) rather than 1 - P(X <= x)
+// so that small upper tail probabilities do not lose precision. 
+// The guide table is kept in the cache together with the cumulative table.
+
+static inline double LowerTail(const SProbTable * t, const double * table, int32 i) {
+    // P(X <= x) for x = x1 + i, using normalized cumulative table
+    if (t->x1 + i <= t->xmean) return table[i];
+    return t->x1 + i >= t->x2 ? 1. : 1. - table[i + 1];
+}
+
+static inline double UpperTail(const SProbTable * t, const double * table, int32 i) {
+    // P(X > x) for x = x1 + i, using normalized cumulative table
+    if (t->x1 + i <= t->xmean) return 1. - table[i];
+    return t->x1 + i >= t->x2 ? 0. : table[i + 1];
+}
+
+static SEXP GuideTable(SEXP rtable, const SProbTable * t) {
+    // Get guide table for cumulative table rtable from the cache, or make it.
+    // Returns an R vector that must be protected by the caller
+    const double * table = REAL(rtable);
+    int32   K = (int32)(t->x2 - t->x1 + 1); // Number of x values in table
+    int32   i, j;                       // Table index, guide index
+    int     c;                          // Cache index
+    SEXP    rguide;                     // R vector containing guide table
+    int   * guide;                      // Guide table
+
+    for (c = 0; c < TABLE_CACHE_ENTRIES; c++) {
+        if (TableCache.entry[c].table == rtable) break;
+    }
+    if (c < TABLE_CACHE_ENTRIES && TableCache.entry[c].guide) return TableCache.entry[c].guide;
+
+    // Make guide table
+    PROTECT(rguide = Rf_allocVector(INTSXP, 2 * (R_xlen_t)K));
+    guide = INTEGER(rguide);
+    // Lower tail
+    for (i = 0, j = 0; j < K; j++) {
+        while (i < K - 1 && LowerTail(t, table, i) < (double)j / K) i++;
+        guide[j] = i;
+    }
+    // Upper tail. The entries decrease with j
+    for (i = 0, j = K - 1; j >= 0; j--) {
+        while (i < K - 1 && UpperTail(t, table, i) > (double)(j + 1) / K) i++;
+        guide[K + j] = i;
+    }
+
+    // Put in cache together with the table
+    if (c < TABLE_CACHE_ENTRIES) {
+        STableCacheEntry & e = TableCache.entry[c];
+        double size = (double)K * 2 * sizeof(int);
+        R_PreserveObject(rguide);
+        e.guide = rguide;  e.size += size;  TableCache.size += size;
+        TableCacheShrink(0., false);
+    }
+    UNPROTECT(1);
+    return rguide;
+}
+
+static inline int64 GuideQuantile(const SProbTable * t, const double * table, const int * guide, double p, int lower_tail) {
+    // Find the lowest x for which P(X<=x) >= p when lower_tail, or the lowest x
+    // for which P(X >x) <= p when not lower_tail. p must be in [0,1]
+    int32   K = (int32)(t->x2 - t->x1 + 1); // Number of x values in table
+    int32   j = (int32)(p * K);         // Guide index
+    int32   i;                          // Table index
+    if (j >= K) j = K - 1;
+    if (lower_tail) {
+        i = guide[j];
+        while (i < K - 1 && LowerTail(t, table, i) < p) i++;
+    }
+    else {
+        i = guide[K + j];
+        while (i < K - 1 && UpperTail(t, table, i) > p) i++;
+    }
+    return t->x1 + i;
+}
+
+
+/******************************************************************************
+      cacheNCHypergeo
+      Set size limit for the cache of cumulative tables, clear the cache, 
+      and get statistics
+******************************************************************************/
+REXPORTS SEXP cacheNCHypergeo(
+    SEXP rmaxsize,   // Limit for total size of tables in bytes, or empty for no change
+    SEXP rclear      // TRUE: discard all tables and reset statistics
+) {
+    int i;
+    if (XLENGTH(rmaxsize) > 1 || XLENGTH(rclear) != 1) FatalError("Parameter has wrong length");
+    if (XLENGTH(rmaxsize) == 1) {
+        double maxsize = *REAL(rmaxsize);
+        if (ISNAN(maxsize) || maxsize < 0) FatalError("Invalid value for maxsize");
+        TableCache.maxSize = maxsize;
+        TableCacheShrink(0., false);
+    }
+    if (*LOGICAL(rclear) == 1) {
+        for (i = 0; i < TABLE_CACHE_ENTRIES; i++) TableCacheDiscard(i);
+        TableCache.hits = TableCache.misses = TableCache.evictions = 0.;
+    }
+    // Return statistics
+    int entries = 0;
+    for (i = 0; i < TABLE_CACHE_ENTRIES; i++) {
+        if (TableCache.entry[i].table != 0) entries++;
+    }
+    const char * names[] = {"hits", "misses", "evictions", "entries", "size", "maxsize"};
+    double values[] = {TableCache.hits, TableCache.misses, TableCache.evictions, 
+        (double)entries, TableCache.size, TableCache.maxSize};
+    SEXP result, rnames;
+    PROTECT(result = Rf_allocVector(REALSXP, 6));
+    PROTECT(rnames = Rf_allocVector(STRSXP, 6));
+    for (i = 0; i < 6; i++) {
+        REAL(result)[i] = values[i];
+        SET_STRING_ELT(rnames, i, Rf_mkChar(names[i]));
+    }
+    Rf_setAttrib(result, R_NamesSymbol, rnames);
+    UNPROTECT(2);
+    return result;
+}
+
+
+/******************************************************************************
+      Lazy result vectors
+******************************************************************************/
+// The d and p functions with scalar parameters and a long x vector return 
+// an ALTREP vector that refers to the table of probabilities. An element is 
+// looked up in the table only when it is accessed, so that a window into 
+// a huge support costs only the elements touched. The full result vector 
+// is allocated only when R asks for a pointer to the data.
+// ALTREP classes with C++ are supported from R version 3.6.0.
+
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 6, 0)
+#define LAZY_RESULTS 1
+#include <R_ext/Altrep.h>
+#endif
+
+const R_xlen_t LAZY_MIN_LENGTH = 1 << 16; // Minimum length of lazy result vector
+
+#ifdef LAZY_RESULTS
+template <class C>
+static void LazyFillT(SEXP data1, R_xlen_t i0, R_xlen_t n, double * buf) {
+    // Calculate n elements of lazy result vector, starting at index i0.
+    // The calculator for x outside the table is made at the first call and
+    // kept in data1, so that it is not made again for each element
+    SEXP rx = VECTOR_ELT(data1, 0);     // x vector
+    const double * table = REAL(VECTOR_ELT(data1, 1));
+    const SProbTable * t = (const SProbTable *)RAW(VECTOR_ELT(data1, 2));
+    SEXP rcalc = VECTOR_ELT(data1, 3);  // Calculator, used only for x outside table
+    if (rcalc == R_NilValue) {
+        // The calculator classes contain no pointers, so the object can 
+        // live in a raw vector
+        PROTECT(rcalc = Rf_allocVector(RAWSXP, sizeof(C)));
+        new (RAW(rcalc)) C(t->n, t->m1, t->N, t->odds, t->prec);
+        SET_VECTOR_ELT(data1, 3, rcalc);
+        UNPROTECT(1);
+    }
+    TableValues(t, table, *(C *)RAW(rcalc), rx, i0, n, buf);
+}
+
+static void LazyFill(SEXP data1, R_xlen_t i0, R_xlen_t n, double * buf) {
+    // Calculate n elements of lazy result vector with the right distribution
+    if (((const SProbTable *)RAW(VECTOR_ELT(data1, 2)))->fisher) {
+        LazyFillT<CFishersNCHypergeometric>(data1, i0, n, buf);
+    }
+    else {
+        LazyFillT<CWalleniusNCHypergeometric>(data1, i0, n, buf);
+    }
+}
+
+static R_altrep_class_t LazyResultClass;
+
+// ALTREP methods. data1 = list(x, table, SProbTable, calculator or NULL), data2 = full result when made
+static R_xlen_t LazyLength(SEXP sx) {
+    return XLENGTH(VECTOR_ELT(R_altrep_data1(sx), 0));
+}
+
+static void * LazyDataptr(SEXP sx, Rboolean) {
+    // Make the full result vector when R needs a pointer to the data
+    SEXP full = R_altrep_data2(sx);
+    if (full == R_NilValue) {
+        R_xlen_t len = LazyLength(sx);
+        PROTECT(full = Rf_allocVector(REALSXP, len));
+        LazyFill(R_altrep_data1(sx), 0, len, REAL(full));
+        R_set_altrep_data2(sx, full);
+        UNPROTECT(1);
+    }
+    return DATAPTR(full);
+}
+
+static const void * LazyDataptrOrNull(SEXP sx) {
+    SEXP full = R_altrep_data2(sx);
+    return full == R_NilValue ? NULL : DATAPTR(full);
+}
+
+static double LazyElt(SEXP sx, R_xlen_t i) {
+    double y;
+    SEXP full = R_altrep_data2(sx);
+    if (full != R_NilValue) return REAL(full)[i];
+    LazyFill(R_altrep_data1(sx), i, 1, &y);
+    return y;
+}
+
+static R_xlen_t LazyGetRegion(SEXP sx, R_xlen_t i, R_xlen_t n, double * buf) {
+    R_xlen_t len = LazyLength(sx);
+    SEXP full = R_altrep_data2(sx);
+    if (n > len - i) n = len - i;
+    if (n <= 0) return 0;
+    if (full != R_NilValue) memcpy(buf, REAL(full) + i, n * sizeof(double));
+    else LazyFill(R_altrep_data1(sx), i, n, buf);
+    return n;
+}
+
+static int LazyNoNA(SEXP) {
+    return 1;                           // Probabilities are never NA
+}
+
+static SEXP LazyDuplicate(SEXP sx, Rboolean) {
+    // A copy can share the table as long as the full result is not made
+    if (R_altrep_data2(sx) != R_NilValue) return NULL; // Use default method
+    return R_new_altrep(LazyResultClass, R_altrep_data1(sx), R_NilValue);
+}
+
+static Rboolean LazyInspect(SEXP sx, int, int, int, void (*)(SEXP, int, int, int)) {
+    SEXP data1 = R_altrep_data1(sx);
+    const SProbTable * t = (const SProbTable *)RAW(VECTOR_ELT(data1, 2));
+    Rprintf(" BiasedUrn lazy %s%s, table length %.0f%s\n", t->fisher ? "FNC" : "WNC",
+        t->cumulative ? " cdf" : " pmf", (double)XLENGTH(VECTOR_ELT(data1, 1)),
+        R_altrep_data2(sx) == R_NilValue ? "" : ", expanded");
+    return TRUE;
+}
+#endif
+
+void InitLazyResults(DllInfo * dll) {
+    // Register ALTREP class. Called from R_init_BiasedUrn
+#ifdef LAZY_RESULTS
+    LazyResultClass = R_make_altreal_class("lazy_nchypergeo", "BiasedUrn", dll);
+    R_set_altrep_Length_method(LazyResultClass, LazyLength);
+    R_set_altrep_Inspect_method(LazyResultClass, LazyInspect);
+    R_set_altrep_Duplicate_method(LazyResultClass, LazyDuplicate);
+    R_set_altvec_Dataptr_method(LazyResultClass, LazyDataptr);
+    R_set_altvec_Dataptr_or_null_method(LazyResultClass, LazyDataptrOrNull);
+    R_set_altreal_Elt_method(LazyResultClass, LazyElt);
+    R_set_altreal_Get_region_method(LazyResultClass, LazyGetRegion);
+    R_set_altreal_No_NA_method(LazyResultClass, LazyNoNA);
+#endif
+}
+
+static bool LazyResult(R_xlen_t nres) {
+    // Check if the result should be returned as a lazy vector
+#ifdef LAZY_RESULTS
+    return nres >= LAZY_MIN_LENGTH;
+#else
+    return false;
+#endif
+}
+
+static SEXP MakeLazyResult(SEXP rx, SEXP rtable, const SProbTable & t) {
+    // Make lazy result vector from x vector, table, and parameters.
+    // Only called if LazyResult() returns true
+#ifdef LAZY_RESULTS
+    SEXP data1, info, result;
+    PROTECT(info = Rf_allocVector(RAWSXP, sizeof(SProbTable)));
+    memcpy(RAW(info), &t, sizeof(SProbTable));
+    PROTECT(data1 = Rf_allocVector(VECSXP, 4)); // Calculator in element 3 is made when needed
+    MARK_NOT_MUTABLE(rx);               // x must not be modified while referenced
+    SET_VECTOR_ELT(data1, 0, rx);
+    SET_VECTOR_ELT(data1, 1, rtable);
+    SET_VECTOR_ELT(data1, 2, info);
+    result = R_new_altrep(LazyResultClass, data1, R_NilValue);
+    UNPROTECT(2);
+    return result;
+#else
+    return R_NilValue;
+#endif
+}
 
 
 /******************************************************************************
@@ -23,55 +998,58 @@
 ******************************************************************************/
 REXPORTS SEXP dFNCHypergeo(
     SEXP rx,         // Number of red balls drawn, scalar or vector
-    SEXP rm1,        // Number of red balls in urn
-    SEXP rm2,        // Number of white balls in urn
-    SEXP rn,         // Number of balls drawn from urn
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
     SEXP rodds,      // Odds of getting a red ball among one red and one white
-    SEXP rprecision  // Precision of calculation
+    SEXP rprecision, // Precision of calculation
+    SEXP rthreads    // Number of threads used when parameters are vectors
     // ,SEXP rlog    // Will return log(p) if TRUE
 ) {
     // Check for vectors
-    if (LENGTH(rx) < 0
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
-        // || LENGTH(rlog)       >  1
+    if (XLENGTH(rx) < 0
+        || XLENGTH(rthreads) != 1
+        // || XLENGTH(rlog)       >  1
         ) {
         FatalError("Parameter has wrong length");
     }
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        // Recycle vector parameters
+        return RecycledNCHypergeo(1, 0, rx, rm1, rm2, rn, rodds, rprecision, 1, *INTEGER(rthreads));
+    }
     // Get parameter values
-    int     *px = INTEGER(rx);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
     //int   ilog = *LOGICAL(rlog);
-    int     nres = LENGTH(rx);          // Number of probability values to return
-    int     N = m1 + m2;                // Total number of balls
+    R_xlen_t nres = XLENGTH(rx);        // Number of probability values to return
+    int64   N = m1 + m2;                // Total number of balls
     double* buffer = 0;                 // Table of probabilities
+    SEXP    rtable;                     // R vector containing table
     int     BufferLength;               // Length of table
     double  factor;                     // Scale factor
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    int     xmin, xmax;                 // Absolute limits for x
-    int     i;                          // Loop counter
+    int64   x1, x2;                     // Table limits
+    int64   xmin, xmax;                 // Absolute limits for x
+    R_xlen_t i;                         // Loop counter
     bool    useTable = false;           // unused
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
-    // Allocate result vector
+    // Result vector
     SEXP result;  double * presult;
-    PROTECT(result = Rf_allocVector(REALSXP, nres));
-    presult = REAL(result);
 
     // Make object for calculating probabilities
     CFishersNCHypergeometric fnc(n, m1, N, odds, prec);
@@ -79,39 +1057,39 @@ REXPORTS SEXP dFNCHypergeo(
     // Check if it is advantageous to use MakeTable:
     if (nres > 1 &&
         (BufferLength = (int)fnc.MakeTable(buffer, 0, &x1, &x2, &useTable),
-            (uint32)nres > (uint32)BufferLength / 32)) {
+            nres > BufferLength / 32)) {
         // Use MakeTable
         xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
         xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
 
         // Allocate buffer
         if (BufferLength <= 0) BufferLength = 1;
-        buffer = (double*)R_alloc(BufferLength, sizeof(double));
+        PROTECT(rtable = Rf_allocVector(REALSXP, BufferLength));
+        buffer = REAL(rtable);
 
         // Make table of probabilities
         factor = 1. / fnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
-        // Get probabilities from table
-        for (i = 0; i < nres; i++) {
-            x = px[i];
-            if (x >= x1 && x <= x2) {
-                // x within table
-                presult[i] = buffer[x - x1] * factor;     // Get result from table
-            }
-            else if (x >= xmin && x <= xmax) {
-                // Outside table. Result is very small but not 0
-                presult[i] = fnc.probability(x);          // Calculate result
-            }
-            else {
-                // Impossible value of x
-                presult[i] = 0.;                          // Result is 0
-            }
-            // if (ilog) presult[i] = log(presult[i]);   // Log desired
+
+        SProbTable t = {1, 0, 1, m1, N, n, odds, prec, x1, x2, xmin, xmax, 0, factor};
+        if (LazyResult(nres)) {
+            // Return lazy result vector that refers to the table
+            result = MakeLazyResult(rx, rtable, t);
+            UNPROTECT(1);
+            return result;
         }
+        // Get probabilities from table
+        PROTECT(result = Rf_allocVector(REALSXP, nres));
+        TableValues(&t, buffer, fnc, rx, 0, nres, REAL(result));
+        UNPROTECT(2);
+        return(result);
     }
     else {
         // Calculate probabilities one by one
+        PROTECT(result = Rf_allocVector(REALSXP, nres));
+        presult = REAL(result);
+        CCountInput px(rx);
         for (i = 0; i < nres; i++) {
-            presult[i] = fnc.probability(px[i]);         // Probability
+            presult[i] = fnc.probability(px[i]); // Probability
             //if (ilog) presult[i] = log(presult[i]);    // Log desired
         }
     }
@@ -127,54 +1105,57 @@ REXPORTS SEXP dFNCHypergeo(
 ******************************************************************************/
 REXPORTS SEXP dWNCHypergeo(
     SEXP rx,         // Number of red balls drawn, scalar or vector
-    SEXP rm1,        // Number of red balls in urn
-    SEXP rm2,        // Number of white balls in urn
-    SEXP rn,         // Number of balls drawn from urn
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
     SEXP rodds,      // Odds of getting a red ball among one red and one white
-    SEXP rprecision  // Precision of calculation
+    SEXP rprecision, // Precision of calculation
+    SEXP rthreads    // Number of threads used when parameters are vectors
     // ,SEXP rlog    // Will return log(p) if TRUE
 ) {
     // Check for vectors
-    if (LENGTH(rx) < 0
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
-        // || LENGTH(rlog)       >  1
+    if (XLENGTH(rx) < 0
+        || XLENGTH(rthreads) != 1
+        // || XLENGTH(rlog)       >  1
         ) {
         FatalError("Parameter has wrong length");
     }
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        // Recycle vector parameters
+        return RecycledNCHypergeo(0, 0, rx, rm1, rm2, rn, rodds, rprecision, 1, *INTEGER(rthreads));
+    }
     // Get parameter values
-    int   * px = INTEGER(rx);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
     //int   ilog = *LOGICAL(rlog);
-    int     nres = LENGTH(rx);          // Number of probability values to return
-    int     N = m1 + m2;             // Total number of balls
+    R_xlen_t nres = XLENGTH(rx);        // Number of probability values to return
+    int64   N = m1 + m2;                // Total number of balls
     double* buffer = 0;                 // Table of probabilities
+    SEXP    rtable;                     // R vector containing table
     int     BufferLength;               // Length of table
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    int     xmin, xmax;                 // Absolute limits for x
-    int     i;                          // Loop counter
+    int64   x1, x2;                     // Table limits
+    int64   xmin, xmax;                 // Absolute limits for x
+    R_xlen_t i;                         // Loop counter
     bool    useTable = false;           // use table made by MakeTable
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
-    // Allocate result vector
+    // Result vector
     SEXP result;  double * presult;
-    PROTECT(result = Rf_allocVector(REALSXP, nres));
-    presult = REAL(result);
 
     // Make object for calculating probabilities
     CWalleniusNCHypergeometric wnc(n, m1, N, odds, prec);
@@ -189,29 +1170,29 @@ REXPORTS SEXP dWNCHypergeo(
 
         // Allocate buffer
         if (BufferLength <= 0) BufferLength = 1;
-        buffer = (double*)R_alloc(BufferLength, sizeof(double));
+        PROTECT(rtable = Rf_allocVector(REALSXP, BufferLength));
+        buffer = REAL(rtable);
         // Make table of probabilities
         wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
-        // Get probabilities from table
-        for (i = 0; i < nres; i++) {
-            x = px[i];
-            if (x >= x1 && x <= x2) {
-                // x within table
-                presult[i] = buffer[x - x1];              // Get result from table
-            }
-            else if (x >= xmin && x <= xmax) {
-                // Outside table. Result is very small but not 0
-                presult[i] = wnc.probability(x);          // Calculate result
-            }
-            else {
-                // Impossible value of x
-                presult[i] = 0.;                          // Result is 0
-            }
-            // if (ilog) presult[i] = log(presult[i]);   // Log desired
+
+        SProbTable t = {0, 0, 1, m1, N, n, odds, prec, x1, x2, xmin, xmax, 0, 1.};
+        if (LazyResult(nres)) {
+            // Return lazy result vector that refers to the table
+            result = MakeLazyResult(rx, rtable, t);
+            UNPROTECT(1);
+            return result;
         }
+        // Get probabilities from table
+        PROTECT(result = Rf_allocVector(REALSXP, nres));
+        TableValues(&t, buffer, wnc, rx, 0, nres, REAL(result));
+        UNPROTECT(2);
+        return(result);
     }
     else {
         // Calculate probabilities one by one
+        PROTECT(result = Rf_allocVector(REALSXP, nres));
+        presult = REAL(result);
+        CCountInput px(rx);
         for (i = 0; i < nres; i++) {
             presult[i] = wnc.probability(px[i]);
             //if (ilog) presult[i] = log(presult[i]);
@@ -224,125 +1205,204 @@ REXPORTS SEXP dWNCHypergeo(
 
 
 /******************************************************************************
-      pFNCHypergeo
-      Cumulative distribution function for
-      Fisher's NonCentral Hypergeometric distribution
+      dWNCHypergeoTimed
+      Mass function for Wallenius' NonCentral Hypergeometric distribution
+      with a time limit
 ******************************************************************************/
-REXPORTS SEXP pFNCHypergeo(
+// All x values first get a normal approximation based on the approximate
+// mean and variance. The values are then replaced by exact values, from a
+// table or one by one, as long as there is time left. The result is a 
+// matrix with the probabilities in the first column and an estimate of the 
+// absolute error in the second column.
+
+REXPORTS SEXP dWNCHypergeoTimed(
     SEXP rx,         // Number of red balls drawn, scalar or vector
     SEXP rm1,        // Number of red balls in urn
     SEXP rm2,        // Number of white balls in urn
     SEXP rn,         // Number of balls drawn from urn
     SEXP rodds,      // Odds of getting a red ball among one red and one white
     SEXP rprecision, // Precision of calculation
-    SEXP rlower_tail // TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rtime       // Time limit in seconds
 ) {
     // Check for vectors
-    if (LENGTH(rx) < 0
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
-        || LENGTH(rlower_tail) != 1
+    if (XLENGTH(rx) < 0
+        || XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        || XLENGTH(rtime) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
-    int   * px = INTEGER(rx);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     lower_tail = *LOGICAL(rlower_tail);
-    int     nres = LENGTH(rx);          // Number of probability values to return
-    int     N = m1 + m2;             // Total number of balls
+    double  time = *REAL(rtime);
+    R_xlen_t nres = XLENGTH(rx);        // Number of probability values to return
+    int64   N = m1 + m2;                // Total number of balls
     double* buffer = 0;                 // Table of probabilities
+    SEXP    rtable;                     // R vector containing table
     int     BufferLength;               // Length of table
-    double  factor;                     // Scale factor
-    double  sum;                        // Used for summation
-    double  p;                          // Probability
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    int     xmin, xmax;                 // Absolute limits for x
-    int     xmean;                      // Approximate mean of x
-    int     i;                          // Loop counter
-    bool    useTable = false;           // unused
+    int64   x, x1, x2;                  // x value and table limits
+    int64   xmin, xmax;                 // Absolute limits for x
+    double  mean, var;                  // Approximate mean and variance
+    double  d, e;                       // Normal approximation and its error
+    R_xlen_t i;                         // Loop counter
+    bool    useTable = false;           // use table made by MakeTable
+    static const double rsqrt2pi = 0.3989422804014326857; // 1/sqrt(2*pi)
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+    if (ISNAN(time)) time = 0.;
 
-    // min and max
     xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
     xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
 
-    // Allocate result vector
-    SEXP result;  double * presult;
-    PROTECT(result = Rf_allocVector(REALSXP, nres));
-    presult = REAL(result);
+    // Allocate result matrix
+    SEXP result;  double * presult, * perror;
+    PROTECT(result = Rf_allocMatrix(REALSXP, nres, 2));
+    presult = REAL(result);  perror = presult + nres;
 
     // Make object for calculating probabilities
-    CFishersNCHypergeometric fnc(n, m1, N, odds, prec);
-
-    // Get necessary buffer length
-    BufferLength = (int)fnc.MakeTable(buffer, 0, &x1, &x2, &useTable, prec * 0.001);
-    if (BufferLength <= 0) BufferLength = 1;
-
-    // Allocate buffer
-    buffer = (double*)R_alloc(BufferLength, sizeof(double));
+    CWalleniusNCHypergeometric wnc(n, m1, N, odds, prec);
+    CCountInput px(rx);
+
+    int status = RunWithDeadline(time, [&]() {
+        // Normal approximation. The approximate mean and variance make the error
+        // of the order 1/sqrt(var) relative to the peak value. Degenerate cases
+        // are exact.
+        mean = wnc.mean();  var = wnc.variance();
+        e = xmin == xmax ? 0. : var < 1. ? 1. : rsqrt2pi / var;
+        for (i = 0; i < nres; i++) {
+            x = px[i];
+            if (x < xmin || x > xmax) {
+                presult[i] = perror[i] = 0.;
+            }
+            else if (xmin == xmax) {
+                presult[i] = 1.;  perror[i] = 0.;
+            }
+            else {
+                d = (x - mean) * (x - mean) / var;
+                presult[i] = d > 1400. ? 0. : rsqrt2pi / sqrt(var) * exp(-0.5 * d);
+                perror[i] = e;
+            }
+        }
 
-    // Make table of probabilities
-    factor = 1. / fnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+        // Exact calculation as long as there is time left
+        if (xmin < xmax && !DeadlinePassed(true)) {
+            if (nres > 1 &&
+                (BufferLength = wnc.MakeTable(buffer, 0, &x1, &x2, &useTable),
+                    useTable)) {
+                // Make table of probabilities and get all values from the table
+                if (BufferLength <= 0) BufferLength = 1;
+                PROTECT(rtable = Rf_allocVector(REALSXP, BufferLength));
+                buffer = REAL(rtable);
+                wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+                SProbTable t = {0, 0, 1, m1, N, n, odds, prec, x1, x2, xmin, xmax, 0, 1.};
+                TableValues(&t, buffer, wnc, rx, 0, nres, presult);
+                for (i = 0; i < nres; i++) perror[i] = presult[i] * prec;
+                UNPROTECT(1);
+            }
+            else {
+                // Calculate probabilities one by one until time runs out
+                for (i = 0; i < nres; i++) {
+                    if (DeadlinePassed(true)) break;
+                    x = px[i];
+                    if (x < xmin || x > xmax) continue;
+                    presult[i] = wnc.probability(x);
+                    perror[i] = presult[i] * prec;
+                }
+            }
+        }
+    });
+    if (status == DEADLINE_INTERRUPT) FatalError("Calculation interrupted by user");
 
-    // Get mean
-    xmean = (int)(fnc.mean() + 0.5);           // Round mean
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
 
-    // Check for consistency
-    if (xmean < x1) xmean = x1;
-    if (xmean > x2) xmean = x2;
 
-    // Make left tail of table cumulative:
-    for (x = x1, sum = 0; x <= xmean; x++) sum = buffer[x - x1] += sum;
+/******************************************************************************
+      pFNCHypergeo
+      Cumulative distribution function for
+      Fisher's NonCentral Hypergeometric distribution
+******************************************************************************/
+REXPORTS SEXP pFNCHypergeo(
+    SEXP rx,         // Number of red balls drawn, scalar or vector
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision, // Precision of calculation
+    SEXP rlower_tail,// TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rthreads    // Number of threads used when parameters are vectors
+) {
+    // Check for vectors
+    if (XLENGTH(rx) < 0
+        || XLENGTH(rlower_tail) != 1
+        || XLENGTH(rthreads) != 1
+        ) {
+        FatalError("Parameter has wrong length");
+    }
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        // Recycle vector parameters
+        return RecycledNCHypergeo(1, 1, rx, rm1, rm2, rn, rodds, rprecision, *LOGICAL(rlower_tail), *INTEGER(rthreads));
+    }
+    // Get parameter values
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
+    double  odds = *REAL(rodds);
+    double  prec = *REAL(rprecision);
+    int     lower_tail = *LOGICAL(rlower_tail);
+    R_xlen_t nres = XLENGTH(rx);        // Number of probability values to return
+    int64   N = m1 + m2;                // Total number of balls
+    SEXP    rtable;                     // R vector containing table
+    SProbTable t;                       // Parameters and limits of table
 
-    // Probabilities for x > xmean are calculated by summation from the
-    // right in order to avoid loss of precision.
-    // Make right tail of table cumulative from the right:
-    for (x = x2, sum = 0; x > xmean; x--) sum = buffer[x - x1] += sum;
+    // Check validity of parameters
+    if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
+    if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
+    if (N > MAXURN) FatalError("Overflow");
+    if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
+    if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
-    // Loop through x vector
-    for (i = 0; i < nres; i++) {
-        x = px[i];                       // Input x value
-        if (x <= xmean) {
-            // Left tail
-            if (x < x1) {
-                p = 0.;                    // Outside table
-            }
-            else {
-                p = buffer[x - x1] * factor; // Probability from table
-            }
-            if (!lower_tail) p = 1. - p;  // Invert if right tail
-            presult[i] = p;               // Store result
-        }
-        else {
-            // Right tail
-            if (x >= x2) {
-                p = 0.;                    // Outside table
-            }
-            else {
-                p = buffer[x - x1 + 1] * factor; // Probability from table
-            }
-            if (lower_tail) p = 1. - p;   // Invert if left tail
-            presult[i] = p;               // Store result
-        }
+    // Result vector
+    SEXP result;
+
+    // Get normalized cumulative table from cache, or make it
+    PROTECT(rtable = CumulativeTable(1, m1, N, n, odds, prec, &t));
+    t.lower_tail = lower_tail;
+
+    if (LazyResult(nres)) {
+        // Return lazy result vector that refers to the table
+        result = MakeLazyResult(rx, rtable, t);
+        UNPROTECT(1);
+        return result;
     }
+    // Get cumulative probabilities from table
+    PROTECT(result = Rf_allocVector(REALSXP, nres));
+    CFishersNCHypergeometric fnc(n, m1, N, odds, prec);  // Not used by cumulative table
+    TableValues(&t, REAL(rtable), fnc, rx, 0, nres, REAL(result));
+
     // Return result
-    UNPROTECT(1);
+    UNPROTECT(2);
     return(result);
 }
 
@@ -354,129 +1414,70 @@ REXPORTS SEXP pFNCHypergeo(
 ******************************************************************************/
 REXPORTS SEXP pWNCHypergeo(
     SEXP rx,         // Number of red balls drawn, scalar or vector
-    SEXP rm1,        // Number of red balls in urn
-    SEXP rm2,        // Number of white balls in urn
-    SEXP rn,         // Number of balls drawn from urn
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
     SEXP rodds,      // Odds of getting a red ball among one red and one white
     SEXP rprecision, // Precision of calculation
-    SEXP rlower_tail // TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rlower_tail,// TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rthreads    // Number of threads used when parameters are vectors
 ) {
     // Check for vectors
-    if (LENGTH(rx) < 0
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
-        || LENGTH(rlower_tail) != 1
+    if (XLENGTH(rx) < 0
+        || XLENGTH(rlower_tail) != 1
+        || XLENGTH(rthreads) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        // Recycle vector parameters
+        return RecycledNCHypergeo(0, 1, rx, rm1, rm2, rn, rodds, rprecision, *LOGICAL(rlower_tail), *INTEGER(rthreads));
+    }
     // Get parameter values
-    int   * px = INTEGER(rx);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
     int     lower_tail = *LOGICAL(rlower_tail);
-    int     nres = LENGTH(rx);          // Number of probability values to return
-    int     N = m1 + m2;             // Total number of balls
-    double* buffer = 0;                 // Table of probabilities
-    int     BufferLength;               // Length of table
-    double  sum;                        // Used for summation
-    double  p;                          // Probability
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    int     xmin, xmax;                 // Absolute limits for x
-    int     xmean;                      // Approximate mean of x
-    int     i;                          // Loop counter
-    bool    useTable = false;           // unused
+    R_xlen_t nres = XLENGTH(rx);        // Number of probability values to return
+    int64   N = m1 + m2;                // Total number of balls
+    SEXP    rtable;                     // R vector containing table
+    SProbTable t;                       // Parameters and limits of table
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
-    // min and max
-    xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
-    xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
-
-    // Allocate result vector
-    SEXP result;  double * presult;
-    PROTECT(result = Rf_allocVector(REALSXP, nres));
-    presult = REAL(result);
-
-    // Make object for calculating probabilities
-    CWalleniusNCHypergeometric wnc(n, m1, N, odds, prec);
-
-    // Get necessary buffer length
-    BufferLength = wnc.MakeTable(buffer, 0, &x1, &x2, &useTable, prec * 0.001);
-    if (BufferLength <= 0) BufferLength = 1;
-
-    // Allocate buffer
-    buffer = (double*)R_alloc(BufferLength, sizeof(double));
-
-    // Make table of probabilities
-    wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+    // Result vector
+    SEXP result;
 
-    // Get mean
-    xmean = (int)(wnc.mean() + 0.5);           // Round mean
+    // Get normalized cumulative table from cache, or make it
+    PROTECT(rtable = CumulativeTable(0, m1, N, n, odds, prec, &t));
+    t.lower_tail = lower_tail;
 
-    // Check for consistency
-    if (xmean < x1 || xmean > x2) {
-        // Rf_error("Inconsistency. mean = %i, lower limit = %i, upper limit = %i", xmean, x1, x2);
-        // Error message removed 2022-10-18 because two users have complained.
-        // Example: pWNCHypergeo(x = 643, m1 = 643, m2 = 17000, n = 17610, odds=1)
-        if (xmean < x1) xmean = x1;
-        if (xmean > x2) xmean = x2;
+    if (LazyResult(nres)) {
+        // Return lazy result vector that refers to the table
+        result = MakeLazyResult(rx, rtable, t);
+        UNPROTECT(1);
+        return result;
     }
+    // Get cumulative probabilities from table
+    PROTECT(result = Rf_allocVector(REALSXP, nres));
+    CWalleniusNCHypergeometric wnc(n, m1, N, odds, prec);  // Not used by cumulative table
+    TableValues(&t, REAL(rtable), wnc, rx, 0, nres, REAL(result));
 
-    if (x2 >= x1 + BufferLength) x2 = x1 + BufferLength - 1; // not needed?
-
-    /*if (xmean - x1 >= BufferLength || x2 - x1 >= BufferLength) {
-       //Rf_error("Inconsistency. mean = %i, lower limit = %i, upper limit = %i, BufferLength=%i", xmean, x1, x2, BufferLength);
-    }*/
-
-    // Make left tail of table cumulative:
-    for (x = x1, sum = 0; x <= xmean; x++) sum = buffer[x - x1] += sum;
-
-    // Probabilities for x > xmean are calculated by summation from the
-    // right in order to avoid loss of precision.
-    // Make right tail of table cumulative from the right:
-    for (x = x2, sum = 0; x > xmean; x--) sum = buffer[x - x1] += sum;
-
-    // Loop through x vector
-    for (i = 0; i < nres; i++) {
-        x = px[i];                       // Input x value
-        if (x <= xmean) {
-            // Left tail
-            if (x < x1) {
-                p = 0.;                    // Outside table
-            }
-            else {
-                p = buffer[x - x1];          // Probability from table
-            }
-            if (!lower_tail) p = 1. - p;  // Invert if right tail
-            presult[i] = p;               // Store result
-        }
-        else {
-            // Right tail
-            if (x >= x2) {
-                p = 0.;                    // Outside table
-            }
-            else {
-                p = buffer[x - x1 + 1];        // Probability from table
-            }
-            if (lower_tail) p = 1. - p;   // Invert if left tail
-            presult[i] = p;               // Store result
-        }
-    }
     // Return result
-    UNPROTECT(1);
+    UNPROTECT(2);
     return(result);
 }
 
@@ -490,102 +1491,77 @@ REXPORTS SEXP pWNCHypergeo(
 ******************************************************************************/
 REXPORTS SEXP qFNCHypergeo(
     SEXP rp,         // Cumulative probability
-    SEXP rm1,        // Number of red balls in urn
-    SEXP rm2,        // Number of white balls in urn
-    SEXP rn,         // Number of balls drawn from urn
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
     SEXP rodds,      // Odds of getting a red ball among one red and one white
     SEXP rprecision, // Precision of calculation
-    SEXP rlower_tail // TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rlower_tail,// TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rthreads    // Number of threads used when parameters are vectors
 ) {
     // Check for vectors
-    if (LENGTH(rp) < 0
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
-        || LENGTH(rlower_tail) != 1
+    if (XLENGTH(rp) < 0
+        || XLENGTH(rlower_tail) != 1
+        || XLENGTH(rthreads) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        // Recycle vector parameters
+        return RecycledNCHypergeo(1, 2, rp, rm1, rm2, rn, rodds, rprecision, *LOGICAL(rlower_tail), *INTEGER(rthreads));
+    }
     // Get parameter values
     double* pp = REAL(rp);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
     int     lower_tail = *LOGICAL(rlower_tail);
-    int     nres = LENGTH(rp);          // Number of probability values to return
-    int     N = m1 + m2;             // Total number of balls
-    double* buffer = 0;                 // Table of probabilities
-    int     BufferLength;               // Length of table
-    double  factor;                     // Scale factor
-    double  sum;                        // Used for summation
+    R_xlen_t nres = XLENGTH(rp);        // Number of probability values to return
+    int64   N = m1 + m2;                // Total number of balls
+    SEXP    rtable;                     // R vector containing cumulative table
+    SEXP    rguide;                     // R vector containing guide table
+    SProbTable t;                       // Parameters and limits of table
     double  p;                          // Probability
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    int     i;                          // Loop counter
-    unsigned int a, b, c;               // Used in binary search
-    bool    useTable = false;           // unused
+    R_xlen_t i;                         // Loop counter
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
     // Allocate result vector
-    SEXP result;  int * presult;
-    PROTECT(result = Rf_allocVector(INTSXP, nres));
-    presult = INTEGER(result);
-
-    // Make object for calculating probabilities
-    CFishersNCHypergeometric fnc(n, m1, N, odds, prec);
-
-    // Get necessary buffer length
-    BufferLength = (int)fnc.MakeTable(buffer, 0, &x1, &x2, &useTable, prec * 0.001);
-    if (BufferLength <= 0) BufferLength = 1;
-
-    // Allocate buffer
-    buffer = (double*)R_alloc(BufferLength, sizeof(double));
+    SEXP result;
+    PROTECT(result = AllocCountVector(nres, n < m1 ? n : m1));
+    CCountVector presult(result);
 
-    // Make table of probabilities
-    factor = fnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
-
-    // Make table cumulative:
-    for (x = x1, sum = 0; x <= x2; x++) sum = buffer[x - x1] += sum;
+    // Get normalized cumulative table and guide table from cache, or make them
+    PROTECT(rtable = CumulativeTable(1, m1, N, n, odds, prec, &t));
+    PROTECT(rguide = GuideTable(rtable, &t));
+    const double * table = REAL(rtable);
+    const int * guide = INTEGER(rguide);
 
     // Loop through p vector
     for (i = 0; i < nres; i++) {
         p = pp[i];                       // Input p value
         if (!R_FINITE(p) || p < 0. || p > 1.) {
-            presult[i] = NA_INTEGER;      // Invalid input. Return NA
+            presult.set(i, -1);           // Invalid input. Return NA
         }
         else {
-            if (!lower_tail) p = 1. - p;  // Invert if right tail
-            p *= factor;                  // Table is scaled by factor
-
-            // Binary search in table
-            a = 0; b = x2 - x1 + 1;
-            while (a < b) {
-                c = (a + b) / 2;
-                if (p <= buffer[c]) {
-                    b = c;
-                }
-                else {
-                    a = c + 1;
-                }
-            }
-            x = x1 + a;
-            if (x > x2) x = x2;           // Prevent values > xmax that occur because of small imprecisions
-            presult[i] = x;
+            presult.set(i, GuideQuantile(&t, table, guide, p, lower_tail));
         }
     }
     // Return result
-    UNPROTECT(1);
+    UNPROTECT(3);
     return(result);
 }
 
@@ -599,100 +1575,77 @@ REXPORTS SEXP qFNCHypergeo(
 ******************************************************************************/
 REXPORTS SEXP qWNCHypergeo(
     SEXP rp,         // Cumulative probability
-    SEXP rm1,        // Number of red balls in urn
-    SEXP rm2,        // Number of white balls in urn
-    SEXP rn,         // Number of balls drawn from urn
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
     SEXP rodds,      // Odds of getting a red ball among one red and one white
     SEXP rprecision, // Precision of calculation
-    SEXP rlower_tail // TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rlower_tail,// TRUE: P(X <= x), FALSE: P(X > x)
+    SEXP rthreads    // Number of threads used when parameters are vectors
 ) {
     // Check for vectors
-    if (LENGTH(rp) < 0
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
-        || LENGTH(rlower_tail) != 1
+    if (XLENGTH(rp) < 0
+        || XLENGTH(rlower_tail) != 1
+        || XLENGTH(rthreads) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        // Recycle vector parameters
+        return RecycledNCHypergeo(0, 2, rp, rm1, rm2, rn, rodds, rprecision, *LOGICAL(rlower_tail), *INTEGER(rthreads));
+    }
     // Get parameter values
     double* pp = REAL(rp);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
     int     lower_tail = *LOGICAL(rlower_tail);
-    int     nres = LENGTH(rp);          // Number of probability values to return
-    int     N = m1 + m2;             // Total number of balls
-    double* buffer = 0;                 // Table of probabilities
-    int     BufferLength;               // Length of table
-    double  sum;                        // Used for summation
+    R_xlen_t nres = XLENGTH(rp);        // Number of probability values to return
+    int64   N = m1 + m2;                // Total number of balls
+    SEXP    rtable;                     // R vector containing cumulative table
+    SEXP    rguide;                     // R vector containing guide table
+    SProbTable t;                       // Parameters and limits of table
     double  p;                          // Probability
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    int     i;                          // Loop counter
-    unsigned int a, b, c;               // Used in binary search
-    bool    useTable = false;           // unused
+    R_xlen_t i;                         // Loop counter
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
     // Allocate result vector
-    SEXP result;  int * presult;
-    PROTECT(result = Rf_allocVector(INTSXP, nres));
-    presult = INTEGER(result);
-
-    // Make object for calculating probabilities
-    CWalleniusNCHypergeometric wnc(n, m1, N, odds, prec);
+    SEXP result;
+    PROTECT(result = AllocCountVector(nres, n < m1 ? n : m1));
+    CCountVector presult(result);
 
-    // Get necessary buffer length
-    BufferLength = wnc.MakeTable(buffer, 0, &x1, &x2, &useTable, prec * 0.001);
-    if (BufferLength <= 0) BufferLength = 1;
-
-    // Allocate buffer
-    buffer = (double*)R_alloc(BufferLength, sizeof(double));
-
-    // Make table of probabilities
-    wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
-
-    // Make table cumulative:
-    for (x = x1, sum = 0; x <= x2; x++) sum = buffer[x - x1] += sum;
+    // Get normalized cumulative table and guide table from cache, or make them
+    PROTECT(rtable = CumulativeTable(0, m1, N, n, odds, prec, &t));
+    PROTECT(rguide = GuideTable(rtable, &t));
+    const double * table = REAL(rtable);
+    const int * guide = INTEGER(rguide);
 
     // Loop through p vector
     for (i = 0; i < nres; i++) {
         p = pp[i];                       // Input p value
         if (!R_FINITE(p) || p < 0. || p > 1.) {
-            presult[i] = NA_INTEGER;      // Invalid input. Return NA
+            presult.set(i, -1);           // Invalid input. Return NA
         }
         else {
-            if (!lower_tail) p = 1. - p;  // Invert if right tail
-
-            // Binary search in table
-            a = 0; b = x2 - x1 + 1;
-            while (a < b) {
-                c = (a + b) / 2;
-                if (p <= buffer[c]) {
-                    b = c;
-                }
-                else {
-                    a = c + 1;
-                }
-            }
-            x = x1 + a;
-            if (x > x2) x = x2;           // Prevent values > xmax that occur because of small imprecisions
-            presult[i] = x;
+            presult.set(i, GuideQuantile(&t, table, guide, p, lower_tail));
         }
     }
     // Return result
-    UNPROTECT(1);
+    UNPROTECT(3);
     return(result);
 }
 
@@ -704,58 +1657,59 @@ REXPORTS SEXP qWNCHypergeo(
 ******************************************************************************/
 REXPORTS SEXP rFNCHypergeo(
     SEXP rnran,      // Number of random variates desired
-    SEXP rm1,        // Number of red balls in urn
-    SEXP rm2,        // Number of white balls in urn
-    SEXP rn,         // Number of balls drawn from urn
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
     SEXP rodds,      // Odds of getting a red ball among one red and one white
-    SEXP rprecision  // Precision of calculation
+    SEXP rprecision, // Precision of calculation
+    SEXP rseed,      // Seed for counter-based random number generator, or length 0
+    SEXP rthreads    // Number of threads used with counter-based generator
 ) {
     // Check for vectors
-    if (LENGTH(rnran) != 1
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
+    // Get parameter values
+    R_xlen_t nran = NumberOfVariates(rnran); // Number of random variates
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
         ) {
-        FatalError("Parameter has wrong length");
+        // Recycle vector parameters
+        return RecycledRandomNCHypergeo(1, nran, rm1, rm2, rn, rodds, rprecision, rseed, Rf_asInteger(rthreads));
     }
-    // Get parameter values
-    int     nran = *INTEGER(rnran);  if (LENGTH(rnran) > 1) nran = LENGTH(rnran);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     N = m1 + m2;             // Total number of balls
+    int64   N = m1 + m2;                // Total number of balls
     double* buffer = 0;                 // Table of probabilities
     int     BufferLength;               // Length of table
-    double  sum;                        // Used for summation
-    double  u;                          // Uniform random number
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    unsigned int a, b, c;               // Used in binary search
-    int     i;                          // Loop counter
+    double* aliasBuffer;                // Buffer for alias table
+    CAliasTable alias;                  // Alias table for sampling
+    int64   x1, x2;                     // Table limits
     bool    useTable = false;           // unused
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
     if (nran <= 0) FatalError("Parameter nran must be positive");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
     // Allocate result vector
-    SEXP result;  int * presult;
-    PROTECT(result = Rf_allocVector(INTSXP, nran));
-    presult = INTEGER(result);
+    SEXP result;
+    PROTECT(result = AllocCountVector(nran, n < m1 ? n : m1));
+    CCountVector presult(result);
 
     // Make object for generating variates
     StochasticLib3 sto(0);              // Seed is not used
     sto.SetAccuracy(prec);              // Set precision
-    sto.InitRan();                      // Initialize RNG in R.dll
+    sto.InitRan(rseed);                 // Initialize RNG
+    int nthreads = sto.VariateThreads(Rf_asInteger(rthreads), nran); // Number of threads
+    LnFac(2);                           // Initialize static table before starting threads
 
     if (nran > 4) {
         // Check necessary table length
@@ -772,39 +1726,22 @@ REXPORTS SEXP rFNCHypergeo(
             // Make table of probabilities
             fnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
 
-            // Make table cumulative:
-            for (x = x1, sum = 0; x <= x2; x++) sum = buffer[x - x1] += sum;
+            // Make alias table. The table does not have to be normalized
+            if (x2 >= x1 + BufferLength) x2 = x1 + BufferLength - 1;
+            aliasBuffer = (double*)R_alloc(CAliasTable::TableLength((int32)(x2 - x1 + 1)), sizeof(double));
+            alias.MakeTable(buffer, (int32)(x2 - x1 + 1), aliasBuffer);
 
             // Loop for each variate
-            for (i = 0; i < nran; i++) {
-
-                // Make uniform random
-                u = sto.Random() * sum;
-
-                // Binary search in table
-                a = 0;  b = x2 - x1 + 1;
-                while (a < b) {
-                    c = (a + b) / 2;
-                    if (u < buffer[c]) {
-                        b = c;
-                    }
-                    else {
-                        a = c + 1;
-                    }
-                }
-                x = x1 + a;
-                if (x > x2) x = x2;   // Prevent values > xmax that occur because of small imprecisions
-                presult[i] = x;
-            }
+            GenerateVariates(sto, prec, nran, nthreads, [&](StochasticLib3 & s, R_xlen_t i) {
+                presult.set(i, x1 + alias.random(s.Random()));});
             goto FINISHED_R;
         }
     }
 
     // Not using table.
     // Generate variates one by one
-    for (i = 0; i < nran; i++) {
-        presult[i] = sto.FishersNCHyp(n, m1, N, odds);
-    }
+    GenerateVariates(sto, prec, nran, nthreads, [&](StochasticLib3 & s, R_xlen_t i) {
+        presult.set(i, s.FishersNCHyp(n, m1, N, odds));});
 
 FINISHED_R:
     sto.EndRan();                       // Return RNG state to R.dll
@@ -822,58 +1759,59 @@ FINISHED_R:
 ******************************************************************************/
 REXPORTS SEXP rWNCHypergeo(
     SEXP rnran,      // Number of random variates desired
-    SEXP rm1,        // Number of red balls in urn
-    SEXP rm2,        // Number of white balls in urn
-    SEXP rn,         // Number of balls drawn from urn
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
     SEXP rodds,      // Odds of getting a red ball among one red and one white
-    SEXP rprecision  // Precision of calculation
+    SEXP rprecision, // Precision of calculation
+    SEXP rseed,      // Seed for counter-based random number generator, or length 0
+    SEXP rthreads    // Number of threads used with counter-based generator
 ) {
     // Check for vectors
-    if (LENGTH(rnran) != 1
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
+    // Get parameter values
+    R_xlen_t nran = NumberOfVariates(rnran); // Number of random variates
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
         ) {
-        FatalError("Parameter has wrong length");
+        // Recycle vector parameters
+        return RecycledRandomNCHypergeo(0, nran, rm1, rm2, rn, rodds, rprecision, rseed, Rf_asInteger(rthreads));
     }
-    // Get parameter values
-    int     nran = *INTEGER(rnran);  if (LENGTH(rnran) > 1) nran = LENGTH(rnran);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     N = m1 + m2;             // Total number of balls
+    int64   N = m1 + m2;                // Total number of balls
     double* buffer = 0;                 // Table of probabilities
     int     BufferLength;               // Length of table
-    double  sum;                        // Used for summation
-    double  u;                          // Uniform random number
-    int     x;                          // Temporary x
-    int32   x1, x2;                     // Table limits
-    unsigned int a, b, c;               // Used in binary search
-    int     i;                          // Loop counter
+    double* aliasBuffer;                // Buffer for alias table
+    CAliasTable alias;                  // Alias table for sampling
+    int64   x1, x2;                     // Table limits
     bool    useTable = false;           // unused
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
     if (nran <= 0) FatalError("Parameter nran must be positive");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
     // Allocate result vector
-    SEXP result;  int * presult;
-    PROTECT(result = Rf_allocVector(INTSXP, nran));
-    presult = INTEGER(result);
+    SEXP result;
+    PROTECT(result = AllocCountVector(nran, n < m1 ? n : m1));
+    CCountVector presult(result);
 
     // Make object for generating variates
     StochasticLib3 sto(0);              // Seed is not used
     sto.SetAccuracy(prec);              // Set precision
-    sto.InitRan();                      // Initialize RNG in R.dll
+    sto.InitRan(rseed);                 // Initialize RNG
+    int nthreads = sto.VariateThreads(Rf_asInteger(rthreads), nran); // Number of threads
+    LnFac(2);                           // Initialize static table before starting threads
 
     if (nran > 4) {
         // Check necessary table length
@@ -890,39 +1828,32 @@ REXPORTS SEXP rWNCHypergeo(
             // Make table of probabilities
             wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
 
-            // Make table cumulative:
-            for (x = x1, sum = 0; x <= x2; x++) sum = buffer[x - x1] += sum;
+            // Make alias table. The table does not have to be normalized
+            if (x2 >= x1 + BufferLength) x2 = x1 + BufferLength - 1;
+            aliasBuffer = (double*)R_alloc(CAliasTable::TableLength((int32)(x2 - x1 + 1)), sizeof(double));
+            alias.MakeTable(buffer, (int32)(x2 - x1 + 1), aliasBuffer);
 
             // Loop for each variate
-            for (i = 0; i < nran; i++) {
-
-                // Make uniform random
-                u = sto.Random() * sum;    // sum should be 1.0 but might be slightly less if tails are cut off in table
-
-                // Binary search in table
-                a = 0;  b = x2 - x1 + 1;
-                while (a < b) {
-                    c = (a + b) / 2;
-                    if (u < buffer[c]) {
-                        b = c;
-                    }
-                    else {
-                        a = c + 1;
-                    }
-                }
-                x = x1 + a;
-                if (x > x2) x = x2;   // Prevent values > xmax that occur because of small imprecisions
-                presult[i] = x;
-            }
+            GenerateVariates(sto, prec, nran, nthreads, [&](StochasticLib3 & s, R_xlen_t i) {
+                presult.set(i, x1 + alias.random(s.Random()));});
             goto FINISHED_R;
         }
     }
 
     // Not using table.
-    // Generate variates one by one
-    for (i = 0; i < nran; i++) {
-        presult[i] = sto.WalleniusNCHyp(n, m1, N, odds);
-    }
+    // Generate variates in batches of URN_LANES, so that urn simulations 
+    // are made in parallel lanes
+    GenerateVariates(sto, prec, nran, nthreads, [&](StochasticLib3 & s, R_xlen_t i) {
+        const int lanes = StochasticLib3::URN_LANES;
+        int64 bn[lanes], bm[lanes], bN[lanes], bx[lanes]; // Parameters and variates of batch
+        double bodds[lanes];
+        if (i % lanes) return;          // Made in previous batch
+        int nb = nran - i < lanes ? (int)(nran - i) : lanes; // Number of variates in batch
+        for (int l = 0; l < nb; l++) {
+            bn[l] = n;  bm[l] = m1;  bN[l] = N;  bodds[l] = odds;
+        }
+        s.WalleniusNCHypBatch(bx, nb, bn, bm, bN, bodds);
+        for (int l = 0; l < nb; l++) presult.set(i + l, bx[l]);});
 
 FINISHED_R:
     sto.EndRan();                       // Return RNG state to R.dll
@@ -956,27 +1887,27 @@ REXPORTS SEXP momentsFNCHypergeo(
     SEXP rmoment     // 1 = mean, 2 = variance
 ) {
     // Check for vectors
-    if (LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
     int     imoment = *INTEGER(rmoment);
-    int     N = m1 + m2;             // Total number of balls
+    int64   N = m1 + m2;                // Total number of balls
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (imoment != 1 && imoment != 2) FatalError("Only moments 1 and 2 supported");
@@ -1003,9 +1934,9 @@ REXPORTS SEXP momentsFNCHypergeo(
     else {
         // Exact calculation required
         // Values saved from last calculation:
-        static int    old_m1 = 0;
-        static int    old_m2 = 0;
-        static int    old_n = 0;
+        static int64  old_m1 = 0;
+        static int64  old_m2 = 0;
+        static int64  old_n = 0;
         static double old_odds = 0;
         static double old_prec = 0;
         static double old_mean = 0;
@@ -1057,27 +1988,27 @@ REXPORTS SEXP momentsWNCHypergeo(
     SEXP rmoment     // 1 = mean, 2 = variance
 ) {
     // Check for vectors
-    if (LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
     int     imoment = *INTEGER(rmoment);
-    int     N = m1 + m2;             // Total number of balls
+    int64   N = m1 + m2;                // Total number of balls
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (imoment != 1 && imoment != 2) FatalError("Only moments 1 and 2 supported");
@@ -1104,9 +2035,9 @@ REXPORTS SEXP momentsWNCHypergeo(
     else {
         // Exact calculation required
         // Values saved from last calculation:
-        static int    old_m1 = 0;
-        static int    old_m2 = 0;
-        static int    old_n = 0;
+        static int64  old_m1 = 0;
+        static int64  old_m2 = 0;
+        static int64  old_n = 0;
         static double old_odds = 0;
         static double old_prec = 0;
         static double old_mean = 0;
@@ -1153,34 +2084,34 @@ REXPORTS SEXP modeFNCHypergeo(
     SEXP rodds       // Odds of getting a red ball among one red and one white
 ) {
     // Check for vectors
-    if (LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
-    int     N = m1 + m2;             // Total number of balls
+    int64   N = m1 + m2;                // Total number of balls
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
 
     // Allocate result vector
-    SEXP result;  int * presult;
-    PROTECT(result = Rf_allocVector(INTSXP, 1));
-    presult = INTEGER(result);
+    SEXP result;
+    PROTECT(result = AllocCountVector(1, n < m1 ? n : m1));
+    CCountVector presult(result);
 
     // Calculate mode
-    *presult = CFishersNCHypergeometric(n, m1, N, odds).mode();
+    presult.set(0, CFishersNCHypergeometric(n, m1, N, odds).mode());
 
     // Return result
     UNPROTECT(1);
@@ -1201,41 +2132,225 @@ REXPORTS SEXP modeWNCHypergeo(
     SEXP rprecision  // Precision of calculation
 ) {
     // Check for vectors
-    if (LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        FatalError("Parameter has wrong length");
+    }
+    // Get parameter values
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
+    double  odds = *REAL(rodds);
+    double  prec = *REAL(rprecision);
+    int64   N = m1 + m2;                // Total number of balls
+
+    // Check validity of parameters
+    if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
+    if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
+    if (N > MAXURN) FatalError("Overflow");
+    if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
+    if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+
+    // Allocate result vector
+    SEXP result;
+    PROTECT(result = AllocCountVector(1, n < m1 ? n : m1));
+    CCountVector presult(result);
+
+    // Calculate mode
+    presult.set(0, CWalleniusNCHypergeometric(n, m1, N, odds, prec).mode());
+
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
+
+
+/******************************************************************************
+      summaryFNCHypergeo and summaryWNCHypergeo
+      Calculate probabilities, cumulative probabilities, mean, variance and
+      mode of Fisher's and Wallenius' NonCentral Hypergeometric distribution
+******************************************************************************/
+// One table of probabilities is made, and all the results are derived from 
+// this table. The table covers all x values with non-negligible probability.
+// The result is a list with the components x, pmf, cdf, mean, var, mode.
+
+static SEXP SummaryFromTable(
+    double * table,  // Table of probabilities, proportional
+    int64 x1,        // x value of first table entry
+    int64 x2,        // x value of last table entry
+    double factor    // Normalization factor for table values
+) {
+    // Make result list from table of probabilities
+    SEXP result, names, rx, rpmf, rcdf;
+    double * ppmf, * pcdf;
+    int len = (int)(x2 - x1 + 1);       // Table length
+    int i, im = 0;                      // Table index, index of mode
+    double s1 = 0., s2 = 0., d;         // Sums for mean and variance
+    double mean, var, sum;              // Mean, variance, cumulative sum
+    int64 xmean;                        // Rounded mean
+
+    PROTECT(result = Rf_allocVector(VECSXP, 6));
+    PROTECT(names = Rf_allocVector(STRSXP, 6));
+    rx = AllocCountVector(len, x2);      SET_VECTOR_ELT(result, 0, rx);
+    rpmf = Rf_allocVector(REALSXP, len); SET_VECTOR_ELT(result, 1, rpmf);
+    rcdf = Rf_allocVector(REALSXP, len); SET_VECTOR_ELT(result, 2, rcdf);
+    CCountVector px(rx);  ppmf = REAL(rpmf);  pcdf = REAL(rcdf);
+
+    // x values, probabilities and mode
+    for (i = 0; i < len; i++) {
+        px.set(i, x1 + i);
+        ppmf[i] = table[i] * factor;
+        if (ppmf[i] > ppmf[im]) im = i;
+    }
+    // Mean and variance. Subtract mode to avoid loss of precision
+    for (i = 0; i < len; i++) {
+        d = i - im;
+        s1 += d * ppmf[i];  s2 += d * d * ppmf[i];
+    }
+    mean = s1 + x1 + im;
+    var = s2 - s1 * s1;  if (var < 0.) var = 0.;
+
+    // Cumulative probabilities. Sum from the right above the mean
+    // in order to avoid loss of precision
+    xmean = (int64)(mean + 0.5) - x1;
+    for (sum = 0., i = 0; i < len && i <= xmean; i++) pcdf[i] = sum += ppmf[i];
+    for (sum = 0., i = len - 1; i > xmean; i--) {
+        pcdf[i] = 1. - sum;
+        sum += ppmf[i];
+    }
+
+    SET_VECTOR_ELT(result, 3, Rf_ScalarReal(mean));
+    SET_VECTOR_ELT(result, 4, Rf_ScalarReal(var));
+    SET_VECTOR_ELT(result, 5, x2 > INT_MAX ? Rf_ScalarReal((double)(x1 + im)) : Rf_ScalarInteger((int)(x1 + im)));
+    SET_STRING_ELT(names, 0, Rf_mkChar("x"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("pmf"));
+    SET_STRING_ELT(names, 2, Rf_mkChar("cdf"));
+    SET_STRING_ELT(names, 3, Rf_mkChar("mean"));
+    SET_STRING_ELT(names, 4, Rf_mkChar("var"));
+    SET_STRING_ELT(names, 5, Rf_mkChar("mode"));
+    Rf_setAttrib(result, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return result;
+}
+
+
+REXPORTS SEXP summaryFNCHypergeo(
+    SEXP rm1,        // Number of red balls in urn
+    SEXP rm2,        // Number of white balls in urn
+    SEXP rn,         // Number of balls drawn from urn
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision  // Precision of calculation
+) {
+    // Check for vectors
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        FatalError("Parameter has wrong length");
+    }
+    // Get parameter values
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
+    double  odds = *REAL(rodds);
+    double  prec = *REAL(rprecision);
+    int64   N = m1 + m2;                // Total number of balls
+    double* buffer = 0;                 // Table of probabilities
+    int     BufferLength;               // Length of table
+    double  factor;                     // Scale factor
+    int64   x1, x2;                     // Table limits
+    bool    useTable = false;           // unused
+
+    // Check validity of parameters
+    if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
+    if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
+    if (N > MAXURN) FatalError("Overflow");
+    if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
+    if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+
+    // Make object for calculating probabilities
+    CFishersNCHypergeometric fnc(n, m1, N, odds, prec);
+
+    // Get necessary buffer length
+    BufferLength = (int)fnc.MakeTable(buffer, 0, &x1, &x2, &useTable, prec * 0.001);
+    if (BufferLength <= 0) BufferLength = 1;
+
+    // Allocate buffer
+    buffer = (double*)R_alloc(BufferLength, sizeof(double));
+
+    // Make table of probabilities
+    factor = 1. / fnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+
+    // Derive all results from table
+    return SummaryFromTable(buffer, x1, x2, factor);
+}
+
+
+REXPORTS SEXP summaryWNCHypergeo(
+    SEXP rm1,        // Number of red balls in urn
+    SEXP rm2,        // Number of white balls in urn
+    SEXP rn,         // Number of balls drawn from urn
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision  // Precision of calculation
+) {
+    // Check for vectors
+    if (XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     N = m1 + m2;             // Total number of balls
+    int64   N = m1 + m2;                // Total number of balls
+    double* buffer = 0;                 // Table of probabilities
+    int     BufferLength;               // Length of table
+    double  sum;                        // Sum of table
+    int64   x1, x2;                     // Table limits
+    int     i;                          // Loop counter
+    bool    useTable = false;           // unused
 
     // Check validity of parameters
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (n > m2 && odds == 0) FatalError("Not enough items with nonzero weight");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
-    // Allocate result vector
-    SEXP result;  int * presult;
-    PROTECT(result = Rf_allocVector(INTSXP, 1));
-    presult = INTEGER(result);
+    // Make object for calculating probabilities
+    CWalleniusNCHypergeometric wnc(n, m1, N, odds, prec);
+
+    // Get necessary buffer length
+    BufferLength = wnc.MakeTable(buffer, 0, &x1, &x2, &useTable, prec * 0.001);
+    if (BufferLength <= 0) BufferLength = 1;
+
+    // Allocate buffer
+    buffer = (double*)R_alloc(BufferLength, sizeof(double));
 
-    // Calculate mode
-    *presult = CWalleniusNCHypergeometric(n, m1, N, odds, prec).mode();
+    // Make table of probabilities
+    wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+    if (x2 >= x1 + BufferLength) x2 = x1 + BufferLength - 1;
 
-    // Return result
-    UNPROTECT(1);
-    return(result);
+    // Table values are probabilities. Normalize to compensate for the cut off tails
+    for (sum = 0., i = 0; i <= x2 - x1; i++) sum += buffer[i];
+
+    // Derive all results from table
+    return SummaryFromTable(buffer, x1, x2, 1. / sum);
 }
 
 
@@ -1253,29 +2368,29 @@ REXPORTS SEXP oddsFNCHypergeo(
     SEXP rprecision  // Precision of calculation
 ) {
     // Check for vectors
-    if (LENGTH(rmu) < 1
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rprecision) != 1
+    if (XLENGTH(rmu) < 1
+        || XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rprecision) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
     double *pmu = REAL(rmu);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  prec = *REAL(rprecision);
-    int     nres = LENGTH(rmu);
-    int     N = m1 + m2;             // Total number of balls
-    int     i;                          // Loop counter
+    R_xlen_t nres = XLENGTH(rmu);
+    int64   N = m1 + m2;                // Total number of balls
+    R_xlen_t i;                         // Loop counter
     int     err = 0;                   // Remember any error
 
     // Check validity of parameters
     if (nres < 0) FatalError("mu has wrong length");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 0.1;
     if (prec < 0.05) Rf_warning("Cannot obtain high precision");
@@ -1286,8 +2401,8 @@ REXPORTS SEXP oddsFNCHypergeo(
     presult = REAL(result);
 
     // Get xmin and xmax
-    int xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
-    int xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
+    int64 xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
+    int64 xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
 
     // Loop for all mu inputs
     for (i = 0; i < nres; i++) {
@@ -1337,7 +2452,10 @@ REXPORTS SEXP oddsFNCHypergeo(
       Estimate odds ratio from mean for
       Wallenius' NonCentral Hypergeometric distribution.
 ******************************************************************************/
-// Uses Manly's approximation. precision is ignored.
+// Uses Manly's approximation when precision >= 0.1.
+// Uses the exact mean, calculated by enumeration of all non-negligible 
+// x values, when precision < 0.1. Manly's approximation is used as 
+// starting value for the iteration.
 REXPORTS SEXP oddsWNCHypergeo(
     SEXP rmu,        // Observed mean of x1
     SEXP rm1,        // Number of red balls in urn
@@ -1346,32 +2464,32 @@ REXPORTS SEXP oddsWNCHypergeo(
     SEXP rprecision  // Precision of calculation
 ) {
     // Check for vectors
-    if (LENGTH(rmu) < 1
-        || LENGTH(rm1) != 1
-        || LENGTH(rm2) != 1
-        || LENGTH(rn) != 1
-        || LENGTH(rprecision) != 1
+    if (XLENGTH(rmu) < 1
+        || XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rprecision) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
     double *pmu = REAL(rmu);
-    int     m1 = *INTEGER(rm1);
-    int     m2 = *INTEGER(rm2);
-    int     n = *INTEGER(rn);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
     double  prec = *REAL(rprecision);
-    int     nres = LENGTH(rmu);
-    int     N = m1 + m2;             // Total number of balls
-    int     i;                          // Loop counter
+    R_xlen_t nres = XLENGTH(rmu);
+    int64   N = m1 + m2;                // Total number of balls
+    R_xlen_t i;                         // Loop counter
     int     err = 0;                   // Remember any error
 
     // Check validity of parameters
     if (nres < 0) FatalError("mu has wrong length");
     if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 0.1;
-    if (prec < 0.02) Rf_warning("Cannot obtain high precision");
+    if (prec < 1E-12) prec = 1E-12;
 
     // Allocate result vector
     SEXP result;  double * presult;
@@ -1379,8 +2497,12 @@ REXPORTS SEXP oddsWNCHypergeo(
     presult = REAL(result);
 
     // Get xmin and xmax
-    int xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
-    int xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
+    int64 xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
+    int64 xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
+
+    // Make object for calculating exact mean. 
+    // The same object is reused for all mu values
+    CWalleniusNCHypergeometric wnc(n, m1, N, 1., prec);
 
     // Loop for all mu inputs
     for (i = 0; i < nres; i++) {
@@ -1408,8 +2530,13 @@ REXPORTS SEXP oddsWNCHypergeo(
             continue;
         }
 
-        // Calculate odds ratio
+        // Calculate odds ratio by Manly's approximation
         presult[i] = log(1. - mu / m1) / log(1. - (n - mu) / m2);
+
+        if (prec < 0.1) {
+            // Exact calculation required. Improve by iteration
+            presult[i] = wnc.FindOdds(mu, presult[i]);
+        }
     }
     // Check for errors
     if (err & 8) FatalError("mu out of range");
@@ -1425,6 +2552,849 @@ REXPORTS SEXP oddsWNCHypergeo(
 }
 
 
+/******************************************************************************
+      Sorting of observed x values for confidence intervals
+******************************************************************************/
+// ciFNCHypergeo and ciWNCHypergeo sort the x values so that the confidence
+// interval is calculated only once for each distinct x value. Repeated x
+// values get a copy of the first result.
+
+struct SObservation {                   // Observed x value, used for sorting
+    int64 x;                            // x value
+    R_xlen_t index;                     // Index into result vector
+};
+
+static int CompareObservations(const void * a, const void * b) {
+    // Compare function used by qsort
+    const SObservation * p = (const SObservation *)a, * q = (const SObservation *)b;
+    if (p->x != q->x) return p->x < q->x ? -1 : 1;
+    return p->index < q->index ? -1 : (p->index > q->index ? 1 : 0);
+}
+
+static SObservation * SortObservations(double * px, R_xlen_t nres) {
+    // Make list of x values sorted by x. The list is allocated with R_alloc
+    SObservation * list = (SObservation*)R_alloc(nres > 0 ? nres : 1, sizeof(SObservation));
+    for (R_xlen_t i = 0; i < nres; i++) {
+        list[i].x = CountValue(px[i]);  list[i].index = i;
+    }
+    qsort(list, nres, sizeof(SObservation), CompareObservations);
+    return list;
+}
+
+
+/******************************************************************************
+      ciFNCHypergeo
+      Exact conditional confidence interval for the odds of
+      Fisher's NonCentral Hypergeometric distribution
+******************************************************************************/
+// The lower limit of the odds is the value that makes P(X >= x) = alpha/2.
+// The upper limit of the odds is the value that makes P(X <= x) = alpha/2.
+// The logarithms of the central weights, 
+// log(choose(m1,x)*choose(m2,n-x)), are calculated only once. The odds
+// are applied to these weights in each iteration. The equation
+// log(P) = log(alpha/2) is solved by Newton-Raphson iteration in 
+// t = log(odds). The derivative of log(P) with respect to t is the mean of 
+// the tail minus the mean of the distribution.
+// A limit below 1E-300 is returned as 0 and a limit above 1E300 as Inf.
+REXPORTS SEXP ciFNCHypergeo(
+    SEXP rx,         // Observed number of red balls drawn, scalar or vector
+    SEXP rm1,        // Number of red balls in urn
+    SEXP rm2,        // Number of white balls in urn
+    SEXP rn,         // Number of balls drawn from urn
+    SEXP rconf,      // Confidence level, e.g. 0.95
+    SEXP rprecision  // Precision of calculation
+) {
+    // Check for vectors
+    if (XLENGTH(rx) < 0
+        || XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rconf) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        FatalError("Parameter has wrong length");
+    }
+    // Get parameter values
+    double* px = REAL(rx);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
+    double  conf = *REAL(rconf);
+    double  prec = *REAL(rprecision);
+    int     nres = LENGTH(rx);          // Number of intervals to return
+    int64   N = m1 + m2;                // Total number of balls
+    int64   xmin, xmax;                 // Limits for x
+    int     L;                          // Length of support
+    double* lw;                         // log of central weights
+    double  lalpha;                     // log(alpha/2)
+    double  t, dt;                      // log(odds) and step
+    double  tlo, thi;                   // bracket for t
+    double  h0, d, w;                   // log of weight at mode, log of relative weight, weight
+    double  s, s1, tl, tl1;             // sum of weights, sum of weights*x, same for tail
+    double  g, gd;                      // log(P) - log(alpha/2) and its derivative
+    int     mode, lo, hi;               // mode of weights, binary search limits
+    int64   x;                          // x value
+    int     ix, k, i, j, jj, j1, iter;  // Loop counters etc.
+    SObservation * list;                // x values sorted
+    const double tmax = 690.;           // limit for t. odds limited to 1E-300 .. 1E300
+    const double dmin = -750.;          // log of negligible relative weight
+
+    // Check validity of parameters
+    if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
+    if (N > MAXURN) FatalError("Overflow");
+    if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
+    if (!R_FINITE(conf) || conf <= 0 || conf >= 1) FatalError("Confidence level must be between 0 and 1");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+    if (prec < 1E-12) prec = 1E-12;
+    lalpha = log(0.5 * (1. - conf));
+
+    // min and max
+    xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
+    xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
+    if (xmax - xmin >= INT_MAX / 2) FatalError("Range of x too big for confidence interval");
+    L = (int)(xmax - xmin + 1);
+
+    // Allocate result matrix
+    SEXP result;  double * presult;
+    PROTECT(result = Rf_allocMatrix(REALSXP, nres, 2));
+    presult = REAL(result);
+
+    // Make table of log central weights
+    lw = (double*)R_alloc(L, sizeof(double));
+    for (i = 0; i < L; i++) {
+        x = xmin + i;
+        lw[i] = -(LnFac(x) + LnFac(m1 - x) + LnFac(n - x) + LnFac(m2 - n + x));
+    }
+
+    // Loop through x values in sorted order
+    list = SortObservations(px, nres);
+    for (jj = 0; jj < nres; jj++) {
+        j = (int)list[jj].index;  x = list[jj].x;
+        if (jj > 0 && x == list[jj - 1].x) {
+            // Same x as before. Copy result
+            j1 = (int)list[jj - 1].index;
+            presult[j] = presult[j1];  presult[j + nres] = presult[j1 + nres];
+            continue;
+        }
+        if (x < xmin || x > xmax) FatalError("x out of range");
+        ix = (int)(x - xmin);
+
+        // k = 0: lower limit, tail = P(X >= x), increasing with t
+        // k = 1: upper limit, tail = P(X <= x), decreasing with t
+        for (k = 0; k < 2; k++) {
+            if (k == 0 && x == xmin) {
+                presult[j] = 0.;  continue;
+            }
+            if (k == 1 && x == xmax) {
+                presult[j + nres] = R_PosInf;  continue;
+            }
+            // Start at sample odds ratio with 0.5 added to each cell
+            t = log((x + 0.5) * (m2 - n + x + 0.5) / ((m1 - x + 0.5) * (n - x + 0.5)));
+            tlo = -tmax;  thi = tmax;
+
+            for (iter = 0; iter < 200; iter++) {
+                // Find mode of weights by binary search. log weights are concave
+                lo = 0;  hi = L - 1;
+                while (lo < hi) {
+                    i = (lo + hi) >> 1;
+                    if (lw[i + 1] + t > lw[i]) lo = i + 1;  else hi = i;
+                }
+                mode = lo;
+                h0 = lw[mode] + mode * t;
+
+                // Sum weights from mode and out, relative to mode
+                s = s1 = tl = tl1 = 0.;
+                for (i = mode; i >= 0; i--) {           // left tail
+                    d = lw[i] + i * t - h0;
+                    if (d < dmin) break;
+                    w = exp(d);
+                    s += w;  s1 += w * (i - mode);
+                    if (k == 0 ? i >= ix : i <= ix) {   // in tail
+                        tl += w;  tl1 += w * (i - mode);
+                    }
+                }
+                for (i = mode + 1; i < L; i++) {        // right tail
+                    d = lw[i] + i * t - h0;
+                    if (d < dmin) break;
+                    w = exp(d);
+                    s += w;  s1 += w * (i - mode);
+                    if (k == 0 ? i >= ix : i <= ix) {   // in tail
+                        tl += w;  tl1 += w * (i - mode);
+                    }
+                }
+
+                if (tl > 0.) {
+                    g = log(tl / s) - lalpha;
+                    gd = tl1 / tl - s1 / s;
+                }
+                else {
+                    // Tail is negligible
+                    g = R_NegInf;  gd = 0.;
+                }
+                if (k) g = -g, gd = -gd;            // make g increasing with t
+
+                // update bracket
+                if (g > 0.) thi = t;  else tlo = t;
+                if (g == 0.) break;
+
+                // Newton-Raphson step
+                if (gd > 0. && R_FINITE(g)) dt = -g / gd;
+                else dt = g > 0. ? -5. : 5.;
+                if (dt > 5.) dt = 5.;               // limit step size
+                if (dt < -5.) dt = -5.;
+                if (t + dt <= tlo || t + dt >= thi) {
+                    // outside bracket. Use bisection instead
+                    dt = 0.5 * (tlo + thi) - t;
+                }
+                t += dt;
+                if (fabs(dt) < prec) break;
+            }
+            if (iter >= 200) FatalError("Confidence limit does not converge");
+            if (t <= -tmax + 2. * prec) presult[j + k * nres] = 0.;            // Limit below range
+            else if (t >= tmax - 2. * prec) presult[j + k * nres] = R_PosInf;  // Limit above range
+            else presult[j + k * nres] = exp(t);
+        }
+    }
+
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
+
+
+/******************************************************************************
+      ciWNCHypergeo
+      Exact conditional confidence interval for the odds of
+      Wallenius' NonCentral Hypergeometric distribution
+******************************************************************************/
+// The lower limit of the odds is the value that makes P(X >= x) = alpha/2.
+// The upper limit of the odds is the value that makes P(X <= x) = alpha/2.
+// The same CWalleniusNCHypergeometric object is used for all iterations 
+// and only the odds are changed. The equation log(P) = log(alpha/2) is 
+// solved by secant iteration in t = log(odds), with bisection if the 
+// secant step goes outside the bracket.
+// A limit below 1E-20 is returned as 0 and a limit above 1E20 as Inf, 
+// because the probabilities cannot be calculated with more extreme odds.
+REXPORTS SEXP ciWNCHypergeo(
+    SEXP rx,         // Observed number of red balls drawn, scalar or vector
+    SEXP rm1,        // Number of red balls in urn
+    SEXP rm2,        // Number of white balls in urn
+    SEXP rn,         // Number of balls drawn from urn
+    SEXP rconf,      // Confidence level, e.g. 0.95
+    SEXP rprecision  // Precision of calculation
+) {
+    // Check for vectors
+    if (XLENGTH(rx) < 0
+        || XLENGTH(rm1) != 1
+        || XLENGTH(rm2) != 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rconf) != 1
+        || XLENGTH(rprecision) != 1
+        ) {
+        FatalError("Parameter has wrong length");
+    }
+    // Get parameter values
+    double* px = REAL(rx);
+    int64   m1 = CountValue(*REAL(rm1));
+    int64   m2 = CountValue(*REAL(rm2));
+    int64   n = CountValue(*REAL(rn));
+    double  conf = *REAL(rconf);
+    double  prec = *REAL(rprecision);
+    int     nres = LENGTH(rx);          // Number of intervals to return
+    int64   N = m1 + m2;                // Total number of balls
+    double* buffer = 0;                 // Table of probabilities
+    int     BufferLength = 0;           // Length of table
+    int     len;                        // Table length needed
+    int64   x1, x2;                     // Table limits
+    int64   xmin, xmax;                 // Limits for x
+    double  lalpha;                     // log(alpha/2)
+    double  t, t1, dt;                  // log(odds) in this and last iteration, and step
+    double  tlo, thi;                   // bracket for t
+    double  s, tl;                      // sum of table, sum of tail
+    double  g, g1 = 0.;                 // log(P) - log(alpha/2) in this and last iteration
+    int64   x;                          // x value
+    int     k, i, j, jj, j1, iter;      // Loop counters etc.
+    SObservation * list;                // x values sorted
+    bool    useTable = false;           // unused
+    const double tmax = 46.;            // limit for t. odds limited to 1E-20 .. 1E20
+
+    // Check validity of parameters
+    if (m1 < 0 || m2 < 0 || n < 0) FatalError("Negative parameter");
+    if (N > MAXURN) FatalError("Overflow");
+    if (n > N) FatalError("n > m1 + m2: Taking more items than there are");
+    if (!R_FINITE(conf) || conf <= 0 || conf >= 1) FatalError("Confidence level must be between 0 and 1");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+    if (prec < 1E-12) prec = 1E-12;
+    lalpha = log(0.5 * (1. - conf));
+
+    // min and max
+    xmin = m1 + n - N;  if (xmin < 0) xmin = 0;  // Minimum x
+    xmax = n;  if (xmax > m1) xmax = m1;         // Maximum x
+
+    // Allocate result matrix
+    SEXP result;  double * presult;
+    PROTECT(result = Rf_allocMatrix(REALSXP, nres, 2));
+    presult = REAL(result);
+
+    // Make object for calculating probabilities. Odds are changed later
+    CWalleniusNCHypergeometric wnc(n, m1, N, 1., prec);
+
+    // Loop through x values in sorted order
+    list = SortObservations(px, nres);
+    for (jj = 0; jj < nres; jj++) {
+        j = (int)list[jj].index;  x = list[jj].x;
+        if (jj > 0 && x == list[jj - 1].x) {
+            // Same x as before. Copy result
+            j1 = (int)list[jj - 1].index;
+            presult[j] = presult[j1];  presult[j + nres] = presult[j1 + nres];
+            continue;
+        }
+        if (x < xmin || x > xmax) FatalError("x out of range");
+
+        // k = 0: lower limit, tail = P(X >= x), increasing with t
+        // k = 1: upper limit, tail = P(X <= x), decreasing with t
+        for (k = 0; k < 2; k++) {
+            if (k == 0 && x == xmin) {
+                presult[j] = 0.;  continue;
+            }
+            if (k == 1 && x == xmax) {
+                presult[j + nres] = R_PosInf;  continue;
+            }
+            // Start at Manly's estimate with 0.5 added to each cell
+            t = t1 = log(log(1. - (x + 0.5) / (m1 + 1.)) / log(1. - (n - x + 0.5) / (m2 + 1.)));
+            tlo = -tmax;  thi = tmax;
+
+            for (iter = 0; iter < 200; iter++) {
+                // Make table of probabilities with these odds
+                wnc.SetOdds(exp(t));
+                len = wnc.MakeTable(buffer, 0, &x1, &x2, &useTable, prec * 0.001);
+                if (len > BufferLength) {
+                    // Allocate bigger buffer. Old buffer is freed on return
+                    BufferLength = len;
+                    buffer = (double*)R_alloc(BufferLength, sizeof(double));
+                }
+                wnc.MakeTable(buffer, BufferLength, &x1, &x2, &useTable, prec * 0.001);
+
+                // Sum of table and sum of tail
+                for (s = tl = 0., i = 0; i <= x2 - x1; i++) {
+                    s += buffer[i];
+                    if (k == 0 ? x1 + i >= x : x1 + i <= x) tl += buffer[i]; // in tail
+                }
+
+                if (tl > 0.) g = log(tl / s) - lalpha;
+                else g = R_NegInf;                  // Tail is negligible
+                if (k) g = -g;                      // make g increasing with t
+
+                // update bracket
+                if (g > 0.) thi = t;  else tlo = t;
+                if (g == 0.) break;
+
+                // Secant step
+                if (iter > 0 && R_FINITE(g) && R_FINITE(g1) && g != g1) {
+                    dt = -g * (t - t1) / (g - g1);
+                }
+                else {
+                    dt = g > 0. ? -1. : 1.;
+                }
+                if (dt > 5.) dt = 5.;               // limit step size
+                if (dt < -5.) dt = -5.;
+                if (t + dt <= tlo || t + dt >= thi) {
+                    // outside bracket. Use bisection instead
+                    dt = 0.5 * (tlo + thi) - t;
+                }
+                t1 = t;  g1 = g;
+                t += dt;
+                if (fabs(dt) < prec) break;
+            }
+            if (iter >= 200) FatalError("Confidence limit does not converge");
+            if (t <= -tmax + 2. * prec) presult[j + k * nres] = 0.;            // Limit below range
+            else if (t >= tmax - 2. * prec) presult[j + k * nres] = R_PosInf;  // Limit above range
+            else presult[j + k * nres] = exp(t);
+        }
+    }
+
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
+
+
+/******************************************************************************
+      testFNCHypergeo
+      Exact test of the odds for many 2x2 tables, using
+      Fisher's NonCentral Hypergeometric distribution
+******************************************************************************/
+// Each row of the matrix tables contains the four cells a, b, c, d of a 
+// 2x2 table [a b; c d]. This gives x = a, m1 = a + c, m2 = b + d, n = a + b,
+// as in fisher.test.
+// The rows are sorted by margins (m1, m2, n) so that the table of 
+// probabilities is made only once for each group of rows with identical
+// margins. The groups are distributed between threads if OpenMP is available.
+// The two-sided p-value is the sum of all probabilities that are not
+// bigger than the probability of the observed x, as in fisher.test.
+
+static const double TEST_CUTOFF = 1E-300; // Tables are cut off where the values underflow
+
+struct SMargins {                       // Margins of a 2x2 table, used for sorting
+    int64 m1, m2, n;                    // Margins
+    R_xlen_t row;                       // Row in tables matrix
+};
+
+static int CompareMargins(const void * a, const void * b) {
+    // Compare function used by qsort
+    const SMargins * p = (const SMargins *)a, * q = (const SMargins *)b;
+    if (p->m1 != q->m1) return p->m1 < q->m1 ? -1 : 1;
+    if (p->m2 != q->m2) return p->m2 < q->m2 ? -1 : 1;
+    if (p->n  != q->n)  return p->n  < q->n  ? -1 : 1;
+    if (p->row != q->row) return p->row < q->row ? -1 : 1;
+    return 0;
+}
+
+REXPORTS SEXP testFNCHypergeo(
+    SEXP rtables,    // Matrix with one 2x2 table a, b, c, d in each row
+    SEXP rodds,      // Odds under the null hypothesis
+    SEXP ralternative, // 0 = two sided, 1 = less, 2 = greater
+    SEXP rprecision, // Precision of calculation
+    SEXP rthreads    // Number of threads
+) {
+    // Check for vectors
+    if (!Rf_isMatrix(rtables) || Rf_ncols(rtables) != 4) {
+        FatalError("tables must be a matrix with 4 columns");
+    }
+    if (XLENGTH(rodds) != 1
+        || XLENGTH(ralternative) != 1
+        || XLENGTH(rprecision) != 1
+        || XLENGTH(rthreads) != 1
+        ) {
+        FatalError("Parameter has wrong length");
+    }
+    // Get parameter values
+    double* ptab = REAL(rtables);
+    double  odds = *REAL(rodds);
+    int     alternative = *INTEGER(ralternative);
+    double  prec = *REAL(rprecision);
+    int     nthreads = *INTEGER(rthreads);
+    R_xlen_t nres = Rf_nrows(rtables);  // Number of tables
+    R_xlen_t ngroups;                   // Number of groups with identical margins
+    R_xlen_t * groups;                  // Index to first row of each group in sorted list
+    SMargins * list;                    // Sorted list of margins
+    double* buffers;                    // Buffers for all threads
+    int     MaxLength = 1;              // Biggest table length needed
+    R_xlen_t i, g;                      // Loop counters
+
+    // Check validity of parameters
+    if (!R_FINITE(odds) || odds <= 0) FatalError("Invalid value for odds");
+    if (alternative < 0 || alternative > 2) FatalError("Invalid alternative");
+    if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+#ifdef _OPENMP
+    if (nthreads < 1) nthreads = 1;
+#else
+    nthreads = 1;
+#endif
+
+    // Allocate result vector
+    SEXP result;  double * presult;
+    PROTECT(result = Rf_allocVector(REALSXP, nres));
+    presult = REAL(result);
+
+    // Get margins and check validity
+    list = (SMargins*)R_alloc(nres > 0 ? nres : 1, sizeof(SMargins));
+    for (i = 0; i < nres; i++) {
+        int64 a = CountValue(ptab[i]), b = CountValue(ptab[i + nres]);
+        int64 c = CountValue(ptab[i + 2 * nres]), d = CountValue(ptab[i + 3 * nres]);
+        if (a < 0 || b < 0 || c < 0 || d < 0) FatalError("Negative or missing value in tables");
+        if (a + b + c + d > MAXURN) FatalError("Overflow");
+        list[i].m1 = a + c;  list[i].m2 = b + d;  list[i].n = a + b;  list[i].row = i;
+    }
+
+    // Sort by margins
+    qsort(list, nres, sizeof(SMargins), CompareMargins);
+
+    // Find groups and the biggest table length needed
+    groups = (R_xlen_t*)R_alloc(nres + 1, sizeof(R_xlen_t));
+    for (ngroups = 0, i = 0; i < nres; i++) {
+        if (i == 0 || list[i].m1 != list[i - 1].m1 || list[i].m2 != list[i - 1].m2 || list[i].n != list[i - 1].n) {
+            // New group. Find table length
+            int64 m1 = list[i].m1, n = list[i].n, N = m1 + list[i].m2;
+            int64 x1 = m1 + n - N;  if (x1 < 0) x1 = 0;
+            int64 x2 = n;  if (x2 > m1) x2 = m1;
+            int len = x2 - x1 < 100000 ? (int)(x2 - x1 + 1) : 100001;
+            if (len > 100000) {
+                // Very long table. Use only the part where the values do not
+                // underflow. The cutoff must be the same as when the table is 
+                // made below, otherwise the tails are truncated
+                int64 xf, xl;
+                double dlen = CFishersNCHypergeometric(n, m1, N, odds, prec).MakeLogTable(0, 0, &xf, &xl, TEST_CUTOFF);
+                len = dlen < 0x40000000 ? (int)dlen : 0x40000000;
+            }
+            if (len > MaxLength) MaxLength = len;
+            groups[ngroups++] = i;
+        }
+    }
+    groups[ngroups] = nres;
+
+    // Allocate one buffer for each thread, containing table, left cumulative and right cumulative
+    CParallelError err;                 // Error in any thread
+    buffers = (double*)R_alloc((size_t)nthreads * 3 * MaxLength, sizeof(double));
+
+    // Loop through groups
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        err.Run([&]() {
+            int thread = 0;
+#ifdef _OPENMP
+            thread = omp_get_thread_num();
+#endif
+            double * table = buffers + (size_t)thread * 3 * MaxLength; // Table of probabilities
+            double * cl = table + MaxLength;  // Cumulative from the left
+            double * cr = cl + MaxLength;     // Cumulative from the right
+            int64 m1 = list[groups[g]].m1, n = list[groups[g]].n, N = m1 + list[groups[g]].m2;
+            int64 x1, x2;                     // Table limits
+            bool  useTable;                   // Unused
+            double factor;                    // 1 / sum of table
+            double px;                        // Probability of x, with tolerance
+            double p;                         // p-value
+            int   len, im;                    // Table length, index of mode
+            int   i, lo, hi;                  // Table index
+            R_xlen_t j;                       // Loop counter
+            int64 x;                          // Observed x
+
+            // Make table. Cut off where values underflow
+            CFishersNCHypergeometric fnc(n, m1, N, odds, prec);
+            factor = 1. / fnc.MakeTable(table, MaxLength, &x1, &x2, &useTable, TEST_CUTOFF);
+            len = (int)(x2 - x1 + 1);
+            im = (int)(fnc.mode() - x1);
+            if (im < 0) im = 0;  
+            if (im >= len) im = len - 1;
+
+            // Make cumulative tables
+            for (cl[0] = table[0], i = 1; i < len; i++) cl[i] = cl[i - 1] + table[i];
+            for (cr[len - 1] = table[len - 1], i = len - 2; i >= 0; i--) cr[i] = cr[i + 1] + table[i];
+
+            // Loop through rows in group
+            for (j = groups[g]; j < groups[g + 1]; j++) {
+                x = CountValue(ptab[list[j].row]); // Observed x = a
+                // Index into table. Values far outside the table are limited
+                i = x < x1 - 1 ? -1 : (x > x2 + 1 ? len : (int)(x - x1));
+
+                switch (alternative) {
+                case 1:  // less. P(X <= x)
+                    if (i < 0) p = 0.;
+                    else if (i >= len - 1) p = 1.;
+                    else if (i <= im) p = cl[i] * factor;
+                    else p = 1. - cr[i + 1] * factor;
+                    break;
+                case 2:  // greater. P(X >= x)
+                    if (i > len - 1) p = 0.;
+                    else if (i <= 0) p = 1.;
+                    else if (i >= im) p = cr[i] * factor;
+                    else p = 1. - cl[i - 1] * factor;
+                    break;
+                default: // two sided
+                    if (i < 0 || i >= len) {
+                        p = 0.;              // Negligible
+                        break;
+                    }
+                    px = table[i] * (1. + 1E-7);  // Relative tolerance as in fisher.test
+                    if (i <= im) {
+                        // Left tail. Include any neighbors with equal probability
+                        while (i < im && table[i + 1] <= px) i++;
+                        // Find first index in right tail with table <= px
+                        lo = im + 1;  hi = len;
+                        while (lo < hi) {
+                            int mid = (lo + hi) >> 1;
+                            if (table[mid] <= px) hi = mid;  else lo = mid + 1;
+                        }
+                        p = cl[i] + (lo < len ? cr[lo] : 0.);
+                    }
+                    else {
+                        // Right tail. Include any neighbors with equal probability
+                        while (i > im && table[i - 1] <= px) i--;
+                        // Find last index in left tail with table <= px
+                        lo = -1;  hi = im - 1;
+                        while (lo < hi) {
+                            int mid = (lo + hi + 1) >> 1;
+                            if (table[mid] <= px) lo = mid;  else hi = mid - 1;
+                        }
+                        p = cr[i] + (lo >= 0 ? cl[lo] : 0.);
+                    }
+                    p *= factor;
+                }
+                if (p > 1.) p = 1.;
+                presult[list[j].row] = p;
+            }
+        });
+    }
+    err.Check();                        // Error exit from main thread
+
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
+
+
+/******************************************************************************
+      loglikFNCHypergeo, loglikWNCHypergeo
+      Log likelihood of many observations and its derivative with respect
+      to log(odds) for Fisher's and Wallenius' NonCentral Hypergeometric 
+      distributions
+******************************************************************************/
+// Each observation has its own x, m1, m2, n and odds. All parameters are 
+// recycled to the length of the longest vector. The observations are sorted
+// by parameters so that the table of probabilities is made only once for 
+// each group of observations with identical parameters. The groups are 
+// distributed between threads if OpenMP is available.
+// The derivative for Fisher's distribution is exact: 
+// d/d(log(odds)) log(f(x)) = x - E(X).
+// The derivative for Wallenius' distribution is calculated by central 
+// difference with step size WNC_LOGODDS_STEP in log(odds). The two extra
+// tables are calculated with a precision of at least 1E-10.
+// The result is a vector of the sum of log likelihoods and the sum of 
+// derivatives.
+
+static const double WNC_LOGODDS_STEP = 1E-3; // Step size for derivative of Wallenius' distribution
+
+static double FisherLogWeight(int64 x, int64 x0, int64 m1, int64 m2, int64 n, double logodds) {
+    // Log of proportional function for Fisher's distribution at x relative to x0.
+    // Differences of log factorials are used to avoid loss of precision for big urns
+    double lw = -(LnFacDiff(x, x0) + LnFacDiff(m1 - x, m1 - x0) 
+        + LnFacDiff(n - x, n - x0) + LnFacDiff(m2 - n + x, m2 - n + x0));
+    if (x != x0) lw += (double)(x - x0) * logodds; // Avoid 0 * log(0)
+    return lw;
+}
+
+static SEXP LogLikNCHypergeo(
+    int fisher,      // 1 = Fisher's, 0 = Wallenius' distribution
+    SEXP rx,         // Number of red balls drawn, scalar or vector
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision, // Precision of calculation
+    SEXP rthreads    // Number of threads
+) {
+    // Check for vectors
+    if (XLENGTH(rthreads) != 1) {
+        FatalError("Parameter has wrong length");
+    }
+    double* px = REAL(rx);
+    R_xlen_t lx = XLENGTH(rx);          // Length of x vector
+    int     nthreads = *INTEGER(rthreads);
+    R_xlen_t nres = lx;                 // Number of observations
+    R_xlen_t ngroups;                   // Number of groups with identical parameters
+    R_xlen_t * groups;                  // Index to first entry of each group in sorted list
+    int   * lengths;                    // Buffer length needed for each group
+    SParameterSet * list;               // Sorted list of parameter sets
+    double* buffers;                    // Buffers for all threads
+    double* gloglik;                    // Log likelihood for each group
+    double* ggrad;                      // Derivative for each group
+    int     MaxLength = 1;              // Biggest buffer length needed
+    double  loglik = 0., grad = 0.;     // Sums
+    R_xlen_t g;                         // Loop counter
+
+    // Number of observations is the length of the longest vector, or 0 if any vector is empty
+    SEXP    rpar[5] = {rm1, rm2, rn, rodds, rprecision};
+    for (g = 0; g < 5; g++) {
+        if (XLENGTH(rpar[g]) > nres) nres = XLENGTH(rpar[g]);
+    }
+    for (g = 0; g < 5; g++) {
+        if (XLENGTH(rpar[g]) == 0) nres = 0;
+    }
+    if (lx == 0) nres = 0;
+#ifdef _OPENMP
+    if (nthreads < 1) nthreads = 1;
+#else
+    nthreads = 1;
+#endif
+
+    // Sort parameter sets into groups
+    list = GroupParameterSets(nres, rm1, rm2, rn, rodds, rprecision, &ngroups, &groups);
+    lengths = (int*)R_alloc(ngroups + 1, sizeof(int));
+    gloglik = (double*)R_alloc(ngroups + 1, sizeof(double));
+    ggrad   = (double*)R_alloc(ngroups + 1, sizeof(double));
+    LnFac(2);                           // Initialize static table before starting threads
+    CParallelError err;                 // Error in any thread
+
+    // Find buffer length needed for each group
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        lengths[g] = 0;
+        err.Run([&]() {
+            SParameterSet & s = list[groups[g]];
+            int64 N = s.m1 + s.m2, xf, xl;
+            R_xlen_t count = groups[g + 1] - groups[g];
+            if (fisher) {
+                CFishersNCHypergeometric fnc(s.n, s.m1, N, s.odds, s.prec);
+                lengths[g] = (int)fnc.MakeLogTable(0, 0, &xf, &xl, s.prec * 0.001);
+            }
+            else {
+                // Three tables: odds, odds * exp(step), odds / exp(step)
+                double dprec = s.prec < 1E-10 ? s.prec : 1E-10;
+                CNCHypergeometricTable tab(0, s.n, s.m1, N, s.odds, s.prec);
+                CNCHypergeometricTable tabu(0, s.n, s.m1, N, s.odds * exp(WNC_LOGODDS_STEP), dprec);
+                CNCHypergeometricTable tabd(0, s.n, s.m1, N, s.odds * exp(-WNC_LOGODDS_STEP), dprec);
+                if (tab.UseTable(count > 0x7FFFFFFF ? 0x7FFFFFFF : (int32)count)) {
+                    lengths[g] = tab.TableLength() + tabu.TableLength() + tabd.TableLength();
+                }
+            }
+        });
+    }
+    err.Check();                        // Error exit from main thread
+    for (g = 0; g < ngroups; g++) {
+        if (lengths[g] > MaxLength) MaxLength = lengths[g];
+    }
+
+    // Allocate one buffer for each thread
+    buffers = (double*)R_alloc((size_t)nthreads * MaxLength, sizeof(double));
+
+    // Loop through groups
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        gloglik[g] = ggrad[g] = 0.;
+        err.Run([&]() {
+            int thread = 0;
+#ifdef _OPENMP
+            thread = omp_get_thread_num();
+#endif
+            double * buffer = buffers + (size_t)thread * MaxLength;
+            SParameterSet & s = list[groups[g]];
+            int64 N = s.m1 + s.m2;          // Total number of balls
+            int64 xmin, xmax;               // Limits for x
+            int64 x1, x2;                   // Table limits
+            int64 x;                        // x value
+            double ll = 0., gr = 0.;        // Sums for this group
+            R_xlen_t j;                     // Loop counter
+
+            xmin = s.m1 + s.n - N;  if (xmin < 0) xmin = 0;
+            xmax = s.n;  if (xmax > s.m1) xmax = s.m1;
+
+            if (fisher) {
+                CFishersNCHypergeometric fnc(s.n, s.m1, N, s.odds, s.prec);
+                double logodds = log(s.odds);
+                double logsum;              // log of sum of table
+                double sw = 0., swx = 0.;   // Sums for mean
+                double mean;                // Exact mean
+                int64  mode = -1;           // Mode, calculated when needed
+                int    i;
+
+                // Make table of log(f(x)/f(mode))
+                logsum = fnc.MakeLogTable(buffer, lengths[g], &x1, &x2, s.prec * 0.001);
+                if (lengths[g] == 0 || x1 == x2) {
+                    logsum = 0.;  buffer[0] = 0.;  // Deterministic
+                }
+                for (i = 0; i <= x2 - x1; i++) {
+                    double w = exp(buffer[i]);
+                    sw += w;  swx += w * (x1 + i);
+                }
+                mean = swx / sw;
+
+                // Loop through observations in group
+                for (j = groups[g]; j < groups[g + 1]; j++) {
+                    if (ISNAN(px[list[j].index % lx])) {
+                        ll = gr = NA_REAL;      // Missing observation
+                        break;
+                    }
+                    x = CountValue(px[list[j].index % lx]);
+                    if (x < xmin || x > xmax) {
+                        ll = R_NegInf;      // Impossible observation
+                    }
+                    else if (x >= x1 && x <= x2) {
+                        ll += buffer[x - x1] - logsum;
+                    }
+                    else {
+                        // Outside table. Calculate from log factorials
+                        if (mode < 0) mode = fnc.mode();
+                        ll += FisherLogWeight(x, mode, s.m1, s.m2, s.n, logodds) - logsum;
+                    }
+                    gr += x - mean;
+                }
+            }
+            else {
+                double dprec = s.prec < 1E-10 ? s.prec : 1E-10;
+                CNCHypergeometricTable tab(0, s.n, s.m1, N, s.odds, s.prec);
+                CNCHypergeometricTable tabu(0, s.n, s.m1, N, s.odds * exp(WNC_LOGODDS_STEP), dprec);
+                CNCHypergeometricTable tabd(0, s.n, s.m1, N, s.odds * exp(-WNC_LOGODDS_STEP), dprec);
+                if (lengths[g]) {
+                    int32 l0 = tab.TableLength(), lu = tabu.TableLength();
+                    tab.MakeTable(buffer, l0);
+                    tabu.MakeTable(buffer + l0, lu);
+                    tabd.MakeTable(buffer + l0 + lu, lengths[g] - l0 - lu);
+                }
+                // Loop through observations in group
+                for (j = groups[g]; j < groups[g + 1]; j++) {
+                    if (ISNAN(px[list[j].index % lx])) {
+                        ll = gr = NA_REAL;      // Missing observation
+                        break;
+                    }
+                    x = CountValue(px[list[j].index % lx]);
+                    if (x < xmin || x > xmax) {
+                        ll = R_NegInf;      // Impossible observation
+                    }
+                    else {
+                        ll += log(tab.probability(x));
+                        if (s.odds > 0.) {
+                            gr += (log(tabu.probability(x)) - log(tabd.probability(x))) * (0.5 / WNC_LOGODDS_STEP);
+                        }
+                        else {
+                            gr = R_NaN;     // Derivative not defined for odds = 0
+                        }
+                    }
+                }
+            }
+            gloglik[g] = ll;  ggrad[g] = gr;
+        });
+    }
+    err.Check();                        // Error exit from main thread
+
+    // Add results of all groups. The result is NA if any observation is NA
+    for (g = 0; g < ngroups; g++) {
+        if (ISNA(gloglik[g])) {
+            loglik = grad = NA_REAL;  break;
+        }
+        loglik += gloglik[g];  grad += ggrad[g];
+    }
+
+    // Return result
+    SEXP result;  double * presult;
+    PROTECT(result = Rf_allocVector(REALSXP, 2));
+    presult = REAL(result);
+    presult[0] = loglik;
+    presult[1] = grad;
+    UNPROTECT(1);
+    return(result);
+}
+
+REXPORTS SEXP loglikFNCHypergeo(
+    SEXP rx,         // Number of red balls drawn, scalar or vector
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision, // Precision of calculation
+    SEXP rthreads    // Number of threads
+) {
+    return LogLikNCHypergeo(1, rx, rm1, rm2, rn, rodds, rprecision, rthreads);
+}
+
+REXPORTS SEXP loglikWNCHypergeo(
+    SEXP rx,         // Number of red balls drawn, scalar or vector
+    SEXP rm1,        // Number of red balls in urn, scalar or vector
+    SEXP rm2,        // Number of white balls in urn, scalar or vector
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
+    SEXP rodds,      // Odds of getting a red ball among one red and one white
+    SEXP rprecision, // Precision of calculation
+    SEXP rthreads    // Number of threads
+) {
+    return LogLikNCHypergeo(0, rx, rm1, rm2, rn, rodds, rprecision, rthreads);
+}
+
+
 /******************************************************************************
       numWNCHypergeo
       Estimate number of balls of each color from experimental mean for
@@ -1444,28 +3414,28 @@ REXPORTS SEXP numWNCHypergeo(
     SEXP rprecision  // Precision of calculation
 ) {
     // Check for vectors
-    if (LENGTH(rmu) < 1
-        || LENGTH(rn) != 1
-        || LENGTH(rN) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
+    if (XLENGTH(rmu) < 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rN) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
     double *pmu = REAL(rmu);
-    int     n = *INTEGER(rn);
-    int     N = *INTEGER(rN);
+    int64   n = CountValue(*REAL(rn));
+    int64   N = CountValue(*REAL(rN));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     nres = LENGTH(rmu);
-    int     i;                          // Loop counter
+    R_xlen_t nres = XLENGTH(rmu);
+    R_xlen_t i;                         // Loop counter
     int     err = 0;                   // Remember any error
 
     // Check validity of parameters
     if (nres < 0) FatalError("mu has wrong length");
     if (n < 0 || N < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > N: Taking more items than there are");
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 0.1;
@@ -1476,8 +3446,18 @@ REXPORTS SEXP numWNCHypergeo(
     if (nres == 1) {
         PROTECT(result = Rf_allocVector(REALSXP, 2));
     }
+    else if (2 * nres <= INT_MAX) {
+        PROTECT(result = Rf_allocMatrix(REALSXP, 2, (int)nres));
+    }
     else {
-        PROTECT(result = Rf_allocMatrix(REALSXP, 2, nres));
+        // Rf_allocMatrix does not allow more than 2^31-1 elements
+        SEXP dim;
+        if (nres > INT_MAX) FatalError("mu too long. Cannot make matrix with more than 2^31-1 columns");
+        PROTECT(result = Rf_allocVector(REALSXP, 2 * nres));
+        PROTECT(dim = Rf_allocVector(INTSXP, 2));
+        INTEGER(dim)[0] = 2;  INTEGER(dim)[1] = (int)nres;
+        Rf_setAttrib(result, R_DimSymbol, dim);
+        UNPROTECT(1);
     }
     presult = REAL(result);
 
@@ -1580,28 +3560,28 @@ REXPORTS SEXP numFNCHypergeo(
     SEXP rprecision  // Precision of calculation
 ) {
     // Check for vectors
-    if (LENGTH(rmu) < 1
-        || LENGTH(rn) != 1
-        || LENGTH(rN) != 1
-        || LENGTH(rodds) != 1
-        || LENGTH(rprecision) != 1
+    if (XLENGTH(rmu) < 1
+        || XLENGTH(rn) != 1
+        || XLENGTH(rN) != 1
+        || XLENGTH(rodds) != 1
+        || XLENGTH(rprecision) != 1
         ) {
         FatalError("Parameter has wrong length");
     }
     // Get parameter values
     double *pmu = REAL(rmu);
-    int     n = *INTEGER(rn);
-    int     N = *INTEGER(rN);
+    int64   n = CountValue(*REAL(rn));
+    int64   N = CountValue(*REAL(rN));
     double  odds = *REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     nres = LENGTH(rmu);
-    int     i;                          // Loop counter
+    R_xlen_t nres = XLENGTH(rmu);
+    R_xlen_t i;                         // Loop counter
     int     err = 0;                   // Remember any error
 
     // Check validity of parameters
     if (nres < 0) FatalError("mu has wrong length");
     if (n < 0 || N < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > N: Taking more items than there are");
     if (!R_FINITE(odds) || odds < 0) FatalError("Invalid value for odds");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 0.1;
@@ -1612,8 +3592,18 @@ REXPORTS SEXP numFNCHypergeo(
     if (nres == 1) {
         PROTECT(result = Rf_allocVector(REALSXP, 2));
     }
+    else if (2 * nres <= INT_MAX) {
+        PROTECT(result = Rf_allocMatrix(REALSXP, 2, (int)nres));
+    }
     else {
-        PROTECT(result = Rf_allocMatrix(REALSXP, 2, nres));
+        // Rf_allocMatrix does not allow more than 2^31-1 elements
+        SEXP dim;
+        if (nres > INT_MAX) FatalError("mu too long. Cannot make matrix with more than 2^31-1 columns");
+        PROTECT(result = Rf_allocVector(REALSXP, 2 * nres));
+        PROTECT(dim = Rf_allocVector(INTSXP, 2));
+        INTEGER(dim)[0] = 2;  INTEGER(dim)[1] = (int)nres;
+        Rf_setAttrib(result, R_DimSymbol, dim);
+        UNPROTECT(1);
     }
     presult = REAL(result);
 
@@ -50,15 +50,16 @@ REXPORTS SEXP dMFNCHypergeo(
     }
 
     // Get parameter values
-    int32 * px = INTEGER(rx);
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    int64   x[MAXCOLORS];               // x as 64 bit integers
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     N;                          // Total number of balls
-    int     Nu;                         // Total number of balls with nonzero odds
+    int64   N;                          // Total number of balls
+    int64   Nu;                         // Total number of balls with nonzero odds
     int     i, j;                       // Loop counter
-    int     xsum;                       // Column sum of x = n
+    int64   xsum;                       // Column sum of x = n
 
     // Check if odds = 1
     double OddsOne[MAXCOLORS];          // Used if odds = 1
@@ -73,11 +74,11 @@ REXPORTS SEXP dMFNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = Nu = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
         if (podds[i]) Nu += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         if (!R_FINITE(podds[i]) || podds[i] < 0) Rf_error("Invalid value for odds[%i]", i + 1);
     }
 
@@ -97,33 +98,32 @@ REXPORTS SEXP dMFNCHypergeo(
 
     // Loop over x inputs
     for (i = 0; i < nres; i++) {
+        // Read column i of x. x may be integer or double
+        GetCounts(rx, (R_xlen_t)i * colors, colors, x);
         // Calculate x sum and check each x
         for (xsum = j = 0; j < colors; j++) {
-            xsum += px[j];
+            xsum += x[j];
             /* Include this if you want error messages for x < 0 and x > m
-            if (px[j] > pm[j]) {
+            if (x[j] > pm[j]) {
                // Error
-               if (nres == 1) Rf_error("x[%i] = %i is bigger than m[%i] = %i", j+1, px[j], j+1, pm[j]);
-               else Rf_error("x[%i,%i] = %i is bigger than m[%i] = %i", j+1, i+1, px[j], j+1, pm[j]);
+               if (nres == 1) Rf_error("x[%i] = %i is bigger than m[%i] = %i", j+1, x[j], j+1, pm[j]);
+               else Rf_error("x[%i,%i] = %i is bigger than m[%i] = %i", j+1, i+1, x[j], j+1, pm[j]);
             }
-            else if (px[j] < 0) {
-               if (nres == 1) Rf_error("x[%i] = %i is negative", j+1, px[j]);
-               else Rf_error("x[%i,%i] = %i is negative", j+1, i+1, px[j]);
+            else if (x[j] < 0) {
+               if (nres == 1) Rf_error("x[%i] = %i is negative", j+1, x[j]);
+               else Rf_error("x[%i,%i] = %i is negative", j+1, i+1, x[j]);
             }
             */
         }
         // Check x sum
         if (xsum != n) {
             // Error
-            if (nres == 1) Rf_error("sum(x) = %i must be equal to n = %i", xsum, n);
-            else Rf_error("sum(x[,%i]) = %i must be equal to n = %i", i + 1, xsum, n);
+            if (nres == 1) Rf_error("sum(x) = %.0f must be equal to n = %.0f", (double)xsum, (double)n);
+            else Rf_error("sum(x[,%i]) = %.0f must be equal to n = %.0f", i + 1, (double)xsum, (double)n);
         }
 
         // Calculate probability
-        presult[i] = mfnc.probability(px);         // Probability
-
-        // Get next column
-        px += colors;
+        presult[i] = mfnc.probability(x);          // Probability
     }
 
     // Return result
@@ -165,15 +165,16 @@ REXPORTS SEXP dMWNCHypergeo(
     }
 
     // Get parameter values
-    int32 * px = INTEGER(rx);
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    int64   x[MAXCOLORS];               // x as 64 bit integers
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
-    int     N;                          // Total number of balls
-    int     Nu;                         // Total number of balls with nonzero odds
+    int64   N;                          // Total number of balls
+    int64   Nu;                         // Total number of balls with nonzero odds
     int     i, j;                       // Loop counter
-    int     xsum;                       // Column sum of x = n
+    int64   xsum;                       // Column sum of x = n
 
     // Check if odds = 1
     double OddsOne[MAXCOLORS];          // Used if odds = 1
@@ -188,11 +189,11 @@ REXPORTS SEXP dMWNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = Nu = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
         if (podds[i]) Nu += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         if (!R_FINITE(podds[i]) || podds[i] < 0) Rf_error("Invalid value for odds[%i]", i + 1);
     }
 
@@ -212,34 +213,313 @@ REXPORTS SEXP dMWNCHypergeo(
 
     // Loop over x inputs
     for (i = 0; i < nres; i++) {
+        // Read column i of x. x may be integer or double
+        GetCounts(rx, (R_xlen_t)i * colors, colors, x);
         // Calculate x sum and check each x
         for (xsum = j = 0; j < colors; j++) {
-            xsum += px[j];
+            xsum += x[j];
             /* Include this if you want error messages for x > m and x < 0
-            if (px[j] > pm[j]) {
+            if (x[j] > pm[j]) {
                // Error
-               if (nres == 1) Rf_error("x[%i] = %i is bigger than m[%i] = %i", j+1, px[j], j+1, pm[j]);
-               else Rf_error("x[%i,%i] = %i is bigger than m[%i] = %i", j+1, i+1, px[j], j+1, pm[j]);
+               if (nres == 1) Rf_error("x[%i] = %i is bigger than m[%i] = %i", j+1, x[j], j+1, pm[j]);
+               else Rf_error("x[%i,%i] = %i is bigger than m[%i] = %i", j+1, i+1, x[j], j+1, pm[j]);
             }
-            else if (px[j] < 0) {
-               if (nres == 1) Rf_error("x[%i] = %i is negative", j+1, px[j]);
-               else Rf_error("x[%i,%i] = %i is negative", j+1, i+1, px[j]);
+            else if (x[j] < 0) {
+               if (nres == 1) Rf_error("x[%i] = %i is negative", j+1, x[j]);
+               else Rf_error("x[%i,%i] = %i is negative", j+1, i+1, x[j]);
             }
             */
         }
         // Check x sum
         if (xsum != n) {
             // Error
-            if (nres == 1) Rf_error("sum(x) = %i must be equal to n = %i", xsum, n);
-            else Rf_error("sum(x[,%i]) = %i must be equal to n = %i", i + 1, xsum, n);
+            if (nres == 1) Rf_error("sum(x) = %.0f must be equal to n = %.0f", (double)xsum, (double)n);
+            else Rf_error("sum(x[,%i]) = %.0f must be equal to n = %.0f", i + 1, (double)xsum, (double)n);
         }
 
         // Calculate probability
-        presult[i] = mwnc.probability(px);         // Probability
+        presult[i] = mwnc.probability(x);          // Probability
+    }
+
+    // Return result
+    UNPROTECT(1);
+    return(result);
+}
+
+
+/******************************************************************************
+      Recycling of parameters for random variate generation
+******************************************************************************/
+// The random variate generating functions accept a matrix m with one column
+// for each parameter set, a vector n, and a matrix of odds with one column 
+// for each parameter set. These are recycled to the number of variates. The
+// parameter sets are sorted so that identical parameter sets come together
+// and the set-up of the generating functions can be reused. The results are
+// stored in the input order.
+
+// Maximum length of table for exact sampling from multivariate Fisher's distribution
+static const int32 MaxMultiTableLength = 1 << 23;
+
+static int32 MultiTableLimit(R_xlen_t count, int colors) {
+    // Maximum length of a table for exact sampling of count variates from
+    // the multivariate Fisher's distribution. Making the table takes about
+    // the same time as generating one variate by the conditional method and
+    // Gibbs sampling for every 64*colors table entries
+    double limit = (double)count * colors * 64.;
+    return limit < MaxMultiTableLength ? (int32)limit : MaxMultiTableLength;
+}
+
+struct SMultiParameterSet {             // Parameter set for one variate, used for sorting
+    const int64  * m;                   // Number of balls of each color
+    const double * odds;                // Odds for each color
+    int64    n;                         // Number of balls drawn
+    int      colors;                    // Number of colors
+    R_xlen_t index;                     // Index into result
+    R_xlen_t group;                     // Group of identical parameter sets, after sorting
+};
+
+static int CompareMultiParameters(const SMultiParameterSet * p, const SMultiParameterSet * q) {
+    // Compare parameters of two parameter sets. Returns 0 if equal
+    int i;
+    if (p->m != q->m) {
+        for (i = 0; i < p->colors; i++) {
+            if (p->m[i] != q->m[i]) return p->m[i] < q->m[i] ? -1 : 1;
+        }
+    }
+    if (p->odds != q->odds) {
+        for (i = 0; i < p->colors; i++) {
+            if (p->odds[i] != q->odds[i]) return p->odds[i] < q->odds[i] ? -1 : 1;
+        }
+    }
+    if (p->n != q->n) return p->n < q->n ? -1 : 1;
+    return 0;
+}
+
+static int CompareMultiParameterSets(const void * a, const void * b) {
+    // Compare function used by qsort
+    const SMultiParameterSet * p = (const SMultiParameterSet *)a, * q = (const SMultiParameterSet *)b;
+    int c = CompareMultiParameters(p, q);
+    if (c) return c;
+    return p->index < q->index ? -1 : (p->index > q->index ? 1 : 0);
+}
+
+static SEXP AllocMultiResult(int colors, R_xlen_t nran, int64 xmax) {
+    // Allocate result for nran multivariate variates. 
+    // One result gives a vector. Multiple results give a matrix
+    SEXP result;
+    if (nran <= 1) { // One result. Make vector
+        result = AllocCountVector(colors, xmax);
+    }
+    else if ((double)colors * nran <= INT_MAX) { // Multiple results. Make matrix
+        result = Rf_allocMatrix(xmax > INT_MAX ? REALSXP : INTSXP, colors, (int)nran);
+    }
+    else {           // The total length exceeds 2^31-1, which Rf_allocMatrix does not allow
+        SEXP dim;
+        PROTECT(result = AllocCountVector((R_xlen_t)colors * nran, xmax));
+        PROTECT(dim = Rf_allocVector(INTSXP, 2));
+        INTEGER(dim)[0] = colors;  INTEGER(dim)[1] = (int)nran;
+        Rf_setAttrib(result, R_DimSymbol, dim);
+        UNPROTECT(2);
+    }
+    return result;
+}
 
-        // Get next column
-        px += colors;
+static void ChainDiagnostics(SEXP result, int colors, R_xlen_t nran) {
+    // Attach diagnostics for variates made by continued Markov chains.
+    // Attribute "acf" is the lag-1 autocorrelation of each color and "ess" 
+    // is the effective sample size estimated as nran*(1-acf)/(1+acf).
+    // The chains restart at each chunk of RNG_CHUNK variates, so pairs 
+    // of variates in different chunks are not included
+    CCountInput x(result);
+    SEXP racf, ress;
+    R_xlen_t k;                         // Variate index
+    int j;                              // Color index
+    PROTECT(racf = Rf_allocVector(REALSXP, colors));
+    PROTECT(ress = Rf_allocVector(REALSXP, colors));
+    for (j = 0; j < colors; j++) {
+        double mean = 0., var = 0., cov = 0., d0, d1;
+        R_xlen_t npairs = 0;            // Number of pairs of successive variates
+        for (k = 0; k < nran; k++) mean += (double)x[k * colors + j];
+        mean /= (double)nran;
+        for (k = 0; k < nran; k++) {
+            d1 = (double)x[k * colors + j] - mean;
+            var += d1 * d1;
+            if (k % RNG_CHUNK) {
+                d0 = (double)x[(k - 1) * colors + j] - mean;
+                cov += d0 * d1;  npairs++;
+            }
+        }
+        double acf = 0.;                // Lag-1 autocorrelation
+        if (var > 0. && npairs > 0) {
+            acf = cov / npairs / (var / nran);
+            if (acf > 1.) acf = 1.;
+        }
+        REAL(racf)[j] = acf;
+        REAL(ress)[j] = acf >= 1. ? 1. : nran * (1. - acf) / (1. + acf);
     }
+    Rf_setAttrib(result, Rf_install("acf"), racf);
+    Rf_setAttrib(result, Rf_install("ess"), ress);
+    UNPROTECT(2);
+}
+
+static SEXP RecycledRandomMNCHypergeo(
+    int fisher,      // 1 = Fisher's, 0 = Wallenius' distribution
+    R_xlen_t nran,   // Number of random variates desired
+    int colors,      // Number of colors
+    SEXP rm,         // Number of balls of each color in urn, vector or matrix
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
+    SEXP rodds,      // Odds for each color, vector or matrix
+    double prec,     // Precision of calculation
+    SEXP rseed,      // Seed for counter-based random number generator, or length 0
+    int nthreads,    // Number of threads used with counter-based generator
+    int thin         // Scans between variates in continued Markov chains. 0 = independent
+) {
+    // Generate multivariate random variates with recycled parameters
+    R_xlen_t lm = XLENGTH(rm) / colors; // Number of columns in m
+    R_xlen_t lodds = XLENGTH(rodds) / colors; // Number of columns in odds
+    R_xlen_t ln = XLENGTH(rn);          // Length of n
+    double* pmr = REAL(rm);
+    double* podds = REAL(rodds);
+    double* pn = REAL(rn);
+    int64 * pm;                         // m as 64 bit integers
+    int64 * pN;                         // Total number of balls for each column of m
+    SMultiParameterSet * list;          // Sorted list of parameter sets
+    int64   xmax = 0;                   // Highest n
+    R_xlen_t j, k;                      // Loop counters
+    int     i;                          // Loop counter for colors
+
+    if (nran <= 0)  FatalError("Parameter nran must be positive");
+    if (nran > INT_MAX) FatalError("Parameter nran too big. Cannot make matrix with more than 2^31-1 columns");
+    if (ln == 0 || lm == 0 || XLENGTH(rm) != lm * colors) {
+        FatalError("matrix m must have one row for each color");
+    }
+
+    // Check if odds = 1
+    double OddsOne[MAXCOLORS];          // Used if odds = 1
+    if (XLENGTH(rodds) == 1 && *podds == 1.) {
+        // Odds = scalar 1. Set to vector of all 1's
+        for (i = 0; i < colors; i++) OddsOne[i] = 1.;
+        podds = OddsOne;  lodds = 1;
+    }
+    else {
+        if (lodds == 0 || XLENGTH(rodds) != lodds * colors) FatalError("odds must have one row for each color");
+        for (k = 0; k < lodds * colors; k++) {
+            if (!R_FINITE(podds[k]) || podds[k] < 0) Rf_error("Invalid value for odds[%i]", (int)(k % colors) + 1);
+        }
+    }
+
+    // Convert m and check validity
+    pm = (int64*)R_alloc(lm * colors, sizeof(int64));
+    pN = (int64*)R_alloc(lm, sizeof(int64));
+    for (j = 0; j < lm; j++) {
+        for (pN[j] = i = 0; i < colors; i++) {
+            int64 m = pm[j * colors + i] = CountValue(pmr[j * colors + i]);
+            if (m < 0) Rf_error("m[%i] < 0", i + 1);
+            pN[j] += m;
+            if (pN[j] > MAXURN) FatalError("Overflow");
+        }
+    }
+
+    // Make list of parameter sets
+    list = (SMultiParameterSet*)R_alloc(nran, sizeof(SMultiParameterSet));
+    for (k = 0; k < nran; k++) {
+        SMultiParameterSet & s = list[k];
+        s.m = pm + (k % lm) * colors;
+        s.odds = podds + (k % lodds) * colors;
+        s.n = CountValue(pn[k % ln]);
+        s.colors = colors;
+        s.index = k;
+        if (s.n < 0)  FatalError("Negative parameter n");
+        if (s.n > pN[k % lm]) FatalError("n > sum(m): Taking more items than there are");
+        int64 Nu = 0;                   // Total number of balls with nonzero odds
+        for (i = 0; i < colors; i++) {
+            if (s.odds[i]) Nu += s.m[i];
+        }
+        if (s.n > Nu) FatalError("Not enough items with nonzero odds");
+        if (s.n > xmax) xmax = s.n;
+    }
+
+    // Sort by parameters
+    qsort(list, nran, sizeof(SMultiParameterSet), CompareMultiParameterSets);
+
+    // Find groups of identical parameter sets
+    R_xlen_t ngroups = 0;               // Number of groups
+    R_xlen_t * groups = (R_xlen_t*)R_alloc(nran + 1, sizeof(R_xlen_t)); // Start of each group
+    for (k = 0; k < nran; k++) {
+        if (k == 0 || CompareMultiParameters(list + k, list + k - 1)) {
+            groups[ngroups++] = k;
+        }
+        list[k].group = ngroups - 1;
+    }
+    groups[ngroups] = nran;
+
+    // Allocate result
+    SEXP result;
+    PROTECT(result = AllocMultiResult(colors, nran, xmax));
+    CCountVector presult(result);
+
+    // Make object for generating variates
+    StochasticLib3 sto(0);              // Seed is not used
+    sto.SetAccuracy(prec);              // Set precision
+    sto.InitRan(rseed);                 // Initialize RNG
+    nthreads = sto.VariateThreads(nthreads, nran); // Number of threads
+    LnFac(2);                           // Initialize static table before starting threads
+
+    // Decide which groups use a table for exact sampling from Fisher's distribution
+    int32 * lengths = (int32*)R_alloc(ngroups, sizeof(int32)); // Table length for each group
+    double ** tables = (double**)R_alloc(ngroups, sizeof(double*)); // Table for each group
+    R_xlen_t g;                         // Group index
+    CParallelError err;                 // Error in any thread
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        SMultiParameterSet & p = list[groups[g]];
+        lengths[g] = 0;
+        if (fisher) err.Run([&]() {
+            CMultiFishersNCHypergeometricTable tab(p.n, (int64*)p.m, (double*)p.odds, colors);
+            lengths[g] = tab.TableLength(MultiTableLimit(groups[g + 1] - groups[g], colors));
+        });
+    }
+    err.Check();                        // Error exit from main thread
+    double total = 0.;                  // Total length of tables
+    for (g = 0; g < ngroups; g++) {
+        if (total + lengths[g] > MaxMultiTableLength) lengths[g] = 0; // Limit memory use
+        total += lengths[g];
+        tables[g] = lengths[g] ? (double*)R_alloc(lengths[g], sizeof(double)) : 0;
+    }
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (g = 0; g < ngroups; g++) {
+        if (lengths[g]) err.Run([&]() {
+            SMultiParameterSet & p = list[groups[g]];
+            CMultiFishersNCHypergeometricTable tab(p.n, (int64*)p.m, (double*)p.odds, colors);
+            tab.TableLength(lengths[g]);
+            tab.MakeTable(tables[g], lengths[g]);
+        });
+    }
+    err.Check();                        // Error exit from main thread
+
+    // Generate variates in the order of the sorted list
+    GenerateVariates(sto, prec, nran, nthreads, [&](StochasticLib3 & s, R_xlen_t j) {
+        SMultiParameterSet & p = list[j];
+        int64 sample[MAXCOLORS];        // One variate
+        if (j % RNG_CHUNK == 0) s.SetChain(thin); // New chains for each chunk
+        if (tables[p.group]) {          // Exact sampling from table
+            CMultiFishersNCHypergeometricTable tab(p.n, (int64*)p.m, (double*)p.odds, colors);
+            double u[MAXCOLORS];        // Uniform random numbers
+            for (int c = 0; c < colors; c++) u[c] = s.Random();
+            tab.UseTable(tables[p.group]);
+            tab.random(sample, u);
+        }
+        else if (fisher) s.MultiFishersNCHyp(sample, (int64*)p.m, (double*)p.odds, p.n, colors);
+        else s.MultiWalleniusNCHyp(sample, (int64*)p.m, (double*)p.odds, p.n, colors);
+        for (int c = 0; c < colors; c++) { // Store in column of matrix
+            presult.set(p.index * colors + c, sample[c]);
+        }});
+
+    sto.EndRan();                       // Return RNG state to R.dll
 
     // Return result
     UNPROTECT(1);
@@ -254,36 +534,50 @@ REXPORTS SEXP dMWNCHypergeo(
 ******************************************************************************/
 REXPORTS SEXP rMFNCHypergeo(
     SEXP rnran,      // Number of random variates desired, scalar
-    SEXP rm,         // Number of balls of each color in urn, vector
-    SEXP rn,         // Number of balls drawn from urn, scalar
-    SEXP rodds,      // Odds for each color, vector
-    SEXP rprecision  // Precision of calculation, scalar
+    SEXP rm,         // Number of balls of each color in urn, vector or matrix
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
+    SEXP rodds,      // Odds for each color, vector or matrix
+    SEXP rprecision, // Precision of calculation, scalar
+    SEXP rseed,      // Seed for counter-based random number generator, or length 0
+    SEXP rthreads,   // Number of threads used with counter-based generator
+    SEXP rthin       // Scans between variates in continued Markov chains. 0 = independent
 ) {
 
     // Check number of colors
-    int colors = LENGTH(rm);
+    // A matrix m has one row for each color and one column for each parameter set
+    int colors = Rf_isMatrix(rm) ? Rf_nrows(rm) : LENGTH(rm);
     if (colors < 1) FatalError("Number of colors too small");
     if (colors > MAXCOLORS) {
         Rf_error("Number of colors (%i) exceeds maximum (%i).\n"
             "You may recompile the BiasedUrn package with a bigger value of MAXCOLORS in the file Makevars.",
             colors, MAXCOLORS);
     }
-    if (LENGTH(rn) != 1) FatalError("Parameter n has wrong length");
     if (LENGTH(rprecision) != 1) FatalError("Parameter precision has wrong length");
+    int thin = Rf_asInteger(rthin);     // Scans between variates in continued Markov chains
+    if (thin == NA_INTEGER || thin < 0) FatalError("Parameter thin must be a non-negative integer");
+    if (XLENGTH(rm) != colors || XLENGTH(rn) != 1 || XLENGTH(rodds) > colors) {
+        // Recycle parameter sets
+        double prec = *REAL(rprecision);
+        if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+        return RecycledRandomMNCHypergeo(1, NumberOfVariates(rnran), colors, rm, rn, rodds,
+            prec, rseed, Rf_asInteger(rthreads), thin);
+    }
 
     // Get parameter values
-    int     nran = *INTEGER(rnran);  if (LENGTH(rnran) > 1) nran = LENGTH(rnran);
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    R_xlen_t nran = NumberOfVariates(rnran); // Number of random variates
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
     int     i;                          // Loop counter
-    int     N;                          // Total number of balls
-    int     Nu;                         // Total number of balls with nonzero odds
+    int64   N;                          // Total number of balls
+    int64   Nu;                         // Total number of balls with nonzero odds
 
     // Check validity of scalar parameters
     if (n < 0)  FatalError("Negative parameter n");
     if (nran <= 0)  FatalError("Parameter nran must be positive");
+    if (nran > INT_MAX) FatalError("Parameter nran too big. Cannot make matrix with more than 2^31-1 columns");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
     // Check if odds = 1
@@ -299,39 +593,55 @@ REXPORTS SEXP rMFNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = Nu = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
         if (podds[i]) Nu += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         if (!R_FINITE(podds[i]) || podds[i] < 0) Rf_error("Invalid value for odds[%i]", i + 1);
     }
     if (n > N)  FatalError("n > sum(m): Taking more items than there are");
     if (n > Nu) FatalError("Not enough items with nonzero odds");
 
     // Allocate result vector
-    SEXP result;  int * presult;
-    if (nran <= 1) { // One result. Make vector
-        PROTECT(result = Rf_allocVector(INTSXP, colors));
-    }
-    else {           // Multiple results. Make matrix
-        PROTECT(result = Rf_allocMatrix(INTSXP, colors, nran));
-    }
-
-    presult = INTEGER(result);
+    SEXP result;
+    PROTECT(result = AllocMultiResult(colors, nran, n));
+    CCountVector presult(result);
 
     // Make object for generating variates
     StochasticLib3 sto(0);              // Seed is not used
     sto.SetAccuracy(prec);              // Set precision
-    sto.InitRan();                      // Initialize RNG in R.dll
+    sto.InitRan(rseed);                 // Initialize RNG
+    int nthreads = sto.VariateThreads(Rf_asInteger(rthreads), nran); // Number of threads
+    LnFac(2);                           // Initialize static table before starting threads
 
-    // Generate variates one by one
-    for (i = 0; i < nran; i++) {
-        sto.MultiFishersNCHyp(presult, pm, podds, n, colors); // Generate variate
-        presult += colors;               // Point to next column in matrix
+    // Make table for exact sampling if n is small enough
+    CMultiFishersNCHypergeometricTable tab(n, pm, podds, colors);
+    int32 TabLength = tab.TableLength(MultiTableLimit(nran, colors));
+    if (TabLength) {
+        tab.MakeTable((double*)R_alloc(TabLength, sizeof(double)), TabLength);
     }
 
+    // Generate variates one by one
+    GenerateVariates(sto, prec, nran, nthreads, [&](StochasticLib3 & s, R_xlen_t k) {
+        int64 sample[MAXCOLORS];        // One variate
+        if (TabLength) {                // Exact sampling from table
+            double u[MAXCOLORS];        // Uniform random numbers
+            for (int j = 0; j < colors; j++) u[j] = s.Random();
+            tab.random(sample, u);
+        }
+        else {                          // Conditional method and Gibbs sampling
+            if (k % RNG_CHUNK == 0) s.SetChain(thin); // New chains for each chunk
+            s.MultiFishersNCHyp(sample, pm, podds, n, colors);
+        }
+        for (int j = 0; j < colors; j++) { // Store in next column of matrix
+            presult.set(k * colors + j, sample[j]);
+        }});
+
     sto.EndRan();                       // Return RNG state to R.dll
+    if (thin && nran > 1 && !TabLength && sto.MultiUsesChain(1, pm, podds, n, colors)) {
+        ChainDiagnostics(result, colors, nran); // Markov chains have been continued
+    }
 
     // Return result
     UNPROTECT(1);
@@ -346,36 +656,50 @@ REXPORTS SEXP rMFNCHypergeo(
 ******************************************************************************/
 REXPORTS SEXP rMWNCHypergeo(
     SEXP rnran,      // Number of random variates desired, scalar
-    SEXP rm,         // Number of balls of each color in urn, vector
-    SEXP rn,         // Number of balls drawn from urn, scalar
-    SEXP rodds,      // Odds for each color, vector
-    SEXP rprecision  // Precision of calculation, scalar
+    SEXP rm,         // Number of balls of each color in urn, vector or matrix
+    SEXP rn,         // Number of balls drawn from urn, scalar or vector
+    SEXP rodds,      // Odds for each color, vector or matrix
+    SEXP rprecision, // Precision of calculation, scalar
+    SEXP rseed,      // Seed for counter-based random number generator, or length 0
+    SEXP rthreads,   // Number of threads used with counter-based generator
+    SEXP rthin       // Scans between variates in continued Markov chains. 0 = independent
 ) {
 
     // Check number of colors
-    int colors = LENGTH(rm);
+    // A matrix m has one row for each color and one column for each parameter set
+    int colors = Rf_isMatrix(rm) ? Rf_nrows(rm) : LENGTH(rm);
     if (colors < 1) FatalError("Number of colors too small");
     if (colors > MAXCOLORS) {
         Rf_error("Number of colors (%i) exceeds maximum (%i).\n"
             "You may recompile the BiasedUrn package with a bigger value of MAXCOLORS in the file Makevars.",
             colors, MAXCOLORS);
     }
-    if (LENGTH(rn) != 1) FatalError("Parameter n has wrong length");
     if (LENGTH(rprecision) != 1) FatalError("Parameter precision has wrong length");
+    int thin = Rf_asInteger(rthin);     // Scans between variates in continued Markov chains
+    if (thin == NA_INTEGER || thin < 0) FatalError("Parameter thin must be a non-negative integer");
+    if (XLENGTH(rm) != colors || XLENGTH(rn) != 1 || XLENGTH(rodds) > colors) {
+        // Recycle parameter sets
+        double prec = *REAL(rprecision);
+        if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
+        return RecycledRandomMNCHypergeo(0, NumberOfVariates(rnran), colors, rm, rn, rodds,
+            prec, rseed, Rf_asInteger(rthreads), thin);
+    }
 
     // Get parameter values
-    int     nran = *INTEGER(rnran);  if (LENGTH(rnran) > 1) nran = LENGTH(rnran);
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    R_xlen_t nran = NumberOfVariates(rnran); // Number of random variates
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
     int     i;                          // Loop counter
-    int     N;                          // Total number of balls
-    int     Nu;                         // Total number of balls with nonzero odds
+    int64   N;                          // Total number of balls
+    int64   Nu;                         // Total number of balls with nonzero odds
 
     // Check validity of scalar parameters
     if (n < 0)  FatalError("Negative parameter n");
     if (nran <= 0)  FatalError("Parameter nran must be positive");
+    if (nran > INT_MAX) FatalError("Parameter nran too big. Cannot make matrix with more than 2^31-1 columns");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 1E-7;
 
     // Check if odds = 1
@@ -391,39 +715,45 @@ REXPORTS SEXP rMWNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = Nu = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
         if (podds[i]) Nu += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         if (!R_FINITE(podds[i]) || podds[i] < 0) Rf_error("Invalid value for odds[%i]", i + 1);
     }
     if (n > N)  FatalError("n > sum(m): Taking more items than there are");
     if (n > Nu) FatalError("Not enough items with nonzero odds");
 
     // Allocate result vector
-    SEXP result;  int * presult;
-    if (nran <= 1) { // One result. Make vector
-        PROTECT(result = Rf_allocVector(INTSXP, colors));
-    }
-    else {           // Multiple results. Make matrix
-        PROTECT(result = Rf_allocMatrix(INTSXP, colors, nran));
-    }
-
-    presult = INTEGER(result);
+    SEXP result;
+    PROTECT(result = AllocMultiResult(colors, nran, n));
+    CCountVector presult(result);
 
     // Make object for generating variates
     StochasticLib3 sto(0);              // Seed is not used
     sto.SetAccuracy(prec);              // Set precision
-    sto.InitRan();                      // Initialize RNG in R.dll
-
-    // Generate variates one by one
-    for (i = 0; i < nran; i++) {
-        sto.MultiWalleniusNCHyp(presult, pm, podds, n, colors); // Generate variate
-        presult += colors;               // Point to next column in matrix
-    }
+    sto.InitRan(rseed);                 // Initialize RNG
+    int nthreads = sto.VariateThreads(Rf_asInteger(rthreads), nran); // Number of threads
+    LnFac(2);                           // Initialize static table before starting threads
+
+    // Generate variates in batches of URN_LANES. RNG_CHUNK is a multiple of 
+    // URN_LANES so that a batch is never split between threads
+    GenerateVariates(sto, prec, nran, nthreads, [&](StochasticLib3 & s, R_xlen_t k) {
+        const int lanes = StochasticLib3::URN_LANES;
+        int64 sample[lanes * MAXCOLORS]; // Batch of variates
+        if (k % lanes) return;          // Made in previous batch
+        if (k % RNG_CHUNK == 0) s.SetChain(thin); // New chains for each chunk
+        int nb = nran - k < lanes ? (int)(nran - k) : lanes; // Number of variates in batch
+        s.MultiWalleniusNCHypBatch(sample, nb, pm, podds, n, colors); // Generate variates
+        for (int j = 0; j < nb * colors; j++) { // Store in next columns of matrix
+            presult.set(k * colors + j, sample[j]);
+        }});
 
     sto.EndRan();                       // Return RNG state to R.dll
+    if (thin && nran > 1 && sto.MultiUsesChain(0, pm, podds, n, colors)) {
+        ChainDiagnostics(result, colors, nran); // Markov chains have been continued
+    }
 
     // Return result
     UNPROTECT(1);
@@ -455,13 +785,14 @@ REXPORTS SEXP momentsMFNCHypergeo(
     if (LENGTH(rprecision) != 1) FatalError("Parameter precision has wrong length");
 
     // Get parameter values
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
     int     i;                          // Loop counter
-    int     N;                          // Total number of balls
-    int     Nu;                         // Total number of balls with nonzero odds
+    int64   N;                          // Total number of balls
+    int64   Nu;                         // Total number of balls with nonzero odds
 
     // Check validity of scalar parameters
     if (n < 0)  FatalError("Negative parameter n");
@@ -480,11 +811,11 @@ REXPORTS SEXP momentsMFNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = Nu = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
         if (podds[i]) Nu += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         if (!R_FINITE(podds[i]) || podds[i] < 0) Rf_error("Invalid value for odds[%i]", i + 1);
     }
     if (n > N)  FatalError("n > sum(m): Taking more items than there are");
@@ -504,8 +835,10 @@ REXPORTS SEXP momentsMFNCHypergeo(
         mfnc.variance(presult + colors, presult);
     }
     else {
-        // use exact calculation
-        mfnc.moments(presult, presult + colors);
+        // use exact calculation. The user may interrupt the enumeration
+        if (RunWithDeadline(0., [&]() {mfnc.moments(presult, presult + colors);}) == DEADLINE_INTERRUPT) {
+            FatalError("Calculation interrupted by user");
+        }
     }
 
     // Return result
@@ -538,13 +871,14 @@ REXPORTS SEXP momentsMWNCHypergeo(
     if (LENGTH(rprecision) != 1) FatalError("Parameter precision has wrong length");
 
     // Get parameter values
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
     int     i;                          // Loop counter
-    int     N;                          // Total number of balls
-    int     Nu;                         // Total number of balls with nonzero odds
+    int64   N;                          // Total number of balls
+    int64   Nu;                         // Total number of balls with nonzero odds
 
     // Check validity of scalar parameters
     if (n < 0)  FatalError("Negative parameter n");
@@ -563,11 +897,11 @@ REXPORTS SEXP momentsMWNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = Nu = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
         if (podds[i]) Nu += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         if (!R_FINITE(podds[i]) || podds[i] < 0) Rf_error("Invalid value for odds[%i]", i + 1);
     }
     if (n > N)  FatalError("n > sum(m): Taking more items than there are");
@@ -587,8 +921,10 @@ REXPORTS SEXP momentsMWNCHypergeo(
         mwnc.variance(presult + colors, presult);
     }
     else {
-        // use exact calculation
-        mwnc.moments(presult, presult + colors);
+        // use exact calculation. The user may interrupt the enumeration
+        if (RunWithDeadline(0., [&]() {mwnc.moments(presult, presult + colors);}) == DEADLINE_INTERRUPT) {
+            FatalError("Calculation interrupted by user");
+        }
     }
 
     // Return result
@@ -597,6 +933,126 @@ REXPORTS SEXP momentsMWNCHypergeo(
 }
 
 
+/******************************************************************************
+      momentsMWNCHypergeoTimed
+      Calculates the mean and variance of the
+      Multivariate Wallenius' NonCentral Hypergeometric distribution
+      with a time limit
+******************************************************************************/
+// The approximate mean and variance are calculated first. The exact 
+// calculation by enumeration of all combinations replaces the approximation 
+// if it finishes within the time limit, or if the enumeration has covered 
+// enough of the probability mass to be better than the approximation when 
+// the time runs out. The precision obtained is returned as an attribute.
+
+REXPORTS SEXP momentsMWNCHypergeoTimed(
+    SEXP rm,         // Number of balls of each color in urn, vector
+    SEXP rn,         // Number of balls drawn from urn, scalar
+    SEXP rodds,      // Odds for each color, vector
+    SEXP rprecision, // Precision of calculation, scalar
+    SEXP rtime       // Time limit in seconds, scalar
+) {
+
+    // Check number of colors
+    int colors = LENGTH(rm);
+    if (colors < 1) FatalError("Number of colors too small");
+    if (colors > MAXCOLORS) {
+        Rf_error("Number of colors (%i) exceeds maximum (%i).\n"
+            "You may recompile the BiasedUrn package with a bigger value of MAXCOLORS in the file Makevars.",
+            colors, MAXCOLORS);
+    }
+    if (LENGTH(rn) != 1) FatalError("Parameter n has wrong length");
+    if (LENGTH(rprecision) != 1) FatalError("Parameter precision has wrong length");
+    if (LENGTH(rtime) != 1) FatalError("Parameter time has wrong length");
+
+    // Get parameter values
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
+    double *podds = REAL(rodds);
+    double  prec = *REAL(rprecision);
+    double  time = *REAL(rtime);
+    double  mu[MAXCOLORS];              // Mean from enumeration
+    double  var[MAXCOLORS];             // Variance from enumeration
+    double  sumf;                       // Probability mass covered by enumeration
+    double  achieved;                   // Precision obtained
+    bool    enumerated;                 // Enumeration has been started
+    int     status;                     // Value of StopDeadline
+    int     i;                          // Loop counter
+    int64   N;                          // Total number of balls
+    int64   Nu;                         // Total number of balls with nonzero odds
+    const double approxprec = 0.1;      // Nominal precision of approximation
+
+    // Check validity of scalar parameters
+    if (n < 0)  FatalError("Negative parameter n");
+    if (!R_FINITE(prec) || prec < 0 || prec > approxprec) prec = 1E-7;
+    if (ISNAN(time)) time = 0.;
+
+    // Check if odds = 1
+    double OddsOne[MAXCOLORS];          // Used if odds = 1
+    if (LENGTH(rodds) == 1 && *podds == 1.) {
+        // Odds = scalar 1. Set to vector of all 1's
+        for (i = 0; i < colors; i++) OddsOne[i] = 1.;
+        podds = OddsOne;
+    }
+    else {
+        if (LENGTH(rodds) != colors) FatalError("Length of odds vector must match length of m vector");
+    }
+
+    // Get N = sum(m) and check validity of m and odds
+    for (N = Nu = i = 0; i < colors; i++) {
+        int64 m = pm[i] = CountValue(pmr[i]);
+        if (m < 0) Rf_error("m[%i] < 0", i + 1);
+        N += m;
+        if (podds[i]) Nu += m;
+        if (N > MAXURN) FatalError("Overflow");
+        if (!R_FINITE(podds[i]) || podds[i] < 0) Rf_error("Invalid value for odds[%i]", i + 1);
+    }
+    if (n > N)  FatalError("n > sum(m): Taking more items than there are");
+    if (n > Nu) FatalError("Not enough items with nonzero odds");
+
+    // Allocate result vector
+    SEXP result;  double * presult;
+    PROTECT(result = Rf_allocMatrix(REALSXP, colors, 2));
+    presult = REAL(result);
+
+    // Make object for calculating mean and variance
+    CMultiWalleniusNCHypergeometricMoments mwnc(n, pm, podds, colors, prec);
+
+    // Approximation first, then exact calculation as long as there is time left
+    achieved = approxprec;
+    enumerated = false;
+    status = RunWithDeadline(time, [&]() {
+        mwnc.variance(presult + colors, presult);
+        if (!DeadlinePassed(true)) {
+            sumf = mwnc.moments(mu, var);
+            enumerated = true;
+        }
+    });
+    if (status == DEADLINE_INTERRUPT) FatalError("Calculation interrupted by user");
+    if (status == 0) {
+        // Enumeration is complete. Use exact moments
+        achieved = fabs(1. - sumf);
+        if (achieved < prec) achieved = prec;
+        for (i = 0; i < colors; i++) {
+            presult[i] = mu[i];  presult[i + colors] = var[i];
+        }
+    }
+    else if (enumerated) {
+        // An incomplete enumeration is not used, because the moments of
+        // the part enumerated may be far from the true moments
+        Rf_warning("Time limit reached. Approximate moments returned");
+    }
+
+    // Return result with precision attribute
+    SEXP rachieved;
+    PROTECT(rachieved = Rf_ScalarReal(achieved));
+    Rf_setAttrib(result, Rf_install("precision"), rachieved);
+    UNPROTECT(2);
+    return(result);
+}
+
+
 /******************************************************************************
       oddsMFNCHypergeo
       Estimate odds ratio from mean for the
@@ -630,12 +1086,13 @@ REXPORTS SEXP oddsMFNCHypergeo(
 
     // Get parameter values
     double *pmu = REAL(rmu);
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double  prec = *REAL(rprecision);
-    int     N;                          // Total number of balls
+    int64   N;                          // Total number of balls
     int     i, j;                       // Loop counter
-    int     x1, x2;                     // x limits
+    int64   x1, x2;                     // x limits
     int     c0;                         // Reference color
     double  xd0, xd1, xd2;              // Used for searching for reference color
     double  mu;                         // Mean
@@ -644,10 +1101,10 @@ REXPORTS SEXP oddsMFNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         sum_mu += pmu[i];
     }
     if (n > 0 && fabs(sum_mu - n) / n > 0.1) {
@@ -779,12 +1236,13 @@ REXPORTS SEXP oddsMWNCHypergeo(
 
     // Get parameter values
     double *pmu = REAL(rmu);
-    int32 * pm = INTEGER(rm);
-    int     n = *INTEGER(rn);
+    double* pmr = REAL(rm);
+    int64   pm[MAXCOLORS];              // m as 64 bit integers
+    int64   n = CountValue(*REAL(rn));
     double  prec = *REAL(rprecision);
-    int     N;                          // Total number of balls
+    int64   N;                          // Total number of balls
     int     i, j;                       // Loop counter
-    int     x1, x2;                     // x limits
+    int64   x1, x2;                     // x limits
     int     c0;                         // Reference color
     double  xd0, xd1, xd2;              // Used for searching for reference color
     double  mu;                         // Mean
@@ -793,10 +1251,10 @@ REXPORTS SEXP oddsMWNCHypergeo(
 
     // Get N = sum(m) and check validity of m and odds
     for (N = i = 0; i < colors; i++) {
-        int32 m = pm[i];
+        int64 m = pm[i] = CountValue(pmr[i]);
         if (m < 0) Rf_error("m[%i] < 0", i + 1);
         N += m;
-        if ((unsigned int)N > 2000000000) FatalError("Integer overflow");
+        if (N > MAXURN) FatalError("Overflow");
         sum_mu += pmu[i];
     }
     if (n > 0 && fabs(sum_mu - n) / n > 0.1) {
@@ -942,8 +1400,8 @@ REXPORTS SEXP numMFNCHypergeo(
 
     // Get parameter values
     double *pmu = REAL(rmu);
-    int     n = *INTEGER(rn);
-    int     N = *INTEGER(rN);
+    int64   n = CountValue(*REAL(rn));
+    int64   N = CountValue(*REAL(rN));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
 
@@ -974,7 +1432,7 @@ REXPORTS SEXP numMFNCHypergeo(
 
     // Check validity of parameters
     if (n < 0 || N < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > N: Taking more items than there are");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 0.1;
     if (prec < 0.05) Rf_warning("Cannot obtain high precision");
@@ -1176,8 +1634,8 @@ REXPORTS SEXP numMWNCHypergeo(
 
     // Get parameter values
     double *pmu = REAL(rmu);
-    int     n = *INTEGER(rn);
-    int     N = *INTEGER(rN);
+    int64   n = CountValue(*REAL(rn));
+    int64   N = CountValue(*REAL(rN));
     double *podds = REAL(rodds);
     double  prec = *REAL(rprecision);
 
@@ -1208,7 +1666,7 @@ REXPORTS SEXP numMWNCHypergeo(
 
     // Check validity of parameters
     if (n < 0 || N < 0) FatalError("Negative parameter");
-    if ((unsigned int)N > 2000000000) FatalError("Overflow");
+    if (N > MAXURN) FatalError("Overflow");
     if (n > N) FatalError("n > N: Taking more items than there are");
     if (!R_FINITE(prec) || prec < 0 || prec > 1) prec = 0.1;
     if (prec < 0.02) Rf_warning("Cannot obtain high precision");
@@ -191,7 +191,7 @@ Other shared functions
 
 double LnFacr(double x) {
     // log factorial of non-integer x
-    int32 ix = (int32)(x);
+    int64 ix = (int64)(x);
     if (x == ix) return LnFac(ix);      // x is integer
     double r, r2, D = 1., f;
     static const double
@@ -241,6 +241,18 @@ double FallingFactorial(double a, double b) {
     return LnFacr(a) - LnFacr(a - b);
 }
 
+double LnBinom(int64 m, int64 x) {
+    // Natural log of binomial coefficient m!/(x!*(m-x)!) for big m.
+    // Avoids the loss of precision in subtracting big log factorials
+    int64 y = m - x;
+    if (x < FAK_LEN) return LnFacDiff(m, y) - LnFac(x);
+    if (y < FAK_LEN) return LnFacDiff(m, x) - LnFac(y);
+    double m1 = (double)m, x1 = (double)x, y1 = (double)y, p = x1 / m1;
+    // Stirling formula written in terms of the fraction p = x/m
+    return -x1 * log(p) - y1 * log1p(-p) + 0.5 * log(m1 / (x1 * y1)) - 0.918938533204672742
+        + (1. / 12.) * (1. / m1 - 1. / x1 - 1. / y1);
+}
+
 double Erf(double x) {
     // Calculates the error function erf(x) as a series expansion or
     // continued fraction expansion.
@@ -332,14 +344,14 @@ int NumSD(double accuracy) {
 Methods for class CWalleniusNCHypergeometric
 ***********************************************************************/
 
-CWalleniusNCHypergeometric::CWalleniusNCHypergeometric(int32 n_, int32 m_, int32 N_, double odds_, double accuracy_) {
+CWalleniusNCHypergeometric::CWalleniusNCHypergeometric(int64 n_, int64 m_, int64 N_, double odds_, double accuracy_) {
     // constructor
     accuracy = accuracy_;
     SetParameters(n_, m_, N_, odds_);
 }
 
 
-void CWalleniusNCHypergeometric::SetParameters(int32 n_, int32 m_, int32 N_, double odds) {
+void CWalleniusNCHypergeometric::SetParameters(int64 n_, int64 m_, int64 N_, double odds) {
     // change parameters
     if (n_ < 0 || n_ > N_ || m_ < 0 || m_ > N_ || odds < 0) FatalError("Parameter out of range in CWalleniusNCHypergeometric");
     n = n_; m = m_; N = N_; omega = odds;          // set parameters
@@ -350,6 +362,16 @@ void CWalleniusNCHypergeometric::SetParameters(int32 n_, int32 m_, int32 N_, dou
 }
 
 
+void CWalleniusNCHypergeometric::SetOdds(double odds) {
+    // change odds, but keep n, m, N.
+    // The log factorials remembered by lnbico are still valid
+    if (odds < 0) FatalError("Parameter out of range in CWalleniusNCHypergeometric");
+    omega = odds;
+    xLastFindpars = -99;                           // r, w, E depend on odds
+    r = 1.;                                        // initialize
+}
+
+
 double CWalleniusNCHypergeometric::mean(void) {
     // find approximate mean
     int iter;                            // number of iterations
@@ -360,6 +382,7 @@ double CWalleniusNCHypergeometric::mean(void) {
     double g;                            // function to find root of
     double gd;                           // derivative of g
     double omegar;                       // 1/omega
+    double tol;                          // convergence criterion
 
     if (omega == 1.) { // simple hypergeometric
         return double(m) * n / N;
@@ -382,6 +405,8 @@ double CWalleniusNCHypergeometric::mean(void) {
 
     m1r = 1. / m;  m2r = 1. / (N - m);
     iter = 0;
+    tol = 2E-6;
+    if (N > LARGE_URN) tol += 1E-14 * N; // rounding errors are bigger than 2E-6
 
     if (omega > 1.) {
         do { // Newton Raphson iteration
@@ -401,7 +426,7 @@ double CWalleniusNCHypergeometric::mean(void) {
             if (++iter > 40) {
                 FatalError("Search for mean failed in function CWalleniusNCHypergeometric::mean");
             }
-        } while (fabs(mean1 - mean) > 2E-6);
+        } while (fabs(mean1 - mean) > tol);
     }
     else { // omega < 1
         omegar = 1. / omega;
@@ -422,7 +447,7 @@ double CWalleniusNCHypergeometric::mean(void) {
             if (++iter > 40) {
                 FatalError("Search for mean failed in function CWalleniusNCHypergeometric::mean");
             }
-        } while (fabs(mean1 - mean) > 2E-6);
+        } while (fabs(mean1 - mean) > tol);
     }
     return mean;
 }
@@ -444,9 +469,14 @@ double CWalleniusNCHypergeometric::moments(double * mean_, double * var_) {
     // calculate exact mean and variance
     // return value = sum of f(x), expected = 1.
     double y, sy = 0, sxy = 0, sxxy = 0, me1;
-    int32 x, xm, x1;
-    const double accur = 0.1 * accuracy;     // accuracy of calculation
-    xm = (int32)mean();  // approximation to mean
+    int64 x, xm, x1;
+    double accur = 0.1 * accuracy;           // accuracy of calculation
+    xm = (int64)mean();  // approximation to mean
+    if (N > LARGE_URN) {
+        // The distribution is so wide that all f(x) may be below accur.
+        // Make the cutoff relative to the height of the peak instead
+        accur /= sqrt(variance() + 1.);
+    }
     for (x = xm; x <= xmax; x++) {
         y = probability(x);
         x1 = x - xm;  // subtract approximate mean to avoid loss of precision in sums
@@ -468,24 +498,82 @@ double CWalleniusNCHypergeometric::moments(double * mean_, double * var_) {
 }
 
 
-int32 CWalleniusNCHypergeometric::mode(void) {
+double CWalleniusNCHypergeometric::FindOdds(double mu, double odds0) {
+    // Find the odds that gives the exact mean mu, as calculated by moments.
+    // odds0 is a first guess, e.g. from Manly's approximation.
+    // mu must be strictly between xmin and xmax.
+    // The mean is an increasing function of t = log(odds). The equation
+    // mean(t) = mu is solved by secant iteration in t, starting with a 
+    // Newton step where the variance is used as an estimate of dmean/dt.
+    // The root is kept inside a bracket so that the iteration cannot diverge.
+    // Iteration stops when the relative change of odds is below accuracy.
+    // The binomial coefficients in lnbico are reused between iterations.
+    double t, t1;                        // log odds in this and last iteration
+    double tlo = -46., thi = 46.;        // bracket for t. odds limited to 1E-20 .. 1E20
+    double f, f1 = 0.;                   // mean(t) - mu
+    double me, va;                       // exact mean and variance
+    double dt;                           // step in t
+    int iter;                            // number of iterations
+
+    if (mu <= xmin || mu >= xmax) FatalError("mu out of range in CWalleniusNCHypergeometric::FindOdds");
+    if (!(odds0 > 0.) || odds0 > 1E300) odds0 = 1.;  // bad guess
+
+    t = t1 = log(odds0);
+    SetOdds(odds0);
+    moments(&me, &va);
+    f = me - mu;
+
+    for (iter = 0; iter < 100; iter++) {
+        // update bracket
+        if (f > 0.) thi = t;  else tlo = t;
+        if (f == 0.) break;
+
+        // secant step, or Newton step in first iteration
+        if (iter == 0 || f == f1) {
+            if (va <= 0.) break;
+            dt = -f / va;
+        }
+        else {
+            dt = -f * (t - t1) / (f - f1);
+        }
+        if (dt > 5.) dt = 5.;            // limit step size
+        if (dt < -5.) dt = -5.;
+
+        t1 = t;  f1 = f;
+        t += dt;
+        if (t <= tlo || t >= thi) {
+            // outside bracket. Use bisection instead
+            t = 0.5 * (tlo + thi);
+        }
+        SetOdds(exp(t));
+        moments(&me, &va);
+        f = me - mu;
+        if (!(f == f)) FatalError("Calculation failed in CWalleniusNCHypergeometric::FindOdds"); // NAN
+        if (fabs(t - t1) < accuracy) break;
+    }
+    if (iter >= 100) FatalError("Odds does not converge in CWalleniusNCHypergeometric::FindOdds");
+    return omega;
+}
+
+
+int64 CWalleniusNCHypergeometric::mode(void) {
     // find mode
-    int32 Mode;                           // mode
+    int64 Mode;                           // mode
 
     if (omega == 1.) {
         // simple hypergeometric
-        int32 L = m + n - N;
-        int32 m1 = m + 1, n1 = n + 1;
-        Mode = int32((double)m1 * n1 * omega / ((m1 + n1) * omega - L));
+        int64 L = m + n - N;
+        int64 m1 = m + 1, n1 = n + 1;
+        Mode = int64((double)m1 * n1 * omega / ((m1 + n1) * omega - L));
     }
     else {
         // find mode
         double f, f2 = -1.; // f2 = 0.; 
-        int32 xi, x2;
-        int32 xmin = m + n - N;  if (xmin < 0) xmin = 0;  // calculate xmin
-        int32 xmax = n;  if (xmax > m) xmax = m;          // calculate xmax
+        int64 xi, x2;
+        int64 xmin = m + n - N;  if (xmin < 0) xmin = 0;  // calculate xmin
+        int64 xmax = n;  if (xmax > m) xmax = m;          // calculate xmax
 
-        Mode = (int32)mean();                             // floor(mean)
+        Mode = (int64)mean();                             // floor(mean)
         if (omega < 1.) {
             if (Mode < xmax) Mode++;                        // ceil(mean)
             x2 = xmin;                                      // lower limit
@@ -518,7 +606,14 @@ int32 CWalleniusNCHypergeometric::mode(void) {
 double CWalleniusNCHypergeometric::lnbico() {
     // natural log of binomial coefficients.
     // returns lambda = log(m!*x!/(m-x)!*m2!*x2!/(m2-x2)!)
-    int32 x2 = n - x, m2 = N - m;
+    int64 x2 = n - x, m2 = N - m;
+    if (N > LARGE_URN) {
+        // the log factorials are too big to subtract without loss of precision
+        mFac = 0.;
+        if (x != xLastBico) xFac = -(LnBinom(m, x) + LnBinom(m2, x2));
+        xLastBico = x;
+        return bico = -xFac;
+    }
     if (xLastBico < 0) { // m, n, N have changed
         mFac = LnFac(m) + LnFac(m2);
     }
@@ -615,7 +710,7 @@ void CWalleniusNCHypergeometric::findpars() {
 }
 
 
-int CWalleniusNCHypergeometric::BernouilliH(int32 x_, double h, double rh, StochasticLib1 *sto) {
+int CWalleniusNCHypergeometric::BernouilliH(int64 x_, double h, double rh, StochasticLib1 *sto) {
     // This function generates a Bernouilli variate with probability proportional
     // to the univariate Wallenius' noncentral hypergeometric distribution.
     // The return value will be 1 with probability f(x_)/h and 0 with probability
@@ -712,7 +807,7 @@ double CWalleniusNCHypergeometric::recursive() {
     const int BUFSIZE = 512;            // buffer size
     double pp[BUFSIZE + 2];               // probabilities
     //double * p1, * p2;                // offset into pp
-    int32 j1, j2;                       // offset into pp
+    int64 j1, j2;                       // offset into pp
     /* pointer arithmetics in p1, p2 in earlier versions replaced by offset j1, j2
        because of false error messages by gcc-UBSAN   */
 
@@ -721,8 +816,8 @@ double CWalleniusNCHypergeometric::recursive() {
     double y, y1;                       // save old p[x] before it is overwritten
     double d1, d2;                      // divisors in probability formula
     double accuracya;                   // absolute accuracy
-    int32 xi, nu;                       // xi, nu = recursion values of x, n
-    int32 x1, x2;                       // xi_min, xi_max
+    int64 xi, nu;                       // xi, nu = recursion values of x, n
+    int64 x1, x2;                       // xi_min, xi_max
 
     accuracya = 0.005 * accuracy;       // absolute accuracy
     j1 = j2 = 1;                        // make space for pp[j1-1]
@@ -770,7 +865,7 @@ double CWalleniusNCHypergeometric::recursive() {
 double CWalleniusNCHypergeometric::binoexpand() {
     // calculate by binomial expansion of integrand
     // only for x < 2 or n-x < 2 (not implemented for higher x because of loss of precision)
-    int32 x1, m1, m2;
+    int64 x1, m1, m2;
     double o;
     if (x > n / 2) { // invert
         x1 = n - x; m1 = N - m; m2 = m; o = 1. / omega;
@@ -1165,7 +1260,7 @@ double CWalleniusNCHypergeometric::search_inflect(double t_from, double t_to) {
 }
 
 
-double CWalleniusNCHypergeometric::probability(int32 x_) {
+double CWalleniusNCHypergeometric::probability(int64 x_) {
     // calculate probability function. choosing best method
     x = x_;
     if (x < xmin || x > xmax) return 0.;
@@ -1179,8 +1274,8 @@ double CWalleniusNCHypergeometric::probability(int32 x_) {
         return x == 0;
     }
 
-    int32 x2 = n - x;
-    int32 x0 = x < x2 ? x : x2;
+    int64 x2 = n - x;
+    int64 x0 = x < x2 ? x : x2;
     int em = (x == m || x2 == N - m);
 
     if (x0 == 0 && n > 500) {
@@ -1205,7 +1300,7 @@ double CWalleniusNCHypergeometric::probability(int32 x_) {
 }
 
 
-int32 CWalleniusNCHypergeometric::MakeTable(double * table, int32 MaxLength, int32 * xfirst, int32 * xlast, bool * useTable, double cutoff) {
+int32 CWalleniusNCHypergeometric::MakeTable(double * table, int32 MaxLength, int64 * xfirst, int64 * xlast, bool * useTable, double cutoff) {
     // Makes a table of Wallenius noncentral hypergeometric probabilities 
     // table must point to an array of length MaxLength. 
     // The function returns 1 if table is long enough. Otherwise it fills
@@ -1230,11 +1325,11 @@ int32 CWalleniusNCHypergeometric::MakeTable(double * table, int32 MaxLength, int
     double y, y1;                       // probability. Save old p[x] before it is overwritten
     double d1, d2, dcom;                // divisors in probability formula
     double area;                        // estimate of area needed for recursion method
-    int32 xi, nu;                       // xi, nu = recursion values of x, n
-    int32 x1, x2;                       // lowest and highest x or xi
-    int32 i1, i2;                       // index into table
+    int64 xi, nu;                       // xi, nu = recursion values of x, n
+    int64 x1, x2;                       // lowest and highest x or xi
+    int64 i1, i2;                       // index into table
     bool  useTabl;                      // true if table method used
-    int32 lengthNeeded;                 // Necessary table length
+    int64 lengthNeeded;                 // Necessary table length
 
     // special cases
     if (n == 0 || m == 0) { x1 = 0; goto DETERMINISTIC; }
@@ -1250,7 +1345,7 @@ int32 CWalleniusNCHypergeometric::MakeTable(double * table, int32 MaxLength, int
         return 1;
     }
 
-    int32 L = n + m - N;                // parameter
+    int64 L = n + m - N;                // parameter
     x1 = (L > 0) ? L : 0;               // xmin
     x2 = (n < m) ? n : m;               // xmax
     *xfirst = x1;  *xlast = x2;
@@ -1271,10 +1366,11 @@ int32 CWalleniusNCHypergeometric::MakeTable(double * table, int32 MaxLength, int
             // Calculate necessary table length from standard deviation
             double sd = sqrt(variance()); // calculate approximate standard deviation
             // estimate number of standard deviations to include from normal distribution
-            i2 = (int32)(NumSD(accuracy) * sd + 0.5);
+            i2 = (int64)(NumSD(accuracy) * sd + 0.5);
             if (i1 > i2) i1 = i2;
         }
-        return i1;
+        if (i1 > LARGE_URN) i1 = LARGE_URN; // table cannot be longer than this anyway
+        return (int32)i1;
     }
 
     if (useTabl && MaxLength > lengthNeeded) {
@@ -1325,7 +1421,7 @@ int32 CWalleniusNCHypergeometric::MakeTable(double * table, int32 MaxLength, int
     ONE_BY_ONE:
 
         // Start to fill table from the end and down. start with x = floor(mean)
-        x2 = (int32)mean();
+        x2 = (int64)mean();
         x1 = x2 + 1;  i1 = MaxLength;
         while (x1 > xmin) {              // loop for left tail
             x1--;  i1--;
@@ -1360,16 +1456,16 @@ int32 CWalleniusNCHypergeometric::MakeTable(double * table, int32 MaxLength, int
 calculation methods in class CMultiWalleniusNCHypergeometric
 ***********************************************************************/
 
-CMultiWalleniusNCHypergeometric::CMultiWalleniusNCHypergeometric(int32 n_, int32 * m_, double * odds_, int colors_, double accuracy_) {
+CMultiWalleniusNCHypergeometric::CMultiWalleniusNCHypergeometric(int64 n_, int64 * m_, double * odds_, int colors_, double accuracy_) {
     // constructor
     accuracy = accuracy_;
     SetParameters(n_, m_, odds_, colors_);
 }
 
 
-void CMultiWalleniusNCHypergeometric::SetParameters(int32 n_, int32 * m_, double * odds_, int colors_) {
+void CMultiWalleniusNCHypergeometric::SetParameters(int64 n_, int64 * m_, double * odds_, int colors_) {
     // change parameters
-    int32 N1;
+    int64 N1;
     int i;
     n = n_;  m = m_;  omega = odds_;  colors = colors_;
     r = 1.;
@@ -1500,7 +1596,8 @@ double CMultiWalleniusNCHypergeometric::lnbico(void) {
     int i;
     for (i = 0; i < colors; i++) {
         if (x[i] < m[i] && omega[i]) {
-            bico += LnFac(m[i]) - LnFac(x[i]) - LnFac(m[i] - x[i]);
+            if (m[i] > LARGE_URN) bico += LnBinom(m[i], x[i]);
+            else bico += LnFac(m[i]) - LnFac(x[i]) - LnFac(m[i] - x[i]);
         }
     }
     return bico;
@@ -1954,11 +2051,11 @@ double CMultiWalleniusNCHypergeometric::search_inflect(double t_from, double t_t
 }
 
 
-double CMultiWalleniusNCHypergeometric::probability(int32 * x_) {
+double CMultiWalleniusNCHypergeometric::probability(int64 * x_) {
     // calculate probability function. choosing best method
     int i, j, em;
     int central;
-    int32 xsum;
+    int64 xsum;
     x = x_;
 
     for (xsum = i = 0; i < colors; i++)  xsum += x[i];
@@ -1988,7 +2085,7 @@ double CMultiWalleniusNCHypergeometric::probability(int32 * x_) {
     if (central) {
         // All omega's are equal. 
         // This is multivariate central hypergeometric distribution
-        int32 sx = n, sm = N;
+        int64 sx = n, sm = N;
         double p = 1.;
         for (i = 0; i < colors - 1; i++) {
             // Use univariate hypergeometric (usedcolors-1) times
@@ -2024,14 +2121,14 @@ double CMultiWalleniusNCHypergeometricMoments::moments(double * mu, double * var
     // Returns the mean to mean[0...colors-1]
     // Returns the variance to variance[0...colors-1]
     double sumf;               // sum of all f(x) values
-    int32 msum;                // temporary sum
+    int64 msum;                // temporary sum
     int i;                     // loop counter
 
     // get approximate mean
     mean(sx);
     // round mean to integers
     for (i = 0; i < colors; i++) {
-        xm[i] = (int32)(sx[i] + 0.4999999);
+        xm[i] = (int64)(sx[i] + 0.4999999);
     }
 
     // set up for recursive loops
@@ -2056,11 +2153,11 @@ double CMultiWalleniusNCHypergeometricMoments::moments(double * mu, double * var
 }
 
 
-double CMultiWalleniusNCHypergeometricMoments::loop(int32 n, int c) {
+double CMultiWalleniusNCHypergeometricMoments::loop(int64 n, int c) {
     // recursive function to loop through all combinations of x-values.
     // used by moments()
-    int32 x, x0;                         // x of color c
-    int32 xmin, xmax;                    // min and max of x[c]
+    int64 x, x0;                         // x of color c
+    int64 xmin, xmax;                    // min and max of x[c]
     double s1, s2, sum = 0.;             // sum of f(x) values
     int i;                               // loop counter
 
@@ -2075,6 +2172,7 @@ double CMultiWalleniusNCHypergeometricMoments::loop(int32 n, int c) {
             xi[c] = x;
             sum += s1 = loop(n - x, c + 1); // recursive loop for remaining colors
             if (s1 < accuracy && s1 < s2) break; // stop when values become negligible
+            if (DeadlinePassed()) break;    // stop at time limit or user interrupt
             s2 = s1;
         }
         // loop for all x[c] from mean and down
@@ -2082,6 +2180,7 @@ double CMultiWalleniusNCHypergeometricMoments::loop(int32 n, int c) {
             xi[c] = x;
             sum += s1 = loop(n - x, c + 1); // recursive loop for remaining colors
             if (s1 < accuracy && s1 < s2) break; // stop when values become negligible
+            if (DeadlinePassed()) break;    // stop at time limit or user interrupt
             s2 = s1;
         }
     }